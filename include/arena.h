@@ -0,0 +1,61 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include "page_alloc.h"
+
+// --- Region (Arena) Allocator ---
+// Bump allocator for one generation session. Layers and stage temporaries are
+// carved out of large blocks; nothing is freed individually. A stage takes a
+// mark on entry and releases back to it on exit, and the whole arena is reset
+// once between maps. Blocks are kept across resets, so a long-running worker
+// stops calling malloc after its first map.
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;        // First block; blocks are never freed before arena_destroy
+    ArenaBlock* current;     // Block allocations are served from
+    size_t block_size;       // Minimum size of newly created blocks
+    size_t reserved;         // Total bytes held in blocks
+    size_t used;             // Bytes handed out since the last reset (incl. padding)
+    size_t peak_used;        // High-water mark of used
+    PageMode page_mode;      // How new blocks are mapped (see page_alloc.h)
+} Arena;
+
+// Checkpoint returned by arena_mark; releasing to it frees everything
+// allocated after it was taken.
+typedef struct {
+    ArenaBlock* block;
+    size_t offset;
+    size_t used;
+} ArenaMark;
+
+#define ARENA_ALIGNMENT 64 // Cache line; also satisfies any SIMD load
+#define ARENA_DEFAULT_BLOCK_SIZE ((size_t)4 << 20)
+
+void arena_init(Arena* arena, size_t block_size);
+void arena_destroy(Arena* arena);
+
+// Applies to blocks created from now on; existing blocks keep their pages.
+// Non-default modes map blocks with page_alloc and leave them untouched, so
+// physical pages are placed by whichever thread first writes each part.
+void arena_set_page_mode(Arena* arena, PageMode mode);
+
+// Returns ARENA_ALIGNMENT aligned memory, or NULL if a new block can't be allocated.
+// The memory is not cleared.
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_calloc(Arena* arena, size_t count, size_t size);
+
+ArenaMark arena_mark(const Arena* arena);
+void arena_release(Arena* arena, ArenaMark mark);
+void arena_reset(Arena* arena);
+
+// Scratch helpers for code that may or may not run inside a session: with a
+// NULL arena they fall back to malloc/free, otherwise scratch_free is a no-op
+// and the memory is reclaimed by the caller's arena_release/arena_reset.
+void* scratch_alloc(Arena* arena, size_t size);
+void* scratch_calloc(Arena* arena, size_t count, size_t size);
+void scratch_free(Arena* arena, void* ptr);
+
+#endif // ARENA_H
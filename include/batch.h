@@ -0,0 +1,37 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "map_pipeline.h"
+
+// One map of a batch: its seed and the full config to generate it with.
+typedef struct {
+    unsigned int seed;
+    MapGenConfig config;
+} BatchJob;
+
+// Applies one key=value override (the keys listed below) to config.
+// Returns false for unknown keys.
+bool mapgen_config_set(MapGenConfig* config, const char* key, const char* value);
+
+// Reads a job list from path. Each non-empty line that is not a '#' comment is
+//     <seed> [key=value ...]
+// where keys override fields of base: width, height, rivers, exponent,
+// land_threshold, land_fraction, erosion (droplet count), thermal (iterations),
+// talus, shelf (shelf width), river_moisture, wind (strength), wind_from
+// (see wind_direction_parse in climate.h), basins (nonzero computes drainage
+// basins), lake_level, wrap (none, cylinder or torus; see noise_generator.h),
+// terraces (number of levels; a positive count enables terracing).
+// main's --set accepts the same keys.
+// On success *out_jobs is malloc'd (caller frees) and 0 is returned.
+int load_batch_jobs(MapGenContext* ctx, const char* path, const MapGenConfig* base,
+                    BatchJob** out_jobs, int* out_count);
+
+// Generates every job using num_workers threads. Each worker clones ctx (log
+// sink included) and keeps its own MapGenWorkspace, so buffers are reused
+// across the maps it processes. Output files are named
+// <output_dir>/map_<index>_<seed>.png regardless of which worker ran them.
+// Returns the number of jobs that failed.
+int run_batch(const MapGenContext* ctx, const BatchJob* jobs, int count,
+              int num_workers, const char* output_dir);
+
+#endif // BATCH_H
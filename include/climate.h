@@ -0,0 +1,132 @@
+#ifndef CLIMATE_H
+#define CLIMATE_H
+
+#include "map_data.h"
+
+// --- Wind-Driven Moisture ---
+// Air crosses the map along the prevailing wind carrying humidity in [0, 1].
+// Over water it evaporates toward saturation; over land a base share rains
+// out per cell, plus more where the ground climbs (orographic lift), and part
+// of the rain is recycled into the air. Mountains therefore soak up the
+// humidity on their windward side and leave a dry rain shadow behind them.
+//
+// Each wind direction is one streaming sweep over the map: O(cells), no
+// iteration to convergence. Every air column is independent, so the step
+// runs on many of them at once: east-west winds transpose blocks of rows so
+// the step walks across rows, north-south winds carry one column per cell of
+// a row segment. The step has no branches, so both forms vectorize.
+//
+// The rain (relative to a saturated flat coast, capped at 1, and the humidity
+// itself over water) is blended into map->moisture by strength, so the usual
+// MOIST_* biome thresholds apply to it unchanged.
+
+typedef enum {
+    WIND_ZONAL,             // By latitude: trade winds and polar easterlies from
+                            // the east, westerlies between 30 and 60 degrees
+    WIND_FROM_WEST,
+    WIND_FROM_EAST,
+    WIND_FROM_NORTH,
+    WIND_FROM_SOUTH
+} WindDirection;
+
+typedef struct {
+    double strength;        // Share of map->moisture replaced, 0 = off
+    WindDirection direction;
+    double inflow;          // Humidity of the air entering the map
+    double evaporation;     // Share of the missing humidity picked up per water cell
+    double base_rain;       // Share of the humidity raining out per land cell
+    double orographic;      // Extra share per unit of elevation climbed
+    double recycling;       // Share of the rain evaporating back into the air
+} WindParams;
+
+void wind_params_default(WindParams* params);
+
+// Parses "zonal", "west", "east", "north" or "south"; returns false otherwise.
+bool wind_direction_parse(const char* text, WindDirection* out);
+
+// Sweeps the wind over map and blends the rain into map->moisture. Water is
+// taken from the component labels when the map has them (so lakes feed the
+// air too), else from elevation below water_level.
+void advect_moisture(MapGenContext* ctx, MapData* map, double water_level, const WindParams* params);
+
+// --- Temperature ---
+// map->temperature is computed once per map from elevation and latitude and
+// read by every renderer, the biome classifier and exporters. It is in [0, 1],
+// 1 at sea level on the equator: one minus the elevation raised by
+// latitude_factor times the distance from the equator (0 there, 1 at the
+// poles), clamped. Latitude acts like a lapse rate, so elevation bands double
+// as temperature bands.
+
+// Computes map->temperature (allocated in the map's arena if needed).
+bool map_compute_temperature(MapGenContext* ctx, MapData* map, double latitude_factor);
+
+// Recomputes the cells of rect only, e.g. after an edit.
+void update_temperature_rect(MapData* map, double latitude_factor, MapRect rect);
+
+// Temperature of a cell at elevation e with no latitude effect, for maps
+// without the layer.
+static inline double temperature_from_elevation(double e) {
+    return 1.0 - (e < 0.0 ? 0.0 : (e > 1.0 ? 1.0 : e));
+}
+
+// --- Biomes ---
+// The one classification every renderer and exporter shares. Water is what
+// the temperature puts below the beach line (so latitude can freeze shallow
+// seas into land, as it always has); moisture then picks the biome within
+// each temperature band.
+
+typedef enum {
+    BIOME_OCEAN,
+    BIOME_LAKE,             // Shallow water up to the beach line
+    BIOME_SCORCHED,
+    BIOME_BARE_ROCK,
+    BIOME_TUNDRA,
+    BIOME_SNOW,
+    BIOME_SAVANNAH,
+    BIOME_SHRUBLAND,
+    BIOME_TAIGA,
+    BIOME_GRASSLAND,
+    BIOME_FOREST,
+    BIOME_DESERT,
+    BIOME_JUNGLE,
+    BIOME_COUNT
+} Biome;
+
+// Temperature bands: above OCEAN is ocean, above BEACH lake, below BOREAL
+// alpine, below TEMPERATE boreal, below TROPICAL temperate, else tropical.
+#define TEMP_OCEAN          (1.0 - 0.15)
+#define TEMP_BEACH          (1.0 - 0.18)
+#define TEMP_TROPICAL       (1.0 - 0.40)
+#define TEMP_TEMPERATE      (1.0 - 0.65)
+#define TEMP_BOREAL         (1.0 - 0.85)
+
+#define MOIST_DESERT         0.20
+#define MOIST_GRASS_SAVANNAH 0.40
+#define MOIST_WOODLAND_SHRUB 0.70
+
+static inline Biome classify_biome(double temperature, double moisture) {
+    int wetness = moisture < MOIST_DESERT ? 0
+                : moisture < MOIST_GRASS_SAVANNAH ? 1
+                : moisture < MOIST_WOODLAND_SHRUB ? 2 : 3;
+    if (temperature > TEMP_OCEAN) return BIOME_OCEAN;
+    if (temperature > TEMP_BEACH) return BIOME_LAKE;
+    if (temperature < TEMP_BOREAL) {
+        static const Biome alpine[4] = { BIOME_SCORCHED, BIOME_BARE_ROCK, BIOME_TUNDRA, BIOME_SNOW };
+        return alpine[wetness];
+    }
+    if (temperature < TEMP_TEMPERATE) {
+        static const Biome boreal[4] = { BIOME_SAVANNAH, BIOME_SHRUBLAND, BIOME_TAIGA, BIOME_TAIGA };
+        return boreal[wetness];
+    }
+    if (temperature < TEMP_TROPICAL) {
+        static const Biome temperate[4] = { BIOME_SAVANNAH, BIOME_GRASSLAND, BIOME_FOREST, BIOME_FOREST };
+        return temperate[wetness];
+    }
+    static const Biome tropical[4] = { BIOME_DESERT, BIOME_GRASSLAND, BIOME_JUNGLE, BIOME_JUNGLE };
+    return tropical[wetness];
+}
+
+// Lower-case name of a biome, e.g. for exports.
+const char* biome_name(Biome biome);
+
+#endif // CLIMATE_H
@@ -0,0 +1,58 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "map_data.h"
+
+// --- Connected Components ---
+// Splits the map into 8-connected water bodies (elevation below the water
+// level) and landmasses. The label layer stores (id << 1) | water for every
+// cell, so both the component and its class are one load away. Ids count
+// components in raster order of their first cell, whatever the thread count.
+//
+// Labeling is union-find in two phases: every band of rows links its own
+// cells on the context thread pool, then the rows on either side of each band
+// boundary are merged. Roots are always the smallest cell index of their
+// tree, which is what makes the ids independent of the band split.
+
+#define COMPONENT_ID(label)       ((label) >> 1)
+#define COMPONENT_IS_WATER(label) (((label) & 1) != 0)
+
+typedef struct {
+    long long area;             // Cells
+    MapRect bbox;
+    bool water;
+    bool touches_edge;          // Water: drains off the map (an ocean)
+    bool lake;                  // Water enclosed by land; fill_lakes raises it to surface
+    double surface;             // Lakes: lowest elevation on the rim, else 0
+} ComponentStats;
+
+struct ComponentTable {
+    int count;
+    int water_count;
+    ComponentStats* stats;      // Indexed by COMPONENT_ID
+};
+
+// Labels the cells of map into labels (a width x height layer). Returns the
+// number of components, or -1 if scratch memory could not be allocated.
+int label_components(MapGenContext* ctx, const MapData* map, double water_level, int32_t** labels);
+
+// Renumbers the components of labels keeping the class (water bit) of every
+// cell, for labels whose classes were patched in place after fill_lakes (see
+// map_update_dirty): filled lakes are no longer below the water level, so
+// labeling by elevation would turn them into land.
+int relabel_components(MapGenContext* ctx, const MapData* map, int32_t** labels);
+
+// Per-component statistics of a labeling. Uses only the labels and the
+// elevation of land cells, so it gives the same table before and after
+// fill_lakes. stats is allocated with scratch_alloc from arena.
+bool compute_component_stats(MapGenContext* ctx, const MapData* map, int32_t** labels, int count,
+                             Arena* arena, ComponentTable* out);
+
+// Table of map->component (set by fill_lakes), computed on first use, or NULL
+// if the map has no labels. Labels flagged MAP_STALE_COMPONENTS are
+// renumbered with relabel_components first.
+const ComponentTable* map_components(MapGenContext* ctx, MapData* map);
+
+#endif // COMPONENTS_H
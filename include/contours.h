@@ -0,0 +1,51 @@
+#ifndef CONTOURS_H
+#define CONTOURS_H
+
+#include <stdbool.h>
+#include "map_data.h"
+
+// --- Contour Lines ---
+// Isolines of map->elevation by marching squares over the squares between
+// cell centers. Crossings are linearly interpolated along the square edges
+// and every line keeps the ground at or above its level on its right (on the
+// map image, x right and y down): coastlines run clockwise around islands.
+// Saddles are resolved by the average of the four corners.
+//
+// Squares are processed in tiles of CONTOUR_TILE_ROWS rows, in parallel: each
+// tile links its segments into fragments, which are stitched across the tile
+// seams into complete lines and then written back, again per tile. The tiles
+// do not depend on the thread count, so neither does the output. Lines that
+// reach the map edge are open; all others are closed.
+//
+// Each smoothing iteration is one Chaikin corner-cutting pass: every segment
+// is replaced by its points at 1/4 and 3/4, doubling the vertices (open lines
+// keep their end points).
+
+#define CONTOUR_TILE_ROWS 64
+
+typedef struct {
+    float x, y;                 // Cell coordinates: cell (x, y) is at (x, y)
+} ContourVertex;
+
+typedef struct {
+    int first;                  // Index of the first vertex in ContourSet.vertices
+    int count;
+    double level;
+    bool closed;                // Last vertex connects back to the first
+} ContourLine;
+
+typedef struct {
+    int count;
+    ContourLine* lines;         // By level, in the order given
+    int vertex_count;
+    ContourVertex* vertices;
+} ContourSet;
+
+// Extracts the contours of map->elevation at each of the levels into out
+// (arrays malloc'd; release with free_contour_set). Returns false if memory
+// could not be allocated.
+bool extract_contours(MapGenContext* ctx, const MapData* map, const double* levels, int num_levels,
+                      int smoothing, ContourSet* out);
+void free_contour_set(ContourSet* contours);
+
+#endif // CONTOURS_H
@@ -0,0 +1,34 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <stdbool.h>
+#include "map_data.h"
+
+// --- Distance Transforms ---
+// Exact Euclidean distances to the nearest feature cell in O(width * height),
+// via the lower envelope of parabolas (Felzenszwalb & Huttenlocher): one 1D
+// transform along every row, then one along every column of the result. Rows
+// and then columns are split into bands on the context thread pool; each 1D
+// transform is independent, so results do not depend on the thread count.
+
+// Marks non-feature cells on input; returned for every cell of a layer that
+// has no feature at all.
+#define DISTANCE_FAR 1e30
+
+// In place: layer holds 0 at feature cells and DISTANCE_FAR elsewhere on
+// entry, and the distance in cells to the nearest feature on return. Returns
+// false if scratch memory could not be allocated (layer is then unchanged).
+bool distance_transform(MapGenContext* ctx, double** layer, int width, int height);
+
+// Signed distance to the coast: for land cells (elevation >= water_level) the
+// distance to the nearest water cell, for water cells minus the distance to
+// the nearest land cell.
+bool compute_coast_distance(MapGenContext* ctx, const MapData* map, double water_level, double** out);
+// Distance to the nearest map->is_river cell.
+bool compute_river_distance(MapGenContext* ctx, const MapData* map, double** out);
+
+// Allocates map->coast_distance and map->river_distance on first use (where
+// the map's other layers live) and fills both from the current layers.
+bool map_compute_distances(MapGenContext* ctx, MapData* map, double water_level);
+
+#endif // DISTANCE_H
@@ -0,0 +1,65 @@
+#ifndef EROSION_H
+#define EROSION_H
+
+#include "map_data.h"
+
+// --- Hydraulic Erosion ---
+// Particle erosion: each droplet rolls downhill from a random cell, picking up
+// sediment where it speeds up and dropping it where it slows down or
+// evaporates.
+//
+// The map is cut into tile_size tiles colored in a 2x2 pattern. A droplet
+// spawned in a tile is stopped once it wanders more than about half a tile
+// beyond it, so the cells touched by two tiles of the same color never
+// overlap and all tiles of one color run concurrently on the band pool, with
+// no locks or atomics. Colors run one after the other, and each tile's
+// droplets are spread over `rounds` passes through the four colors so no
+// color systematically erodes first. Droplet i of tile t always comes from RNG
+// stream (seed, RNG_STAGE_EROSION, t), so the result depends only on the seed
+// and parameters, not on the thread count.
+
+typedef struct {
+    long long droplets;     // Total over the map, 0 = no erosion
+    int max_lifetime;       // Steps before a droplet evaporates completely
+    int radius;             // Erosion brush radius in cells
+    int tile_size;          // Scheduling tile side; bounds how far droplets roam
+    int rounds;             // Passes over the four tile colors
+
+    double inertia;         // 0 = follow the gradient, 1 = keep direction
+    double sediment_capacity;
+    double min_capacity;    // Keeps eroding on nearly flat ground
+    double deposit_rate;
+    double erode_rate;
+    double evaporate_rate;
+    double gravity;
+    double initial_water;
+    double initial_speed;
+} ErosionParams;
+
+void erosion_params_default(ErosionParams* params);
+
+// Erodes map->elevation with params->droplets droplets drawn from the context
+// seed. Logs the throughput in droplets per second. Returns the number of
+// droplets simulated.
+long long hydraulic_erosion(MapGenContext* ctx, MapData* map, const ErosionParams* params);
+
+// --- Thermal Erosion ---
+// Talus relaxation: wherever the height difference between 4-neighbours
+// exceeds talus, rate times the excess moves from the higher cell to the
+// lower one. Every pair's transfer is computed identically from both sides,
+// so each iteration is a pure gather from the previous one (double-buffered,
+// mass-conserving and independent of the band split). The inner loop walks
+// three contiguous rows without branches.
+
+typedef struct {
+    int iterations;         // 0 = off
+    double talus;           // Steepest stable height step between neighbours
+    double rate;            // Share of the excess moved per iteration, clamped to 0.25; <= 0 is off
+} ThermalParams;
+
+void thermal_params_default(ThermalParams* params);
+
+// Relaxes map->elevation for params->iterations sweeps.
+void thermal_erosion(MapGenContext* ctx, MapData* map, const ThermalParams* params);
+
+#endif // EROSION_H
@@ -4,16 +4,37 @@
 #include "map_data.h"
 #include <stdbool.h> // Make sure bool is available
 
-void generate_rivers(MapData* map,
+void generate_rivers(MapGenContext* ctx, MapData* map,
                      int num_rivers,
                      int min_length,
                      int max_length,
-                     double start_elevation_min);
+                     double start_elevation_min); // River i starts from RNG stream (seed, RNG_STAGE_RIVERS, i)
+                                                  // and its cells go to slot i of map->river_paths
 
 // --- New Function: Fill Lakes ---
 // Identifies and fills depressions (pits) in the terrain.
 // Modifies map->elevation to create flat lake surfaces.
-void fill_lakes(MapData* map, double ocean_level);
+// Labels water bodies and landmasses into map->component (see components.h)
+// and fills every water body that does not reach the map edge up to its
+// lowest rim cell; map->components describes them afterwards.
+void fill_lakes(MapGenContext* ctx, MapData* map, double ocean_level);
 // --------------------------------
 
+// Fills the depressions that have a cell within region (or next to it) and
+// leaves the rest of the map alone, for incremental updates after edits. A
+// depression is followed wherever it extends, so the work is proportional to
+// the size of the depressions touching the region, not of the map; one found
+// to reach the map edge is abandoned as soon as it does. Each is filled to
+// its lowest rim cell. Returns the bounding box of the raised cells.
+// map->component is not updated.
+MapRect fill_lakes_region(MapGenContext* ctx, MapData* map, double ocean_level, MapRect region);
+
+// Retraces the recorded rivers that pass within a cell of region from their
+// sources over the current elevation, carving and recording the new paths
+// (a river that now ends short of the min_length generate_rivers used is
+// dropped). Old beds stay carved; the other rivers keep their paths, and
+// map->river_network is dropped if any river moved. Returns the bounding box of
+// the old and new cells of the retraced rivers.
+MapRect update_rivers_region(MapGenContext* ctx, MapData* map, MapRect region);
+
 #endif // HYDROLOGY_H
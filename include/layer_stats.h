@@ -0,0 +1,25 @@
+#ifndef LAYER_STATS_H
+#define LAYER_STATS_H
+
+#include <stdbool.h>
+#include "mapgen_context.h"
+
+// --- Layer Statistics ---
+// Order statistics over contiguous layers without sorting. Every pass is a
+// banded sweep on the context thread pool with per-band partial results that
+// are merged afterwards, so the results do not depend on the thread count.
+
+// Exact k-th smallest value (k counted from 0) among the cells of layer whose
+// gate cell is >= gate_min; gate NULL selects every cell. One pass finds the range, two
+// histogram passes narrow it to a 1/4096^2 slice and a last pass gathers that
+// slice for an exact selection. Returns false if k is out of range (the
+// number of selected cells is still written to selected_out when non-NULL).
+bool layer_select_kth(MapGenContext* ctx, double** layer, double** gate, double gate_min,
+                      int width, int height, long long k, double* value_out,
+                      long long* selected_out);
+
+// Number of cells of layer that are >= threshold.
+long long layer_count_at_least(MapGenContext* ctx, double** layer, int width, int height,
+                               double threshold);
+
+#endif // LAYER_STATS_H
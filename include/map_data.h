@@ -2,17 +2,77 @@
 #define MAP_DATA_H
 
 #include <stdbool.h> // Needed for bool
+#include <stdint.h>
+#include "mapgen_context.h"
+#include "arena.h"
 
+// Half-open cell rectangle [x0, x1) x [y0, y1); empty when x0 >= x1 or y0 >= y1.
+typedef struct {
+    int x0, y0;
+    int x1, y1;
+} MapRect;
+
+// Layers left out of date by map_update_dirty (MapData.stale)
+#define MAP_STALE_COMPONENTS (1u << 0)  // component ids/components: map_components renumbers
+#define MAP_STALE_BASINS     (1u << 1)  // basin/basins: map_basins recomputes
+#define MAP_STALE_DISTANCES  (1u << 2)  // coast/river_distance: call map_compute_distances
+
+typedef struct ComponentTable ComponentTable;   // See components.h
+typedef struct BasinTable BasinTable;           // See watershed.h
+typedef struct RiverNetwork RiverNetwork;       // See rivers.h
+
+// Each layer is a row pointer table over one contiguous width*height block,
+// so layer[y][x] indexing works and layer[0] addresses the whole layer.
 typedef struct {
     int width;
     int height;
     double **elevation;
     double **moisture;
     bool **is_river;
+    double **temperature;       // See climate.h; NULL until map_compute_temperature
+    double **coast_distance;    // Signed, + on land; NULL until map_compute_distances
+    double **river_distance;    // NULL until map_compute_distances
+    int32_t **component;        // Water body / landmass labels, NULL until fill_lakes
+    ComponentTable* components; // Their statistics, NULL until map_components
+    int32_t **basin;            // Drainage basin ids, NULL until map_compute_basins
+    BasinTable* basins;         // Their statistics, NULL until map_basins
+    int32_t *river_paths;       // Cells of each carved river (see rivers.h), NULL until generate_rivers
+    int river_path_count;       // Slots in river_paths
+    int river_path_stride;      // Cells per slot
+    int river_min_length;       // Shortest river generate_rivers keeps, for update_rivers_region
+    RiverNetwork* river_network;    // River polylines, NULL until map_river_network
+    int cube_face;  // CubeFace of a planet face (see planet.h), latitude from the sphere; -1 for flat maps
+    Arena* arena;   // Session arena the layers live in, or NULL if malloc'd
+    MapRect dirty;  // Cells edited since the last map_take_dirty (see map_edit.h)
+    unsigned stale;             // MAP_STALE_* flags of the derived layers edits left behind
 } MapData;
 
-MapData* create_map(int width, int height);
-void destroy_map(MapData* map);
-void redistribute_map(MapData* map, double exponent);
+// Allocates from the context's session arena when one is set (see
+// mapgen_context_set_arena), otherwise from the heap.
+MapData* create_map(MapGenContext* ctx, int width, int height);
+void destroy_map(MapGenContext* ctx, MapData* map);
+// Resets all layers to their freshly created state so the map can be reused.
+void clear_map(MapData* map);
+// --- Dirty Regions ---
+MapRect map_rect_empty(void);
+bool map_rect_is_empty(MapRect rect);
+MapRect map_rect_union(MapRect a, MapRect b);
+// Grows rect by margin cells on every side and clips it to width x height.
+MapRect map_rect_expand(MapRect rect, int margin, int width, int height);
+
+// Adds rect (clipped to the map) to the map's dirty region.
+void map_mark_dirty(MapData* map, MapRect rect);
+// Returns the dirty region and clears it.
+MapRect map_take_dirty(MapData* map);
+
+void redistribute_map(MapGenContext* ctx, MapData* map, double exponent);
+
+// Standalone zero-initialised layer with the same layout as the map layers,
+// allocated and first-touched like create_map does.
+double** create_layer(MapGenContext* ctx, int width, int height);
+void destroy_layer(MapGenContext* ctx, double** layer);
+// Same for int32 layers (component labels).
+int32_t** create_label_layer(MapGenContext* ctx, int width, int height);
+void destroy_label_layer(MapGenContext* ctx, int32_t** layer);
 
 #endif // MAP_DATA_H
@@ -0,0 +1,31 @@
+#ifndef MAP_EDIT_H
+#define MAP_EDIT_H
+
+#include "map_data.h"
+
+// --- Terrain Edits ---
+// Edits change map layers in place and record the touched cells in the map's
+// dirty region. map_update_dirty then brings everything derived from
+// elevation up to date for that region only: the depressions the edit
+// created, deepened or opened are refilled (following each depression beyond
+// the region as far as it extends), the recorded rivers that pass the edit
+// are retraced from their sources (see update_rivers_region), and the biome
+// colors of every cell that changed are re-rendered. The cost scales with the
+// edit, not the map. Whole-map layers are only partly patched: the water bit
+// of the edited component labels is updated, the basin table dropped, and
+// map->stale flags the rest, so map_components renumbers the components and
+// map_basins relabels the basins on next use; distance layers stay flagged
+// (MAP_STALE_DISTANCES) until map_compute_distances.
+
+// Raises (delta > 0) or lowers elevation around (cx, cy) with a smooth falloff
+// that reaches zero at radius, clamping to [0, 1].
+void map_brush_elevation(MapData* map, double cx, double cy, double radius, double delta);
+
+// Updates the dirty region and clears it. pixels is a full RGB rendering of
+// the map (see render_map_rgb) to patch, or NULL. The temperature layer, if
+// the map has one, is refreshed with latitude_temp_factor first. Returns the
+// cells whose colors may have changed.
+MapRect map_update_dirty(MapGenContext* ctx, MapData* map, double ocean_level,
+                         double latitude_temp_factor, unsigned char* pixels);
+
+#endif // MAP_EDIT_H
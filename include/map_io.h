@@ -2,10 +2,61 @@
 #define MAP_IO_H
 
 #include "map_data.h"
+#include "watershed.h"
+#include "rivers.h"
+#include "mesh.h"
+#include "contours.h"
 
 // --- Updated Signatures ---
-void print_map_text(const MapData* map, double latitude_temp_factor);
-int write_map_png(const MapData* map, const char* filename, double latitude_temp_factor);
+// Renderers classify cells by map->temperature (see climate.h), falling back to
+// plain elevation when the map has no temperature layer.
+void print_map_text(const MapData* map);
+// PNG compression level comes from the context config (png_compression_level);
+// pixel and filter scratch come from the context arena when one is set.
+int write_map_png(MapGenContext* ctx, const MapData* map, const char* filename);
+
+// Fills pixel_data (width * height * 3 bytes, RGB) with biome colors.
+void render_map_rgb(const MapData* map, unsigned char* pixel_data);
+// Same for rows [y_begin, y_end) only, so bands of the image can be rendered
+// in parallel.
+void render_map_rows(const MapData* map, unsigned char* pixel_data, int y_begin, int y_end);
+// Same for the cells of rect only, e.g. to refresh an edited region.
+void render_map_rect(const MapData* map, unsigned char* pixel_data, MapRect rect);
+// Encodes width * height RGB pixels as PNG (level from the context config)
+// and writes them to filename. Returns 0 on success.
+int write_rgb_png(MapGenContext* ctx, const unsigned char* pixel_data, int width, int height,
+                  const char* filename);
+// Writes one CSV row per drainage basin (id, area, bounding box, outlet and
+// where it drains, outlet and peak elevation). Returns 0 on success.
+int write_basin_csv(MapGenContext* ctx, const BasinTable* basins, const char* filename);
+// Writes the river polylines as a GeoJSON FeatureCollection of LineStrings in
+// cell coordinates (x right, y down), with id, order, length, cells and joins
+// (-1 or the id of the river flowed into) as properties. Returns 0 on success.
+int write_river_geojson(MapGenContext* ctx, const RiverNetwork* rivers, const char* filename);
+// Same network in a compact binary form; integers are LEB128 varints, signed
+// ones zigzag-encoded:
+//   "MGRV", version byte 1, river count, vertex count, then per river:
+//   vertex count, cells, joins + 1, order, length (float32, little-endian),
+//   first vertex x and y, then signed deltas from each vertex to the next.
+int write_river_binary(MapGenContext* ctx, const RiverNetwork* rivers, const char* filename);
+// Writes the mesh as Wavefront OBJ with y up: each vertex as x, elevation *
+// height_scale, y, and faces facing up. Returns 0 on success.
+int write_mesh_obj(MapGenContext* ctx, const TerrainMesh* mesh, double height_scale, const char* filename);
+// Same mesh in binary, all fields little-endian:
+//   "MGMS", uint32 version 1, uint32 vertex count, uint32 triangle count,
+//   float32 x, y, elevation per vertex, then uint32 indices, three per triangle.
+int write_mesh_binary(MapGenContext* ctx, const TerrainMesh* mesh, const char* filename);
+// Writes the contours as a GeoJSON FeatureCollection of LineStrings in cell
+// coordinates, closed lines repeating their first vertex, with level and
+// closed as properties. Returns 0 on success.
+int write_contour_geojson(MapGenContext* ctx, const ContourSet* contours, const char* filename);
+// Same contours in binary, with coordinates rounded to 1/CONTOUR_BINARY_SUBDIVISIONS
+// of a cell; integers are LEB128 varints, signed ones zigzag-encoded:
+//   "MGCT", version byte 1, subdivisions, line count, vertex count, then per
+//   line: vertex count * 2 + closed, level (float32, little-endian), first
+//   vertex x and y, then signed deltas from each vertex to the next.
+#define CONTOUR_BINARY_SUBDIVISIONS 16
+int write_contour_binary(MapGenContext* ctx, const ContourSet* contours, const char* filename);
 // ------------------------
 
 #endif // MAP_IO_H
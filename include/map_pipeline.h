@@ -0,0 +1,115 @@
+#ifndef MAP_PIPELINE_H
+#define MAP_PIPELINE_H
+
+#include <stdbool.h>
+
+#include "mapgen_context.h"
+#include "arena.h"
+#include "page_alloc.h"
+#include "map_data.h"
+#include "noise_generator.h"
+#include "point_ops.h"
+#include "stage_cache.h"
+#include "erosion.h"
+#include "climate.h"
+
+// --- Generation Config ---
+// Everything that used to be a #define in main.c. One config describes one map;
+// batch runs copy a base config and override fields per seed. Each
+// MapGenContext owns one config (see mapgen_context_config).
+typedef struct {
+    int width;
+    int height;
+
+    NoiseParams elev_params;
+    NoiseParams moist_params;
+    NoiseParams cont_params;
+
+    double continent_land_threshold;
+    double target_land_fraction;    // > 0 derives continent_land_threshold per map for this land share
+    double redistribution_exponent;
+    double redistribution_max_error;  // 0 = exact pow(), else table error bound (see point_chain_pow)
+    bool apply_terracing;
+    int num_terrace_levels;
+
+    ErosionParams erosion;      // Hydraulic erosion after shaping; droplets 0 = off
+    ThermalParams thermal;      // Talus relaxation after that; iterations 0 = off
+
+    int num_rivers;
+    int min_river_length;
+    int max_river_length;
+    double river_start_elev_min;
+
+    double ocean_level_for_lakes;
+    double shelf_width;             // > 0: ocean floor slopes down over this many cells (see apply_bathymetry)
+    double river_moisture;          // > 0: moisture added along rivers
+    double river_moisture_range;    // Cells over which that fades out
+    WindParams wind;                // Moisture advected by the wind after rivers; strength 0 = off
+    double latitude_temp_effect_strength;
+    bool compute_basins;            // Label drainage basins after the last elevation change (see watershed.h)
+
+    bool enable_console_output;
+    int png_compression_level;  // zlib level used by write_map_png (default 8)
+
+    int num_threads;            // Band threads per map, 0 = one per online core
+    bool pin_threads;           // Bind each band helper thread to its own CPU (for NUMA first touch)
+    int stage_lanes;            // Pipeline stages run concurrently (see stage_graph.h), 1 = in order
+    int cache_memory_mb;        // Stage outputs kept in memory across generate_map calls, 0 = none
+    const char* cache_dir;      // Also keep stage outputs on disk here (NULL = memory only)
+    int cache_disk_mb;          // Budget for cache_dir, least recently used files deleted past it (0 = unlimited)
+    PageMode page_mode;         // Backing pages for the session arena blocks
+} MapGenConfig;
+
+// --- Reusable Workspace ---
+// Holds everything a generation run allocates. The map layers, continent map
+// and all stage temporaries come from the session arena, which is reset once
+// at the start of each generate_map call, so consecutive maps reuse the same
+// memory instead of going through malloc/free. The noise states are reseeded
+// rather than recreated. The stage cache (created on first use when the config
+// enables one) outlives the arena, so later maps can reuse stage outputs of
+// earlier ones. A workspace must only be used by one thread at a time.
+typedef struct {
+    Arena arena;              // Session arena, reset between maps
+    MapData* map;             // Result of the last generate_map (lives in arena)
+    double** continent_map;   // Lives in arena
+    unsigned char* pixels;    // RGB image of the last map (lives in arena), NULL without PNG
+    NoiseState* noise_elev;
+    NoiseState* noise_moist;
+    NoiseState* noise_cont;
+    StageCache* cache;        // Memoized stage outputs, NULL until enabled
+} MapGenWorkspace;
+
+// Fills config with the default parameters (the values main.c used to hard-code).
+void mapgen_config_default(MapGenConfig* config);
+
+// The config owned by ctx; edit it in place before calling generate_map.
+MapGenConfig* mapgen_context_config(MapGenContext* ctx);
+
+// Noise layers of a map, each seeded independently from the map seed.
+typedef enum {
+    MAP_NOISE_ELEVATION = 1,
+    MAP_NOISE_MOISTURE = 2,
+    MAP_NOISE_CONTINENT = 3
+} MapNoiseLayer;
+
+// Seed of noise layer `layer` for map seed `seed`.
+int mapgen_noise_seed(unsigned int seed, MapNoiseLayer layer);
+
+// The per-cell shaping generate_map applies to the raw elevation noise:
+// continent mask (cells of continent_map below land_threshold are sunk), clamp,
+// redistribution and optional terraces, as one point-op chain.
+void mapgen_shaping_chain(const MapGenConfig* config, double** continent_map, double land_threshold,
+                          PointChain* chain);
+
+void init_map_workspace(MapGenWorkspace* ws);
+void cleanup_map_workspace(MapGenContext* ctx, MapGenWorkspace* ws);
+
+// Runs the full pipeline (noise, shaping, lakes, rivers, output) for one seed
+// using the context's config. The context is seeded with seed and every
+// stochastic stage draws from streams keyed by it, so the result depends only
+// on seed and config. png_filename may be NULL to skip
+// the PNG. Returns 0 on success.
+int generate_map(MapGenContext* ctx, MapGenWorkspace* ws,
+                 unsigned int seed, const char* png_filename);
+
+#endif // MAP_PIPELINE_H
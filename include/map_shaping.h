@@ -12,10 +12,20 @@
 // continent_map: A 2D array (double**) holding the low-frequency continent noise values [0, 1]
 // width, height: Dimensions of the maps
 // land_threshold: Value in continent_map above which is considered land potential
-void apply_continent_mask(MapData* map, double** continent_map, int width, int height, double land_threshold);
+void apply_continent_mask(MapGenContext* ctx, MapData* map, double** continent_map, int width, int height, double land_threshold);
 // ----------------------------------------
 
 // Applies terracing effect to map elevations.
-void apply_terraces(MapData* map, int num_levels);
+void apply_terraces(MapGenContext* ctx, MapData* map, int num_levels);
+
+// --- Distance-Based Shaping (see distance.h) ---
+// Raises water cells toward water_level along a continental shelf: the floor
+// falls linearly from water_level at the coast to 0 at shelf_width cells out,
+// and cells already above that profile are kept. Needs map->coast_distance.
+void apply_bathymetry(MapGenContext* ctx, MapData* map, double water_level, double shelf_width);
+
+// Adds moisture near rivers, strength at the river falling linearly to 0 at
+// range cells, clamped to 1. Needs map->river_distance.
+void apply_river_moisture(MapGenContext* ctx, MapData* map, double strength, double range);
 
 #endif // MAP_SHAPING_H
@@ -0,0 +1,31 @@
+#ifndef MAPGEN_H
+#define MAPGEN_H
+
+// Umbrella header for libmapgen. Embedders include this and link against
+// lib/libmapgen.a or lib/libmapgen.so (plus -lm -pthread).
+
+#include "mapgen_context.h"
+#include "map_data.h"
+#include "noise_generator.h"
+#include "point_ops.h"
+#include "layer_stats.h"
+#include "stage_cache.h"
+#include "stage_graph.h"
+#include "map_shaping.h"
+#include "erosion.h"
+#include "climate.h"
+#include "hydrology.h"
+#include "components.h"
+#include "watershed.h"
+#include "rivers.h"
+#include "mesh.h"
+#include "contours.h"
+#include "distance.h"
+#include "map_edit.h"
+#include "map_io.h"
+#include "map_pipeline.h"
+#include "terrain_query.h"
+#include "batch.h"
+#include "planet.h"
+
+#endif // MAPGEN_H
@@ -0,0 +1,62 @@
+#ifndef MAPGEN_CONTEXT_H
+#define MAPGEN_CONTEXT_H
+
+// --- Generation Context ---
+// Holds all state that used to be process-global: the random number generator,
+// the logging sink and the generation config. Every library entry point takes
+// a context, so independent contexts can generate maps concurrently on
+// different threads. A single context must not be used by two threads at once.
+
+#include <stdint.h>
+#include "rng.h"
+#include "arena.h"
+#include "parallel.h"
+
+typedef struct MapGenContext MapGenContext;
+
+typedef enum {
+    MAPGEN_LOG_DEBUG,
+    MAPGEN_LOG_INFO,
+    MAPGEN_LOG_WARN,
+    MAPGEN_LOG_ERROR
+} MapGenLogLevel;
+
+// Receives one complete, newline-terminated message per call.
+typedef void (*MapGenLogFn)(void* user_data, MapGenLogLevel level, const char* message);
+
+// Creates a context with default config, the stdio log sink and seed 1.
+MapGenContext* mapgen_context_create(void);
+// Creates a new context with ctx's log sink, config and seed (not its arena
+// or thread pool).
+MapGenContext* mapgen_context_clone(const MapGenContext* ctx);
+void mapgen_context_destroy(MapGenContext* ctx);
+
+// Routes messages at or above min_level to log_fn. Pass NULL to silence the context.
+void mapgen_context_set_log_sink(MapGenContext* ctx, MapGenLogFn log_fn,
+                                 void* user_data, MapGenLogLevel min_level);
+
+// Default sink: INFO/DEBUG to stdout, WARN/ERROR to stderr.
+void mapgen_log_stdio(void* user_data, MapGenLogLevel level, const char* message);
+
+void mapgen_log(const MapGenContext* ctx, MapGenLogLevel level, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// The context RNG is just a seed: stages draw counter-based streams keyed by
+// (seed, stage, index), see rng.h, so they can run in any order on any thread.
+void mapgen_context_seed(MapGenContext* ctx, uint64_t seed);
+uint64_t mapgen_context_get_seed(const MapGenContext* ctx);
+RngStream mapgen_rng_stream(const MapGenContext* ctx, RngStage stage, uint64_t index);
+
+// Optional session arena. While set, maps and stage temporaries are allocated
+// from it and are only reclaimed by arena_release/arena_reset. The context
+// does not own the arena.
+void mapgen_context_set_arena(MapGenContext* ctx, Arena* arena);
+Arena* mapgen_context_arena(const MapGenContext* ctx);
+
+// Runs fn over rows [0, count) on the context's thread pool, which is created
+// on first use from the config's num_threads/pin_threads. Every call with the
+// same count uses the same band split and the same thread per band.
+void mapgen_parallel_bands(MapGenContext* ctx, int count, BandFn fn, void* user_data);
+int mapgen_context_num_threads(MapGenContext* ctx);
+
+#endif // MAPGEN_CONTEXT_H
@@ -0,0 +1,44 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "map_data.h"
+
+// --- Adaptive Terrain Mesh ---
+// Right-triangulated irregular network (RTIN): the heightmap is triangulated
+// by recursively splitting right triangles at the midpoint of their
+// hypotenuse, only where the surface strays from the triangle by more than
+// max_error (in elevation units). Flat oceans and plains stay as a few large
+// triangles, so the mesh is far smaller than two triangles per cell.
+//
+// Vertices sit on cell corners (the average elevation of the cells around the
+// corner), so the mesh spans the map's extent exactly. The corner grid is cut
+// into MESH_TILE x MESH_TILE tiles. The approximation error of each midpoint is
+// propagated from the smallest triangles up, one level at a time across all
+// tiles. A midpoint on a tile seam therefore carries the error from both
+// sides, and neighbouring tiles split their seam edges identically: the mesh
+// has no cracks. Tile rows are processed in parallel, alternating even and
+// odd rows so no two threads write the same seam. Maps whose size is not a
+// multiple of the tile size repeat their last row and column into the padding;
+// vertices there are clamped onto the map edge and the triangles that
+// collapse are dropped.
+
+#define MESH_TILE_SHIFT 6
+#define MESH_TILE (1 << MESH_TILE_SHIFT)   // Cells per tile side
+
+typedef struct {
+    int vertex_count;
+    float* positions;           // x, y (cells from the map's top-left corner) and elevation per vertex
+    int triangle_count;
+    uint32_t* indices;          // Three vertices per triangle, counter-clockwise on the map image
+                                // (x right, y down): facing +Y with (x, elevation, y) as (X, Y, Z)
+    double max_error;
+} TerrainMesh;
+
+// Builds the mesh of map->elevation into out (arrays malloc'd; release with
+// free_terrain_mesh). Returns false if memory could not be allocated.
+bool build_terrain_mesh(MapGenContext* ctx, const MapData* map, double max_error, TerrainMesh* out);
+void free_terrain_mesh(TerrainMesh* mesh);
+
+#endif // MESH_H
@@ -3,6 +3,35 @@
 
 #include "map_data.h" // MapData needed only if funcs return it or take it
 #include <stdbool.h> // <-- Include for bool type
+#include "mapgen_context.h"
+
+// --- Wrapping ---
+// FastNoiseLite's 2D noise does not repeat, so a layer's left and right edges
+// never meet. A cylinder maps column x to the angle 2 pi x / width on a circle
+// of circumference width and samples 3D noise there (the row stays the third
+// coordinate), so the noise is continuous across the date line with cells the
+// same size as before. The torus also bends the rows around a second circle
+// of circumference height, so the top and bottom edges meet as well. Without
+// 4D noise the torus has to live in 3D: its outer side is longer than its
+// inner side, so features stretch by up to height / width horizontally (keep
+// width > height). The tube must also stay thinner than the ring, so for
+// height > 0.9 width it is shrunk to 0.9 of the ring radius (with a warning)
+// and rows are squeezed to fit.
+//
+// The cos/sin of every column's angle is computed once per layer and shared
+// by all octaves, rows and bands; each row then costs one extra evaluation of
+// its radius (and on the torus one sin/cos pair).
+
+typedef enum {
+    NOISE_WRAP_NONE,
+    NOISE_WRAP_CYLINDER,        // Left and right edges meet
+    NOISE_WRAP_TORUS,           // Top and bottom meet too
+    NOISE_WRAP_CUBE_FACE        // The layer is face cube_face of a cube-sphere (see planet.h)
+} NoiseWrap;
+
+// Parses "none", "cylinder" or "torus" (cube faces are set up by
+// mapgen_config_cube_face); returns false otherwise.
+bool noise_wrap_parse(const char* text, NoiseWrap* out);
 
 // --- NEW Struct for Noise Parameters ---
 typedef struct {
@@ -11,21 +40,63 @@ typedef struct {
     double lacunarity;
     double base_frequency;
     bool use_ridged;
+    // Adaptive resolution: 0 evaluates every octave at every cell. A positive
+    // value evaluates each octave on a coarse grid whose spacing follows its
+    // frequency and rebuilds the cells with bicubic (Catmull-Rom) interpolation,
+    // choosing the coarsest spacing whose error, measured at a fixed set of
+    // sample cells, stays below this value (absolute, on the normalized [0,1]
+    // output). That is an empirical target, not a bound: cells between the
+    // samples can exceed it. Octaves that would need a spacing below 2 cells are
+    // still evaluated directly.
+    double max_interp_error;
+    // Periods are the width and height of the layer (for sample_octave_noise,
+    // the map size given to it).
+    NoiseWrap wrap;
+    int cube_face;              // CubeFace, with NOISE_WRAP_CUBE_FACE
     // Could add seed here too if desired
 } NoiseParams;
 // --------------------------------------
 
 typedef struct NoiseState NoiseState;
 
-NoiseState* init_noise_generator(int seed);
-void cleanup_noise_generator(NoiseState* state);
+NoiseState* init_noise_generator(MapGenContext* ctx, int seed);
+void cleanup_noise_generator(MapGenContext* ctx, NoiseState* state);
+// Changes the seed of an existing state so it can be reused for another map.
+void reseed_noise_generator(NoiseState* state, int seed);
 
 // Modified signature: takes NoiseParams struct
-void generate_octave_noise_to_layer(NoiseState* state,
+void generate_octave_noise_to_layer(MapGenContext* ctx, NoiseState* state,
                                     int width, int height,
                                     double** target_layer,
                                     const NoiseParams* params); // Pass struct by const pointer
 
+// --- Fused Multi-Channel Traversal ---
+#define NOISE_MAX_CHANNELS 8
+
+// One output layer of generate_octave_noise_fused.
+typedef struct {
+    NoiseState* state;
+    double** target_layer;
+    const NoiseParams* params;
+} NoiseChannel;
+
+// Fills every channel's layer in a single traversal of the map, evaluating all
+// channels per cell (one scalar noise call per channel and octave; the
+// traversal is shared, the evaluations are not batched). Each layer is identical to what
+// generate_octave_noise_to_layer would produce for that channel; channels with
+// max_interp_error > 0 are delegated to it (adaptive grids are per channel).
+void generate_octave_noise_fused(MapGenContext* ctx, int width, int height,
+                                    const NoiseChannel* channels, int num_channels);
+
+// Normalized octave noise at count arbitrary points (x[i], y[i]) in map
+// cells, written to out. Identical to the per-cell layer of a width x height
+// map at integer points; max_interp_error is ignored (every octave is
+// evaluated exactly; terrain_query_check_noise verifies this). Octaves run in
+// the outer loop so the frequency is set once per octave; each point is still
+// one scalar noise call per octave.
+void sample_octave_noise(const NoiseState* state, const NoiseParams* params, int width, int height,
+                         const float* x, const float* y, int count, double* out);
+
 float get_noise_value(NoiseState* state, float x, float y);
 
 #endif // NOISE_GENERATOR_H
@@ -0,0 +1,42 @@
+#ifndef PAGE_ALLOC_H
+#define PAGE_ALLOC_H
+
+#include <stddef.h>
+
+// --- Page-Level Allocation for Large Layers ---
+// Maps large blocks directly with mmap so they can be backed by huge pages and
+// placed on NUMA nodes by first touch, instead of whatever malloc hands out.
+
+typedef enum {
+    PAGE_MODE_DEFAULT,         // Regular heap allocation
+    PAGE_MODE_TRANSPARENT_HUGE,// mmap + madvise(MADV_HUGEPAGE)
+    PAGE_MODE_EXPLICIT_HUGE    // mmap(MAP_HUGETLB); falls back to transparent
+} PageMode;
+
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define PAGE_STATS_MAX_NODES 8
+
+// Maps at least size bytes (rounded up to HUGE_PAGE_SIZE). The memory is not
+// touched, so no physical pages exist until first write. *mapped_size receives
+// the length to pass to page_free; *page_size the size actually requested from
+// the kernel (HUGE_PAGE_SIZE for hugetlb, otherwise the base page size).
+void* page_alloc(size_t size, PageMode mode, size_t* mapped_size, size_t* page_size);
+void page_free(void* ptr, size_t mapped_size);
+
+typedef struct {
+    size_t kernel_page_size;   // From /proc/self/smaps, 0 if unknown
+    size_t mapping_bytes;      // Size of the mapping containing the range
+    size_t huge_bytes;         // AnonHugePages (THP) or hugetlb bytes of that mapping
+    size_t total_bytes;
+    int sampled_pages;         // Pages queried for their node
+    int node_pages[PAGE_STATS_MAX_NODES]; // Sampled pages per node
+    int unplaced_pages;        // Sampled pages not yet faulted in / query failed
+} PageStats;
+
+// Reports page size and NUMA placement of [ptr, ptr + size). Sampling is
+// bounded, so this is cheap enough to call once per map.
+void page_query_stats(const void* ptr, size_t size, PageStats* stats);
+
+const char* page_mode_name(PageMode mode);
+
+#endif // PAGE_ALLOC_H
@@ -0,0 +1,35 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+
+// --- Band-Parallel Thread Pool ---
+// Splits a row range into one contiguous band per thread. The split only
+// depends on the row count and thread count, and band b always runs on pool
+// thread b (band 0 on the calling thread). So the thread that first touches a
+// band of a freshly allocated layer is the one that processes that band in
+// every later stage, and its pages stay on that thread's NUMA node.
+
+typedef struct ThreadPool ThreadPool;
+
+// Called once per band with rows [begin, end).
+typedef void (*BandFn)(void* user_data, int begin, int end, int band);
+
+// num_threads <= 0 means one thread per online core. With pin_threads, the
+// helper threads (bands 1 and up) are bound to consecutive CPUs taken from a
+// process-wide cursor, so concurrent pools land on different cores. The
+// calling thread (band 0) keeps its affinity, and one-thread pools pin nothing.
+ThreadPool* thread_pool_create(int num_threads, bool pin_threads);
+void thread_pool_destroy(ThreadPool* pool);
+int thread_pool_size(const ThreadPool* pool);
+
+// Runs fn over [0, count) split into thread_pool_size() bands and waits for all
+// of them. A NULL pool runs everything as a single band on the caller.
+void thread_pool_run_bands(ThreadPool* pool, int count, BandFn fn, void* user_data);
+
+// Band b of num_bands over [0, count); identical to the split used above.
+void band_range(int count, int num_bands, int band, int* begin, int* end);
+
+int online_cpu_count(void);
+
+#endif // PARALLEL_H
@@ -0,0 +1,78 @@
+#ifndef PLANET_H
+#define PLANET_H
+
+#include <math.h>
+#include "map_pipeline.h"
+
+// --- Cube-Sphere Planets ---
+// A planet is six square maps, the faces of a cube blown up onto the sphere.
+// Each face is generated by the usual pipeline (shaping, hydrology, climate,
+// biomes) with its noise sampled in 3D at the sphere point of every cell
+// (NOISE_WRAP_CUBE_FACE), so the terrain runs on across the face edges. The
+// faces are independent maps and are generated in parallel, one per worker.
+// Latitude comes from the sphere point too. The faces are then reprojected
+// into one equirectangular (longitude x latitude) image.
+//
+// Faces use the equal-angle projection: cell x of a size-cell face sits at
+// angle pi/4 * a off the face center, a = (2x + 1) / size - 1, which keeps
+// cell areas on the sphere within a factor 1.42 of each other (5.2 for the
+// plain gnomonic cube). The poles are +y and -y.
+//
+// Only the noise and the climate see the sphere. Lakes, rivers and erosion
+// still stop at the face edges, and target_land_fraction is ignored (a
+// threshold per face would not match across the edges).
+
+typedef enum {
+    CUBE_FACE_POS_X,
+    CUBE_FACE_NEG_X,
+    CUBE_FACE_POS_Y,            // North pole
+    CUBE_FACE_NEG_Y,            // South pole
+    CUBE_FACE_POS_Z,
+    CUBE_FACE_NEG_Z,
+    CUBE_FACE_COUNT
+} CubeFace;
+
+// "px", "nx", "py", "ny", "pz" or "nz".
+const char* cube_face_name(int face);
+
+// Tangent-plane coordinate of cell coordinate c (fractional and off-face
+// values follow the same formula).
+static inline double cube_face_tangent(double c, int size) {
+    return tan(M_PI_4 * ((2.0 * c + 1.0) / size - 1.0));
+}
+
+// Point normal + u * right + v * down of face (not normalized), right and
+// down being the face's x and y directions.
+static inline void cube_face_point(int face, double u, double v, double* p) {
+    static const signed char BASIS[CUBE_FACE_COUNT][3][3] = {
+        { {  1, 0, 0 }, {  0, 0, -1 }, { 0, -1,  0 } },
+        { { -1, 0, 0 }, {  0, 0,  1 }, { 0, -1,  0 } },
+        { { 0,  1, 0 }, {  1, 0,  0 }, { 0,  0,  1 } },
+        { { 0, -1, 0 }, {  1, 0,  0 }, { 0,  0, -1 } },
+        { { 0, 0,  1 }, {  1, 0,  0 }, { 0, -1,  0 } },
+        { { 0, 0, -1 }, { -1, 0,  0 }, { 0, -1,  0 } },
+    };
+    const signed char (*b)[3] = BASIS[face];
+    for (int k = 0; k < 3; k++) p[k] = b[0][k] + u * b[1][k] + v * b[2][k];
+}
+
+// Face that direction d points into, with the cell coordinates (x, y) of d
+// on a size-cell face (cube_face_tangent inverted).
+int cube_face_locate(const double* d, int size, double* x, double* y);
+
+// Latitude of point (x, y) of a face as the temperature stage uses it: 0 at
+// the equator, 1 at the poles.
+double cube_face_latitude(int face, int size, double x, double y);
+
+// Sets config up to generate face of a planet with size x size faces.
+void mapgen_config_cube_face(MapGenConfig* config, int face, int size);
+
+// Generates the six faces of a planet with num_workers threads (each with
+// its own context clone and workspace). Each face gets at most
+// cores / num_workers band threads and is never pinned. Writes each face to
+// <output_dir>/planet_<seed>_<face>.png and the equirectangular map
+// (4 * face_size x 2 * face_size) to equirect_filename. Returns 0 on success.
+int generate_planet(MapGenContext* ctx, unsigned int seed, int face_size, int num_workers,
+                    const char* output_dir, const char* equirect_filename);
+
+#endif // PLANET_H
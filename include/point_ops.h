@@ -0,0 +1,71 @@
+#ifndef POINT_OPS_H
+#define POINT_OPS_H
+
+#include <stdbool.h>
+#include "mapgen_context.h"
+
+// --- Point-Operation Chains ---
+// A chain is a short list of per-cell operations (each cell's new value only
+// depends on its old value and, for masks, the same cell of another layer).
+// point_chain_apply runs the whole chain in one banded pass: each band walks
+// its part of the layer in small blocks and applies every operation to a
+// block while it is in L1, so N operations cost one trip through memory
+// instead of N. The kernels are branch-free select loops the compiler can
+// vectorize. Layers and masks are walked row by row (layer[y]), so their rows
+// need not be contiguous.
+
+#define POINT_CHAIN_MAX_OPS 8
+
+typedef enum {
+    POINT_OP_MASK_BELOW,    // value = mask < threshold ? replacement : value
+    POINT_OP_CLAMP,         // value = clamp(value, lo, hi)
+    POINT_OP_POW,           // value = value ^ exponent
+    POINT_OP_TERRACE        // value = round(value * (levels - 1)) / (levels - 1), in [0, 1]
+} PointOpType;
+
+typedef struct {
+    PointOpType type;
+    double a;               // MASK_BELOW threshold, CLAMP lo, POW exponent, TERRACE levels - 1
+    double b;               // MASK_BELOW replacement, CLAMP hi, POW max error
+    double** mask;          // MASK_BELOW only, same size as the target layer
+} PointOp;
+
+typedef struct {
+    int count;
+    PointOp ops[POINT_CHAIN_MAX_OPS];
+} PointChain;
+
+void point_chain_init(PointChain* chain);
+
+// Each append returns false if the chain is full or the arguments are invalid.
+bool point_chain_mask_below(PointChain* chain, double** mask, double threshold, double replacement);
+bool point_chain_clamp(PointChain* chain, double lo, double hi);
+// An exponent of 0 is taken as 1e-9 (see redistribute_map). max_error 0 calls
+// pow() per cell. A positive bound interpolates a lookup
+// table over [0, 1] whose size is grown until the measured error is within
+// max_error; values outside [0, 1] still go through pow().
+bool point_chain_pow(PointChain* chain, double exponent, double max_error);
+bool point_chain_terrace(PointChain* chain, int levels);
+
+// pow tables of a chain (slot o for operation o; NULL where pow() is called),
+// exactly as point_chain_apply builds them.
+typedef struct {
+    double* luts[POINT_CHAIN_MAX_OPS];
+    int lut_sizes[POINT_CHAIN_MAX_OPS];
+} PointChainTables;
+
+// Builds the tables from the context arena; release with point_chain_free_tables.
+void point_chain_build_tables(MapGenContext* ctx, const PointChain* chain, PointChainTables* tables);
+void point_chain_free_tables(MapGenContext* ctx, PointChainTables* tables);
+
+// The chain applied to a single value, with mask operations skipped (as if
+// the cell were not masked). With tables, pow goes through the same kernel as
+// point_chain_apply, so the result matches the applied layer bit for bit;
+// NULL evaluates pow() exactly.
+double point_chain_eval(const PointChain* chain, const PointChainTables* tables, double value);
+
+// Applies the chain to layer in place, in order, on the context thread pool.
+void point_chain_apply(MapGenContext* ctx, const PointChain* chain,
+                       double** layer, int width, int height);
+
+#endif // POINT_OPS_H
@@ -0,0 +1,59 @@
+#ifndef RIVERS_H
+#define RIVERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "map_data.h"
+
+// --- River Vectors ---
+// generate_rivers records the cells of every carved river in map->river_paths
+// (one fixed-size slot per attempted river, so the stage cache can store the
+// paths with the other layers). From them, a river network holds each river as
+// a polyline of cell coordinates from its source downstream. A river that runs
+// into an earlier one ends at the confluence and records which river it
+// joins, so shared stretches appear once and the rivers form trees. Polylines
+// are simplified with Douglas-Peucker: a vertex is kept only if the path
+// strays more than the tolerance (in cells) from the chord that would
+// replace it, so tolerance 0 only drops the inner cells of straight runs.
+
+typedef struct {
+    int x, y;                   // Cell coordinates
+} RiverVertex;
+
+typedef struct {
+    int first;                  // Index of the source vertex in RiverNetwork.vertices
+    int count;                  // Vertices after simplification, source first
+    int cells;                  // Cells of the full-resolution path
+    double length;              // Along the full path, in cells (diagonal steps count sqrt(2))
+    int joins;                  // River this one flows into at its last vertex, or -1
+    int order;                  // Strahler order: 1 without tributaries, +1 where two of the
+                                // highest order meet
+} RiverPolyline;
+
+struct RiverNetwork {
+    int count;
+    RiverPolyline* rivers;      // In generation order
+    int vertex_count;
+    RiverVertex* vertices;
+    double tolerance;           // Douglas-Peucker tolerance the network was built with
+};
+
+// Sizes map->river_paths for num_rivers paths of up to max_length cells,
+// allocated in the map's arena; keeps the slots if they already fit. All
+// slots start empty.
+bool map_reserve_river_paths(MapGenContext* ctx, MapData* map, int num_rivers, int max_length);
+
+// Frees map->river_network so the next map_river_network rebuilds it, for
+// when map->river_paths change.
+void map_drop_river_network(MapData* map);
+
+// Builds the network of map->river_paths into out, whose arrays are allocated
+// with scratch_alloc from arena. Returns false if memory could not be allocated.
+bool build_river_network(MapGenContext* ctx, const MapData* map, double tolerance,
+                         Arena* arena, RiverNetwork* out);
+
+// Network of map, kept in map->river_network and rebuilt when tolerance
+// differs from the last call. NULL if the map has no river paths.
+const RiverNetwork* map_river_network(MapGenContext* ctx, MapData* map, double tolerance);
+
+#endif // RIVERS_H
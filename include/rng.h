@@ -0,0 +1,65 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// --- Counter-Based Random Streams ---
+// Every random value is a pure function of (seed, stage, index, counter), built
+// from the SplitMix64 finalizer. A stream for e.g. river #17 can be created on
+// any thread, in any order, and always yields the same sequence for a given
+// seed, so stochastic stages are reproducible and trivially parallel. No libc
+// rand() is involved, so results are identical across platforms.
+
+// Stage identifiers keep the streams of different stages independent.
+// Append new stages at the end so existing seeds keep producing the same maps.
+typedef enum {
+    RNG_STAGE_NOISE_SEEDS = 1,
+    RNG_STAGE_RIVERS = 2,
+    RNG_STAGE_EROSION = 3
+} RngStage;
+
+typedef struct {
+    uint64_t key;      // Derived from seed, stage and index
+    uint64_t counter;  // Position within the stream
+} RngStream;
+
+static inline uint64_t rng_mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline RngStream rng_stream(uint64_t seed, uint32_t stage, uint64_t index) {
+    RngStream stream;
+    stream.key = rng_mix64(rng_mix64(seed ^ ((uint64_t)stage * 0x9E3779B97F4A7C15ULL))
+                           + index * 0xD1B54A32D192ED03ULL);
+    stream.counter = 0;
+    return stream;
+}
+
+// Value number `counter` of the stream, without touching any state.
+static inline uint64_t rng_at(const RngStream* stream, uint64_t counter) {
+    return rng_mix64(stream->key + (counter + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+static inline uint64_t rng_next_u64(RngStream* stream) {
+    return rng_at(stream, stream->counter++);
+}
+
+// Uniform integer in [0, bound) using the multiply-shift reduction.
+static inline uint32_t rng_next_below(RngStream* stream, uint32_t bound) {
+    return (uint32_t)(((rng_next_u64(stream) >> 32) * (uint64_t)bound) >> 32);
+}
+
+// Uniform double in [0, 1) with 53 random bits.
+static inline double rng_next_double(RngStream* stream) {
+    return (double)(rng_next_u64(stream) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Single value keyed by (seed, stage, index); handy for deriving sub-seeds.
+static inline uint64_t rng_hash(uint64_t seed, uint32_t stage, uint64_t index) {
+    RngStream stream = rng_stream(seed, stage, index);
+    return rng_at(&stream, 0);
+}
+
+#endif // RNG_H
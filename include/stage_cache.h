@@ -0,0 +1,56 @@
+#ifndef STAGE_CACHE_H
+#define STAGE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mapgen_context.h"
+
+// --- Stage Cache ---
+// Snapshots of the layers a stage wrote, keyed by a 64-bit hash of the
+// stage's parameters and of the versions of the layers it read (see
+// stage_graph.h). Entries live in memory up to a byte budget, evicting the
+// least recently used first, and optionally also as one file per key in a
+// directory, so they survive across processes. Files are written to a
+// temporary name and renamed into place, so several processes (or batch
+// workers) can share one directory. The directory has its own byte budget:
+// past it, the files used least recently (by modification time, refreshed on
+// every load) are deleted. All functions are thread-safe, and file reads and
+// writes run outside the cache lock.
+
+typedef struct StageCache StageCache;
+typedef struct StageCacheEntry StageCacheEntry;
+
+// One layer of a snapshot: id is the stage layer bit, data/bytes its memory.
+typedef struct {
+    unsigned id;
+    void* data;
+    size_t bytes;
+} CachedLayer;
+
+StageCache* stage_cache_create(void);
+void stage_cache_destroy(StageCache* cache);
+// memory_limit bytes of snapshots stay in memory; directory may be NULL for
+// an in-memory cache only. The directory is created if missing and holds at
+// most disk_limit bytes of entry files (0 = unlimited).
+void stage_cache_configure(StageCache* cache, size_t memory_limit, const char* directory, size_t disk_limit);
+bool stage_cache_enabled(StageCache* cache);
+
+// Finds key in memory or on disk (loading it into memory) and pins it so it is
+// not evicted before stage_cache_release. Returns NULL on a miss.
+StageCacheEntry* stage_cache_acquire(MapGenContext* ctx, StageCache* cache, uint64_t key);
+// Copies a pinned entry into layers (matched by id and size). Returns false if
+// the entry does not hold all of them.
+bool stage_cache_restore(const StageCacheEntry* entry, const CachedLayer* layers, int count);
+void stage_cache_release(StageCache* cache, StageCacheEntry* entry);
+
+// Snapshots layers under key (in memory and, with a directory, on disk).
+void stage_cache_store(MapGenContext* ctx, StageCache* cache, uint64_t key,
+                       const CachedLayer* layers, int count);
+
+// Building blocks for stage keys.
+uint64_t stage_hash_u64(uint64_t hash, uint64_t value);
+uint64_t stage_hash_double(uint64_t hash, double value);
+uint64_t stage_hash_string(uint64_t hash, const char* text);
+
+#endif // STAGE_CACHE_H
@@ -0,0 +1,97 @@
+#ifndef STAGE_GRAPH_H
+#define STAGE_GRAPH_H
+
+#include <stdbool.h>
+#include "mapgen_context.h"
+#include "stage_cache.h"
+
+// --- Stage Graph ---
+// A pipeline is a list of stages, each declaring which layers it reads and
+// writes. A stage depends on every earlier stage it conflicts with (it reads
+// what the earlier one writes, writes what it reads, or writes the same
+// layer), so adding stages in the order of the sequential pipeline gives the
+// same results however they are scheduled.
+//
+// stage_graph_run executes the graph on a number of lanes. Lane 0 is the
+// calling thread with the caller's context (its band pool and session arena);
+// the other lanes are helper threads with cloned contexts whose band work runs
+// single-threaded and whose scratch comes from the heap. Stages flagged
+// STAGE_USES_POOL only run on lane 0, so band-parallel stages keep the full
+// pool while independent serial stages overlap with them on the helpers.
+//
+// With a cache attached, stages given a key (stage_graph_set_key) are
+// memoized: a stage's cache key combines its parameter hash with the versions
+// of the layers it touches, and the stage's key becomes the new version of the
+// layers it writes. A stage whose key is cached restores its outputs instead
+// of running, or is skipped entirely when later cached stages overwrite those
+// outputs before anything else reads them. So changing a downstream parameter
+// only re-runs the stages from there on.
+//
+// Dependencies are per layer, not per row: a stage starts only once every
+// stage it depends on has finished the whole map. In particular the map
+// pipeline renders in one barrier stage after the final layers are complete
+// and writes the PNG after that; no rows are rendered or streamed early.
+
+#define STAGE_GRAPH_MAX_STAGES 32
+#define STAGE_GRAPH_MAX_LAYERS 16
+
+// Layer bits for the inputs/outputs masks.
+typedef enum {
+    STAGE_LAYER_ELEVATION = 1u << 0,
+    STAGE_LAYER_MOISTURE  = 1u << 1,
+    STAGE_LAYER_CONTINENT = 1u << 2,
+    STAGE_LAYER_RIVERS    = 1u << 3,
+    STAGE_LAYER_IMAGE     = 1u << 4,    // Rendered pixels
+    STAGE_LAYER_OUTPUT    = 1u << 5,    // Files and console; keeps outputs in order
+    STAGE_LAYER_COAST_DISTANCE = 1u << 6,
+    STAGE_LAYER_RIVER_DISTANCE = 1u << 7,
+    STAGE_LAYER_COMPONENTS     = 1u << 8,   // Water body / landmass labels
+    STAGE_LAYER_BASINS         = 1u << 9,   // Drainage basin labels
+    STAGE_LAYER_TEMPERATURE    = 1u << 10,
+    STAGE_LAYER_RIVER_PATHS    = 1u << 11   // Cells of each carved river (see rivers.h)
+} StageLayer;
+
+// Stage flags.
+#define STAGE_USES_POOL 1u
+#define STAGE_CACHEABLE 2u      // Set by stage_graph_set_key
+
+// Returns 0 on success; any other value stops the graph.
+typedef int (*StageFn)(MapGenContext* ctx, void* user_data);
+
+typedef struct {
+    const char* name;
+    unsigned inputs;
+    unsigned outputs;
+    unsigned flags;
+    StageFn fn;
+    void* user_data;
+    uint64_t param_hash;        // Cacheable stages: hash of every parameter read
+} Stage;
+
+typedef struct {
+    int count;
+    Stage stages[STAGE_GRAPH_MAX_STAGES];
+    StageCache* cache;          // NULL: no memoization
+    uint64_t base_hash;         // Version of every layer before the first stage
+    CachedLayer layers[STAGE_GRAPH_MAX_LAYERS];  // Indexed by layer bit position
+} StageGraph;
+
+void stage_graph_init(StageGraph* graph);
+// Returns the stage index, or -1 if the graph is full.
+int stage_graph_add(StageGraph* graph, const char* name, unsigned inputs, unsigned outputs,
+                    unsigned flags, StageFn fn, void* user_data);
+
+// Makes stage index cacheable under param_hash.
+void stage_graph_set_key(StageGraph* graph, int index, uint64_t param_hash);
+// Memory of a layer, for snapshots. Only bound layers can be cached.
+void stage_graph_bind_layer(StageGraph* graph, unsigned layer, void* data, size_t bytes);
+// Attaches a cache; base_hash identifies the initial layer contents (e.g.
+// the map size).
+void stage_graph_set_cache(StageGraph* graph, StageCache* cache, uint64_t base_hash);
+
+// Runs every stage once dependencies allow, on up to num_lanes lanes (<= 1
+// runs the stages in order on the caller). Once a stage fails no new stages
+// start. Returns 0 if every stage succeeded.
+int stage_graph_run(MapGenContext* ctx, const StageGraph* graph, int num_lanes);
+
+#endif // STAGE_GRAPH_H
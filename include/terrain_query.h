@@ -0,0 +1,57 @@
+#ifndef TERRAIN_QUERY_H
+#define TERRAIN_QUERY_H
+
+#include <stdbool.h>
+#include "map_pipeline.h"
+#include "climate.h"
+
+// --- Point Queries ---
+// Terrain at arbitrary coordinates without generating a map: the per-cell
+// part of the pipeline (octave noise, continent mask, redistribution,
+// terraces, temperature and biome) evaluated only where asked. Coordinates
+// are in map cells, so at integer points of a config->width x height map the
+// results equal what generate_map computes before its non-local stages.
+// Lakes, rivers, erosion, wind, distance shaping and land-fraction targeting
+// need the whole map and are not applied.
+//
+// Points are processed in blocks: each noise channel is sampled for a whole
+// block (one scalar noise call per point and octave), then the shaping chain
+// and the climate math run over the block as branch-free loops. Blocks are split across the context's thread pool; no
+// memory is allocated per query.
+
+typedef struct {
+    double elevation;
+    double moisture;
+    double temperature;     // See climate.h
+    Biome biome;
+} TerrainSample;
+
+typedef struct {
+    NoiseState* elevation_noise;
+    NoiseState* moisture_noise;
+    NoiseState* continent_noise;
+    MapGenConfig config;        // Copy, with the redistribution evaluated exactly
+    double land_threshold;      // Continent threshold; config->continent_land_threshold
+                                // by default, may be set to a threshold a
+                                // land-fraction map was generated with
+} TerrainQuery;
+
+// Prepares query for the maps config generates from seed. Returns false if
+// the noise states could not be allocated.
+bool terrain_query_init(MapGenContext* ctx, TerrainQuery* query, const MapGenConfig* config, unsigned int seed);
+void terrain_query_cleanup(MapGenContext* ctx, TerrainQuery* query);
+
+// Samples count points (x[i], y[i]) into out.
+void terrain_query_sample(MapGenContext* ctx, const TerrainQuery* query, const double* x, const double* y,
+                          int count, TerrainSample* out);
+
+// One point; batches amortize much better.
+TerrainSample terrain_query_point(const TerrainQuery* query, double x, double y);
+
+// Checks the guarantee above for the noise channels: generates each channel's
+// config->width x height layer exactly (adaptive grids off) and samples every
+// cell at its integer coordinates. Returns the largest absolute difference
+// (0 when the guarantee holds), or -1 if the layers could not be allocated.
+double terrain_query_check_noise(MapGenContext* ctx, const TerrainQuery* query);
+
+#endif // TERRAIN_QUERY_H
@@ -0,0 +1,68 @@
+#ifndef WATERSHED_H
+#define WATERSHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "map_data.h"
+
+// --- Drainage Basins ---
+// Every land cell drains to its lowest strictly lower neighbour (the rule
+// generate_rivers traces, so a river never leaves its basin). A cell with no
+// such neighbour, or whose lowest neighbour is water, is an outlet, and a
+// basin is the tree of cells draining to one outlet. Water is taken from the
+// component labels when the map has them (filled lakes count as water, carved
+// river beds as land), else from elevation below the water level.
+//
+// One pass stores each cell's flow direction in a byte; basins are then
+// labeled by walking every outlet's tree upstream. Each cell is visited once
+// and the walk needs no stack (a cell's parent is its flow direction), so
+// outlets are split across the thread pool with no per-thread memory. Ids
+// number outlets in raster order, whatever the thread count.
+
+#define BASIN_NONE (-1)         // Label of water cells
+
+typedef enum {
+    BASIN_DRAINS_OCEAN,         // Outlet flows into water that reaches the map edge
+    BASIN_DRAINS_LAKE,          // ... into an enclosed water body
+    BASIN_DRAINS_EDGE,          // Outlet on the map edge with nothing lower inside
+    BASIN_SINK                  // Closed depression or flat above the water level
+} BasinOutlet;
+
+typedef struct {
+    long long area;             // Cells
+    MapRect bbox;
+    int outlet_x, outlet_y;
+    BasinOutlet outlet;
+    int32_t water_body;         // Component id drained into, or -1 (see components.h)
+    double outlet_elevation;
+    double peak_elevation;
+} BasinStats;
+
+struct BasinTable {
+    int count;
+    BasinStats* stats;          // Indexed by basin id
+};
+
+// Labels every cell of map into basins (a width x height layer) and fills
+// out, whose stats are allocated with scratch_alloc from arena. Returns false
+// if memory could not be allocated.
+bool label_basins(MapGenContext* ctx, MapData* map, double water_level, int32_t** basins,
+                  Arena* arena, BasinTable* out);
+
+// label_basins into map->basin and map->basins, allocating the layer in the
+// map's arena if needed.
+bool map_compute_basins(MapGenContext* ctx, MapData* map, double water_level);
+
+// Table of map->basin, recomputed on first use when the labels were restored
+// without it (e.g. from the stage cache) or flagged MAP_STALE_BASINS by an
+// edit, or NULL if the map has no labels.
+const BasinTable* map_basins(MapGenContext* ctx, MapData* map, double water_level);
+
+// Basin id of cell (x, y), or BASIN_NONE for water and cells off the map.
+// After map_update_dirty the labels are stale until map_basins.
+static inline int32_t map_basin_at(const MapData* map, int x, int y) {
+    if (!map->basin || x < 0 || y < 0 || x >= map->width || y >= map->height) return BASIN_NONE;
+    return map->basin[y][x];
+}
+
+#endif // WATERSHED_H
@@ -0,0 +1,152 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t capacity;  // Usable bytes after the header
+    size_t offset;    // Bytes handed out from this block
+    size_t mapped;    // page_alloc length, 0 for heap blocks
+    unsigned char* data;
+};
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static ArenaBlock* create_block(size_t capacity, PageMode mode) {
+    ArenaBlock* block = malloc(sizeof(ArenaBlock));
+    if (!block) return NULL;
+    capacity = align_up(capacity, ARENA_ALIGNMENT);
+    block->mapped = 0;
+    if (mode != PAGE_MODE_DEFAULT) {
+        size_t page_size;
+        block->data = page_alloc(capacity, mode, &block->mapped, &page_size);
+        if (block->data) capacity = block->mapped; // Use the whole mapping
+    } else {
+        block->data = aligned_alloc(ARENA_ALIGNMENT, capacity);
+    }
+    if (!block->data) {
+        free(block);
+        return NULL;
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    block->offset = 0;
+    return block;
+}
+
+static void free_block(ArenaBlock* block) {
+    if (block->mapped) page_free(block->data, block->mapped);
+    else free(block->data);
+    free(block);
+}
+
+void arena_init(Arena* arena, size_t block_size) {
+    if (!arena) return;
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->reserved = 0;
+    arena->used = 0;
+    arena->peak_used = 0;
+    arena->page_mode = PAGE_MODE_DEFAULT;
+}
+
+void arena_destroy(Arena* arena) {
+    if (!arena) return;
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free_block(block);
+        block = next;
+    }
+    PageMode mode = arena->page_mode;
+    arena_init(arena, arena->block_size);
+    arena->page_mode = mode;
+}
+
+void arena_set_page_mode(Arena* arena, PageMode mode) {
+    if (arena) arena->page_mode = mode;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    if (!arena) return NULL;
+    size = align_up(size > 0 ? size : 1, ARENA_ALIGNMENT);
+
+    ArenaBlock* block = arena->current;
+    // Walk forward through blocks kept from earlier sessions before creating new ones
+    while (block && block->offset + size > block->capacity) {
+        block = block->next;
+        if (block) block->offset = 0;
+    }
+
+    if (!block) {
+        size_t capacity = size > arena->block_size ? size : arena->block_size;
+        block = create_block(capacity, arena->page_mode);
+        if (!block) return NULL;
+        arena->reserved += block->capacity;
+        // Append after the current block so release order stays linear
+        if (!arena->head) {
+            arena->head = block;
+        } else {
+            ArenaBlock* tail = arena->current ? arena->current : arena->head;
+            while (tail->next) tail = tail->next;
+            tail->next = block;
+        }
+    }
+
+    void* ptr = block->data + block->offset;
+    block->offset += size;
+    arena->current = block;
+    arena->used += size;
+    if (arena->used > arena->peak_used) arena->peak_used = arena->used;
+    return ptr;
+}
+
+void* arena_calloc(Arena* arena, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void* ptr = arena_alloc(arena, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+ArenaMark arena_mark(const Arena* arena) {
+    ArenaMark mark = { NULL, 0, 0 };
+    if (!arena) return mark;
+    mark.block = arena->current;
+    mark.offset = arena->current ? arena->current->offset : 0;
+    mark.used = arena->used;
+    return mark;
+}
+
+void arena_release(Arena* arena, ArenaMark mark) {
+    if (!arena) return;
+    if (!mark.block) {
+        arena_reset(arena);
+        return;
+    }
+    arena->current = mark.block;
+    mark.block->offset = mark.offset;
+    arena->used = mark.used;
+}
+
+void arena_reset(Arena* arena) {
+    if (!arena) return;
+    arena->current = arena->head;
+    if (arena->head) arena->head->offset = 0;
+    arena->used = 0;
+}
+
+void* scratch_alloc(Arena* arena, size_t size) {
+    return arena ? arena_alloc(arena, size) : malloc(size);
+}
+
+void* scratch_calloc(Arena* arena, size_t count, size_t size) {
+    return arena ? arena_calloc(arena, count, size) : calloc(count, size);
+}
+
+void scratch_free(Arena* arena, void* ptr) {
+    if (!arena) free(ptr);
+}
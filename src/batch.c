@@ -0,0 +1,190 @@
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "map_io.h"
+#include "watershed.h"
+
+#define BATCH_LINE_MAX 1024
+#define BATCH_PATH_MAX 4096
+
+bool mapgen_config_set(MapGenConfig* config, const char* key, const char* value) {
+    if (strcmp(key, "width") == 0) config->width = atoi(value);
+    else if (strcmp(key, "height") == 0) config->height = atoi(value);
+    else if (strcmp(key, "rivers") == 0) config->num_rivers = atoi(value);
+    else if (strcmp(key, "exponent") == 0) config->redistribution_exponent = atof(value);
+    else if (strcmp(key, "land_threshold") == 0) config->continent_land_threshold = atof(value);
+    else if (strcmp(key, "land_fraction") == 0) config->target_land_fraction = atof(value);
+    else if (strcmp(key, "erosion") == 0) config->erosion.droplets = atoll(value);
+    else if (strcmp(key, "thermal") == 0) config->thermal.iterations = atoi(value);
+    else if (strcmp(key, "talus") == 0) config->thermal.talus = atof(value);
+    else if (strcmp(key, "shelf") == 0) config->shelf_width = atof(value);
+    else if (strcmp(key, "river_moisture") == 0) config->river_moisture = atof(value);
+    else if (strcmp(key, "wind") == 0) config->wind.strength = atof(value);
+    else if (strcmp(key, "wind_from") == 0) return wind_direction_parse(value, &config->wind.direction);
+    else if (strcmp(key, "basins") == 0) config->compute_basins = atoi(value) != 0;
+    else if (strcmp(key, "lake_level") == 0) config->ocean_level_for_lakes = atof(value);
+    else if (strcmp(key, "wrap") == 0) {
+        NoiseWrap wrap;
+        if (!noise_wrap_parse(value, &wrap)) return false;
+        config->elev_params.wrap = wrap;
+        config->moist_params.wrap = wrap;
+        config->cont_params.wrap = wrap;
+    }
+    else if (strcmp(key, "terraces") == 0) {
+        config->num_terrace_levels = atoi(value);
+        config->apply_terracing = config->num_terrace_levels > 0;
+    }
+    else return false;
+    return true;
+}
+
+int load_batch_jobs(MapGenContext* ctx, const char* path, const MapGenConfig* base,
+                    BatchJob** out_jobs, int* out_count)
+{
+    if (!path || !base || !out_jobs || !out_count) return 1;
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error opening batch job file %s\n", path);
+        return 1;
+    }
+
+    BatchJob* jobs = NULL;
+    int count = 0;
+    int capacity = 0;
+    char line[BATCH_LINE_MAX];
+    int line_number = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char* saveptr = NULL;
+        char* token = strtok_r(line, " \t\r\n", &saveptr);
+        if (!token || token[0] == '#') continue;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            BatchJob* grown = realloc(jobs, capacity * sizeof(BatchJob));
+            if (!grown) {
+                mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error allocating batch jobs\n");
+                free(jobs);
+                fclose(file);
+                return 1;
+            }
+            jobs = grown;
+        }
+
+        BatchJob* job = &jobs[count];
+        job->seed = (unsigned int)strtoul(token, NULL, 10);
+        job->config = *base;
+
+        while ((token = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL) {
+            char* eq = strchr(token, '=');
+            if (!eq) {
+                mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: %s:%d: ignoring malformed override '%s'.\n", path, line_number, token);
+                continue;
+            }
+            *eq = '\0';
+            if (!mapgen_config_set(&job->config, token, eq + 1)) {
+                mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: %s:%d: unknown key '%s'.\n", path, line_number, token);
+            }
+        }
+        count++;
+    }
+
+    fclose(file);
+    *out_jobs = jobs;
+    *out_count = count;
+    return 0;
+}
+
+
+typedef struct {
+    const MapGenContext* base_ctx;
+    const BatchJob* jobs;
+    int count;
+    const char* output_dir;
+    int next_job;       // Index of the next unclaimed job, guarded by lock
+    int failed;         // Guarded by lock
+    pthread_mutex_t lock;
+} BatchQueue;
+
+static int claim_job(BatchQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    int index = queue->next_job < queue->count ? queue->next_job++ : -1;
+    pthread_mutex_unlock(&queue->lock);
+    return index;
+}
+
+static void* batch_worker(void* arg) {
+    BatchQueue* queue = arg;
+    MapGenContext* ctx = mapgen_context_clone(queue->base_ctx);
+    MapGenWorkspace ws;
+    init_map_workspace(&ws);
+
+    int index;
+    while ((index = claim_job(queue)) >= 0) {
+        const BatchJob* job = &queue->jobs[index];
+        char filename[BATCH_PATH_MAX];
+        snprintf(filename, sizeof(filename), "%s/map_%05d_%u.png", queue->output_dir, index, job->seed);
+
+        MapGenConfig* config = mapgen_context_config(ctx);
+        if (config) *config = job->config;
+        bool ok = ctx && generate_map(ctx, &ws, job->seed, filename) == 0;
+        if (ok && job->config.compute_basins) {
+            snprintf(filename, sizeof(filename), "%s/map_%05d_%u_basins.csv", queue->output_dir, index, job->seed);
+            ok = write_basin_csv(ctx, map_basins(ctx, ws.map, job->config.ocean_level_for_lakes), filename) == 0;
+        }
+        if (!ok) {
+            mapgen_log(queue->base_ctx, MAPGEN_LOG_ERROR, "Error: batch job %d (seed %u) failed.\n", index, job->seed);
+            pthread_mutex_lock(&queue->lock);
+            queue->failed++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+
+    cleanup_map_workspace(ctx, &ws);
+    mapgen_context_destroy(ctx);
+    return NULL;
+}
+
+int run_batch(const MapGenContext* ctx, const BatchJob* jobs, int count,
+              int num_workers, const char* output_dir) {
+    if (!jobs || count <= 0) return 0;
+    if (!output_dir) output_dir = ".";
+    if (num_workers < 1) num_workers = 1;
+    if (num_workers > count) num_workers = count;
+
+    if (mkdir(output_dir, 0755) != 0 && errno != EEXIST) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error creating batch output directory %s\n", output_dir);
+        return count;
+    }
+
+    BatchQueue queue = { .base_ctx = ctx, .jobs = jobs, .count = count, .output_dir = output_dir,
+                         .next_job = 0, .failed = 0 };
+    pthread_mutex_init(&queue.lock, NULL);
+
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Running batch of %d maps on %d workers into '%s'...\n", count, num_workers, output_dir);
+
+    pthread_t* threads = malloc(num_workers * sizeof(pthread_t));
+    int started = 0;
+    if (threads) {
+        for (; started < num_workers; started++) {
+            if (pthread_create(&threads[started], NULL, batch_worker, &queue) != 0) break;
+        }
+    }
+    // Fall back to running on the calling thread if no worker could start
+    if (started == 0) batch_worker(&queue);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    pthread_mutex_destroy(&queue.lock);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Batch complete (%d/%d maps succeeded).\n", count - queue.failed, count);
+    return queue.failed;
+}
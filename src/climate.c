@@ -0,0 +1,273 @@
+#include "climate.h"
+#include <math.h>
+#include <string.h>
+
+#include "components.h"
+#include "planet.h"
+#include "parallel.h"
+
+// Rows an east-west sweep carries side by side, one vector lane each.
+#define CLIMATE_ROW_BLOCK 8
+
+void wind_params_default(WindParams* params) {
+    if (!params) return;
+    *params = (WindParams){
+        .strength = 0.0,
+        .direction = WIND_ZONAL,
+        .inflow = 0.5,
+        .evaporation = 0.1,
+        .base_rain = 0.015,
+        .orographic = 6.0,
+        .recycling = 0.4
+    };
+}
+
+bool wind_direction_parse(const char* text, WindDirection* out) {
+    static const char* const NAMES[] = { "zonal", "west", "east", "north", "south" };
+    for (int d = 0; d <= WIND_FROM_SOUTH; d++) {
+        if (text && strcmp(text, NAMES[d]) == 0) {
+            *out = (WindDirection)d;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    double water_level;
+    double evaporation;
+    double base_rain;
+    double inverse_base_rain;
+    double orographic;
+    double loss;            // Share of the rain that leaves the air
+} SweepConstants;
+
+typedef struct {
+    const MapData* map;
+    const int32_t* component;   // Water mask when set
+    const WindParams* params;
+    SweepConstants k;
+    size_t band_stride;
+    double* scratch;            // band_stride doubles per band
+} WindJob;
+
+// max(v, 0) and min(v, 1) through fabs(), which vectorizes without
+// -fno-trapping-math where the compares would not (see talus_flow).
+static inline double positive_part(double v) {
+    return 0.5 * (v + fabs(v));
+}
+
+static inline double at_most_one(double v) {
+    return 0.5 * (v + 1.0 - fabs(v - 1.0));
+}
+
+// Moves n independent air columns one cell downwind. water[i] is 1 or 0;
+// ground and humidity carry each column's state from the previous cell; wet
+// receives what gets blended into the moisture. Water flattens the ground to
+// the water level, so coasts do not count as a climb.
+static inline void sweep_step(int n, const double* restrict elevation, const double* restrict water,
+                              double* restrict ground, double* restrict humidity, double* restrict wet,
+                              const SweepConstants* k) {
+    double level = k->water_level;
+    double evaporation = k->evaporation;
+    double base_rain = k->base_rain;
+    double inverse_base_rain = k->inverse_base_rain;
+    double orographic = k->orographic;
+    double loss = k->loss;
+    for (int i = 0; i < n; i++) {
+        double w = water[i];
+        double h = humidity[i];
+        double g = elevation[i] + w * (level - elevation[i]);
+        double rain = h * at_most_one(base_rain + orographic * positive_part(g - ground[i]));
+        double over_land = h - loss * rain;
+        double over_water = h + evaporation * (1.0 - h);
+        double relative_rain = at_most_one(rain * inverse_base_rain);
+        humidity[i] = over_land + w * (over_water - over_land);
+        wet[i] = relative_rain + w * (h - relative_rain);
+        ground[i] = g;
+    }
+}
+
+static double cell_water(const WindJob* job, size_t i) {
+    if (job->component) return COMPONENT_IS_WATER(job->component[i]) ? 1.0 : 0.0;
+    return job->map->elevation[0][i] < job->k.water_level ? 1.0 : 0.0;
+}
+
+static bool row_from_east(const WindJob* job, int y) {
+    if (job->params->direction == WIND_FROM_EAST) return true;
+    if (job->params->direction != WIND_ZONAL) return false;
+    int height = job->map->height;
+    double latitude = fabs((double)y / (height > 1 ? height - 1 : 1) - 0.5) * 2.0;
+    return latitude < 1.0 / 3.0 || latitude > 2.0 / 3.0;
+}
+
+// Rows [begin, end) in blocks of CLIMATE_ROW_BLOCK: each block is gathered
+// transposed and upwind cell first, so the sweep steps all its rows at once
+// over contiguous memory, then scattered back into the moisture.
+static void east_west_band(void* user_data, int begin, int end, int band) {
+    WindJob* job = user_data;
+    int width = job->map->width;
+    const double* elevation = job->map->elevation[0];
+    double* moisture = job->map->moisture[0];
+    double strength = job->params->strength;
+    double* elevation_t = job->scratch + band * job->band_stride;
+    double* water_t = elevation_t + (size_t)width * CLIMATE_ROW_BLOCK;
+    double* wet_t = water_t + (size_t)width * CLIMATE_ROW_BLOCK;
+    double ground[CLIMATE_ROW_BLOCK];
+    double humidity[CLIMATE_ROW_BLOCK];
+
+    for (int y0 = begin; y0 < end; y0 += CLIMATE_ROW_BLOCK) {
+        int rows = end - y0 < CLIMATE_ROW_BLOCK ? end - y0 : CLIMATE_ROW_BLOCK;
+        // A short last block repeats its last row in the spare lanes
+        for (int r = 0; r < CLIMATE_ROW_BLOCK; r++) {
+            int y = y0 + (r < rows ? r : rows - 1);
+            bool from_east = row_from_east(job, y);
+            for (int s = 0; s < width; s++) {
+                size_t i = (size_t)y * width + (from_east ? width - 1 - s : s);
+                elevation_t[(size_t)s * CLIMATE_ROW_BLOCK + r] = elevation[i];
+                water_t[(size_t)s * CLIMATE_ROW_BLOCK + r] = cell_water(job, i);
+            }
+            double w = water_t[r];
+            ground[r] = elevation_t[r] + w * (job->k.water_level - elevation_t[r]);
+            humidity[r] = job->params->inflow;
+        }
+        for (int s = 0; s < width; s++) {
+            size_t offset = (size_t)s * CLIMATE_ROW_BLOCK;
+            sweep_step(CLIMATE_ROW_BLOCK, elevation_t + offset, water_t + offset, ground, humidity,
+                       wet_t + offset, &job->k);
+        }
+        for (int r = 0; r < rows; r++) {
+            int y = y0 + r;
+            bool from_east = row_from_east(job, y);
+            for (int s = 0; s < width; s++) {
+                size_t i = (size_t)y * width + (from_east ? width - 1 - s : s);
+                moisture[i] += strength * (wet_t[(size_t)s * CLIMATE_ROW_BLOCK + r] - moisture[i]);
+            }
+        }
+    }
+}
+
+// Columns [begin, end), swept row by row from the upwind edge.
+static void north_south_band(void* user_data, int begin, int end, int band) {
+    WindJob* job = user_data;
+    int width = job->map->width;
+    int height = job->map->height;
+    int n = end - begin;
+    double strength = job->params->strength;
+    bool from_south = job->params->direction == WIND_FROM_SOUTH;
+    double* ground = job->scratch + band * job->band_stride;
+    double* humidity = ground + width;
+    double* water = humidity + width;
+    double* wet = water + width;
+
+    for (int s = 0; s < height; s++) {
+        int y = from_south ? height - 1 - s : s;
+        size_t row = (size_t)y * width + begin;
+        const double* elevation = job->map->elevation[0] + row;
+        double* moisture = job->map->moisture[0] + row;
+        for (int x = 0; x < n; x++) water[x] = cell_water(job, row + x);
+        if (s == 0) {
+            for (int x = 0; x < n; x++) {
+                ground[x] = elevation[x] + water[x] * (job->k.water_level - elevation[x]);
+                humidity[x] = job->params->inflow;
+            }
+        }
+        sweep_step(n, elevation, water, ground, humidity, wet, &job->k);
+        for (int x = 0; x < n; x++) moisture[x] += strength * (wet[x] - moisture[x]);
+    }
+}
+
+void advect_moisture(MapGenContext* ctx, MapData* map, double water_level, const WindParams* params) {
+    if (!map || !map->elevation || !map->moisture || !params || params->strength <= 0.0) return;
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    int num_bands = mapgen_context_num_threads(ctx);
+    WindJob job = { map, map->component ? map->component[0] : NULL, params,
+                    { water_level, params->evaporation, params->base_rain,
+                      params->base_rain > 0.0 ? 1.0 / params->base_rain : 0.0,
+                      params->orographic, 1.0 - params->recycling },
+                    (size_t)map->width * CLIMATE_ROW_BLOCK * 3, NULL };
+    job.scratch = scratch_alloc(arena, job.band_stride * num_bands * sizeof(double));
+    if (!job.scratch) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate wind sweep scratch.\n");
+        arena_release(arena, mark);
+        return;
+    }
+
+    if (params->direction == WIND_FROM_NORTH || params->direction == WIND_FROM_SOUTH) {
+        mapgen_parallel_bands(ctx, map->width, north_south_band, &job);
+    } else {
+        mapgen_parallel_bands(ctx, map->height, east_west_band, &job);
+    }
+
+    scratch_free(arena, job.scratch);
+    arena_release(arena, mark);
+}
+
+// --- Temperature ---
+
+typedef struct {
+    MapData* map;
+    double latitude_factor;
+    MapRect rect;
+} TemperatureJob;
+
+// Cells [x0, x1) of row y. One add and a select-based clamp per cell.
+static void temperature_row(MapData* map, double latitude_factor, int y, int x0, int x1) {
+    const double* restrict elevation = map->elevation[y];
+    double* restrict temperature = map->temperature[y];
+    if (map->cube_face >= 0) {
+        for (int x = x0; x < x1; x++) {
+            double shift = latitude_factor * cube_face_latitude(map->cube_face, map->width, x, y);
+            temperature[x] = temperature_from_elevation(elevation[x] + shift);
+        }
+        return;
+    }
+    int height = map->height;
+    double latitude = fabs((double)y / (height > 1 ? height - 1 : 1) - 0.5) * 2.0;
+    double shift = latitude_factor * latitude;
+    for (int x = x0; x < x1; x++) {
+        temperature[x] = temperature_from_elevation(elevation[x] + shift);
+    }
+}
+
+static void temperature_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    TemperatureJob* job = user_data;
+    for (int y = job->rect.y0 + begin; y < job->rect.y0 + end; y++) {
+        temperature_row(job->map, job->latitude_factor, y, job->rect.x0, job->rect.x1);
+    }
+}
+
+bool map_compute_temperature(MapGenContext* ctx, MapData* map, double latitude_factor) {
+    if (!map || !map->elevation) return false;
+    // Allocated where the other layers live, so destroy_map releases it alike
+    Arena* previous_arena = mapgen_context_arena(ctx);
+    mapgen_context_set_arena(ctx, map->arena);
+    if (!map->temperature) map->temperature = create_layer(ctx, map->width, map->height);
+    mapgen_context_set_arena(ctx, previous_arena);
+    if (!map->temperature) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error allocating the temperature layer\n");
+        return false;
+    }
+    TemperatureJob job = { map, latitude_factor, { 0, 0, map->width, map->height } };
+    mapgen_parallel_bands(ctx, map->height, temperature_band, &job);
+    return true;
+}
+
+void update_temperature_rect(MapData* map, double latitude_factor, MapRect rect) {
+    if (!map || !map->temperature) return;
+    rect = map_rect_expand(rect, 0, map->width, map->height);
+    for (int y = rect.y0; y < rect.y1; y++) temperature_row(map, latitude_factor, y, rect.x0, rect.x1);
+}
+
+// --- Biomes ---
+
+const char* biome_name(Biome biome) {
+    static const char* const NAMES[BIOME_COUNT] = {
+        "ocean", "lake", "scorched", "bare_rock", "tundra", "snow", "savannah",
+        "shrubland", "taiga", "grassland", "forest", "desert", "jungle"
+    };
+    return biome >= 0 && biome < BIOME_COUNT ? NAMES[biome] : "unknown";
+}
@@ -0,0 +1,425 @@
+#include "components.h"
+#include <float.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+
+typedef struct {
+    const MapData* map;
+    double water_level;
+    bool keep_classes;          // Class from bit 0 of the incoming labels, not from water_level
+    int32_t* parent;            // Union-find forest over cell indices
+    int32_t* labels;            // Class bit, then (root << 1) | class, then the final labels
+    int num_bands;
+    long long* band_ids;        // Roots per band, then the first id of each band
+} LabelJob;
+
+// Root of i, halving the path on the way. Only called on trees that no other
+// thread touches.
+static int32_t find_root(int32_t* parent, int32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// The smaller root wins, so every root is the smallest cell of its tree.
+static void unite(int32_t* parent, int32_t a, int32_t b) {
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if (a < b) parent[b] = a;
+    else if (b < a) parent[a] = b;
+}
+
+// Links each cell to its same-class neighbours already visited in this band
+// (west, and the three above unless on the band's first row). With
+// 8-connectivity a matching north cell is already joined to the other three,
+// and a matching west cell to the north-west one, so most cells need a
+// single union.
+static void link_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    LabelJob* job = user_data;
+    int width = job->map->width;
+    const double* elevation = job->map->elevation[0];
+    int32_t* parent = job->parent;
+    int32_t* labels = job->labels;
+
+    for (int y = begin; y < end; y++) {
+        for (int x = 0; x < width; x++) {
+            int32_t i = y * width + x;
+            int32_t class = job->keep_classes ? labels[i] & 1 : elevation[i] < job->water_level;
+            parent[i] = i;
+            labels[i] = class;
+            if (y > begin && labels[i - width] == class) {
+                unite(parent, i, i - width);
+                continue;
+            }
+            if (x > 0 && labels[i - 1] == class) unite(parent, i, i - 1);
+            else if (y > begin && x > 0 && labels[i - width - 1] == class) unite(parent, i, i - width - 1);
+            if (y > begin && x + 1 < width && labels[i - width + 1] == class) unite(parent, i, i - width + 1);
+        }
+    }
+}
+
+// Replaces each cell's class with (root << 1) | class. Parents never follow
+// their children, so a parent inside this band is already flattened and only
+// links into earlier bands walk the (read-only) forest.
+static void flatten_band(void* user_data, int begin, int end, int band) {
+    LabelJob* job = user_data;
+    const int32_t* parent = job->parent;
+    int32_t* labels = job->labels;
+    int32_t first = begin * job->map->width;
+    long long roots = 0;
+    for (int32_t i = first; i < end * job->map->width; i++) {
+        int32_t root = parent[i];
+        if (root == i) roots++;
+        else if (root >= first) root = COMPONENT_ID(labels[root]);
+        else while (parent[root] != root) root = parent[root];
+        labels[i] = (root << 1) | (labels[i] & 1);
+    }
+    job->band_ids[band] = roots;
+}
+
+// Numbers this band's roots from its first id, storing the id in parent[root].
+static void number_band(void* user_data, int begin, int end, int band) {
+    LabelJob* job = user_data;
+    int32_t id = (int32_t)job->band_ids[band];
+    for (int32_t i = begin * job->map->width; i < end * job->map->width; i++) {
+        if (COMPONENT_ID(job->labels[i]) == i) job->parent[i] = id++;
+    }
+}
+
+static void relabel_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    LabelJob* job = user_data;
+    for (int32_t i = begin * job->map->width; i < end * job->map->width; i++) {
+        int32_t label = job->labels[i];
+        job->labels[i] = (job->parent[COMPONENT_ID(label)] << 1) | (label & 1);
+    }
+}
+
+static int label_cells(MapGenContext* ctx, const MapData* map, double water_level, bool keep_classes,
+                       int32_t** labels) {
+    if (!map || !map->elevation || !labels) return -1;
+    if ((long long)map->width * map->height > (INT32_MAX >> 1)) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Map too large for 31-bit component labels.\n");
+        return -1;
+    }
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    int num_bands = mapgen_context_num_threads(ctx);
+    LabelJob job = { map, water_level, keep_classes, NULL, labels[0], num_bands, NULL };
+    job.parent = scratch_alloc(arena, (size_t)map->width * map->height * sizeof(int32_t));
+    // Zeroed: bands with no rows never run and must count no roots
+    job.band_ids = scratch_calloc(arena, num_bands, sizeof(long long));
+    if (!job.parent || !job.band_ids) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate component labeling scratch.\n");
+        scratch_free(arena, job.band_ids);
+        scratch_free(arena, job.parent);
+        arena_release(arena, mark);
+        return -1;
+    }
+
+    mapgen_parallel_bands(ctx, map->height, link_band, &job);
+
+    // Stitch each band's first row to the row above it
+    int width = map->width;
+    for (int b = 1; b < num_bands; b++) {
+        int begin, end;
+        band_range(map->height, num_bands, b, &begin, &end);
+        if (begin <= 0 || begin >= map->height) continue;
+        for (int x = 0; x < width; x++) {
+            int32_t i = begin * width + x;
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = x + dx;
+                int32_t n = i - width + dx;
+                if (nx >= 0 && nx < width && job.labels[n] == job.labels[i]) unite(job.parent, i, n);
+            }
+        }
+    }
+
+    mapgen_parallel_bands(ctx, map->height, flatten_band, &job);
+    long long count = 0;
+    for (int b = 0; b < num_bands; b++) {
+        long long roots = job.band_ids[b];
+        job.band_ids[b] = count;
+        count += roots;
+    }
+    mapgen_parallel_bands(ctx, map->height, number_band, &job);
+    mapgen_parallel_bands(ctx, map->height, relabel_band, &job);
+
+    scratch_free(arena, job.band_ids);
+    scratch_free(arena, job.parent);
+    arena_release(arena, mark);
+    return (int)count;
+}
+
+int label_components(MapGenContext* ctx, const MapData* map, double water_level, int32_t** labels) {
+    return label_cells(ctx, map, water_level, false, labels);
+}
+
+int relabel_components(MapGenContext* ctx, const MapData* map, int32_t** labels) {
+    return label_cells(ctx, map, 0.0, true, labels);
+}
+
+// --- Statistics ---
+
+// Statistics of the components one band touches, keyed by id in an open
+// addressing table that doubles at half load, so a band costs memory for the
+// labels it sees rather than for every component of the map. Bands run on
+// pool threads, so the tables are malloc'd rather than taken from the arena.
+typedef struct {
+    int32_t* keys;              // Component id + 1, 0 = empty slot
+    ComponentStats* stats;
+    size_t capacity;            // Power of two
+    size_t count;
+    bool failed;
+} BandStats;
+
+#define BAND_STATS_INITIAL 64
+
+static size_t band_slot(const BandStats* band, int32_t id) {
+    size_t mask = band->capacity - 1;
+    size_t slot = ((uint32_t)id * 2654435761u) & mask;
+    while (band->keys[slot] != 0 && band->keys[slot] != id + 1) slot = (slot + 1) & mask;
+    return slot;
+}
+
+static bool band_stats_init(BandStats* band, size_t capacity) {
+    band->keys = calloc(capacity, sizeof(int32_t));
+    band->stats = malloc(capacity * sizeof(ComponentStats));
+    band->capacity = capacity;
+    band->count = 0;
+    band->failed = !band->keys || !band->stats;
+    return !band->failed;
+}
+
+static void band_stats_free(BandStats* band) {
+    free(band->keys);
+    free(band->stats);
+    band->keys = NULL;
+    band->stats = NULL;
+}
+
+// Entry of id, added empty if the band has not seen it; NULL (and failed set)
+// if the table could not be allocated or grown.
+static ComponentStats* band_stats_entry(BandStats* band, int32_t id) {
+    if (band->failed || (!band->keys && !band_stats_init(band, BAND_STATS_INITIAL))) return NULL;
+    size_t slot = band_slot(band, id);
+    if (band->keys[slot]) return &band->stats[slot];
+    if ((band->count + 1) * 2 > band->capacity) {
+        BandStats grown;
+        if (!band_stats_init(&grown, band->capacity * 2)) {
+            band_stats_free(&grown);
+            band->failed = true;
+            return NULL;
+        }
+        for (size_t i = 0; i < band->capacity; i++) {
+            if (!band->keys[i]) continue;
+            size_t to = band_slot(&grown, band->keys[i] - 1);
+            grown.keys[to] = band->keys[i];
+            grown.stats[to] = band->stats[i];
+        }
+        grown.count = band->count;
+        band_stats_free(band);
+        *band = grown;
+        slot = band_slot(band, id);
+    }
+    band->keys[slot] = id + 1;
+    band->stats[slot] = (ComponentStats){ 0, map_rect_empty(), false, false, false, DBL_MAX };
+    band->count++;
+    return &band->stats[slot];
+}
+
+typedef struct {
+    const MapData* map;
+    const int32_t* labels;
+    BandStats* bands;
+    const ComponentStats* merged;   // Rim pass: totals of the first pass
+} StatsJob;
+
+// First pass: area, bounding box and edge contact.
+static void stats_band(void* user_data, int begin, int end, int band) {
+    StatsJob* job = user_data;
+    int width = job->map->width;
+    int height = job->map->height;
+    const int32_t* labels = job->labels;
+    BandStats* table = &job->bands[band];
+
+    int32_t last_id = -1;
+    ComponentStats* s = NULL;
+    for (int y = begin; y < end; y++) {
+        bool edge_row = y == 0 || y == height - 1;
+        for (int x = 0; x < width; x++) {
+            int32_t label = labels[y * width + x];
+            if (COMPONENT_ID(label) != last_id) {  // Runs of one label skip the lookup
+                last_id = COMPONENT_ID(label);
+                s = band_stats_entry(table, last_id);
+                if (!s) return;
+            }
+            if (s->area++ == 0) s->bbox = (MapRect){ x, y, x + 1, y + 1 };
+            if (x < s->bbox.x0) s->bbox.x0 = x;
+            if (x >= s->bbox.x1) s->bbox.x1 = x + 1;
+            s->bbox.y1 = y + 1;         // Rows are visited in order
+            s->water = COMPONENT_IS_WATER(label);
+            if (edge_row || x == 0 || x == width - 1) s->touches_edge = true;
+        }
+    }
+}
+
+// Second pass: lowest land cell around each enclosed water body, which is
+// the only kind that gets a rim (oceans are skipped after one lookup). The
+// minimum goes to the surface field of the band's entry.
+static void rim_band(void* user_data, int begin, int end, int band) {
+    StatsJob* job = user_data;
+    int width = job->map->width;
+    int height = job->map->height;
+    const double* elevation = job->map->elevation[0];
+    const int32_t* labels = job->labels;
+    BandStats* table = &job->bands[band];
+
+    for (int y = begin; y < end; y++) {
+        for (int x = 0; x < width; x++) {
+            int32_t label = labels[y * width + x];
+            const ComponentStats* s = &job->merged[COMPONENT_ID(label)];
+            if (!s->water || s->touches_edge) continue;
+            ComponentStats* entry = band_stats_entry(table, COMPONENT_ID(label));
+            if (!entry) return;
+            double* lowest = &entry->surface;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx;
+                    int ny = y + dy;
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                    int32_t n = ny * width + nx;
+                    if (!COMPONENT_IS_WATER(labels[n]) && elevation[n] < *lowest) *lowest = elevation[n];
+                }
+            }
+        }
+    }
+}
+
+bool compute_component_stats(MapGenContext* ctx, const MapData* map, int32_t** labels, int count,
+                             Arena* arena, ComponentTable* out) {
+    if (!map || !labels || !out || count < 0) return false;
+    out->count = count;
+    out->water_count = 0;
+    out->stats = scratch_alloc(arena, ((size_t)count + 1) * sizeof(ComponentStats));
+
+    Arena* scratch = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(scratch);
+    int num_bands = mapgen_context_num_threads(ctx);
+    StatsJob job = { map, labels[0], scratch_calloc(scratch, num_bands, sizeof(BandStats)), NULL };
+    bool ok = out->stats && job.bands;
+    if (ok) {
+        mapgen_parallel_bands(ctx, map->height, stats_band, &job);
+        for (int b = 0; b < num_bands; b++) ok = ok && !job.bands[b].failed;
+    }
+    if (ok) {
+        for (int c = 0; c < count; c++) {
+            out->stats[c] = (ComponentStats){ 0, map_rect_empty(), false, false, false, DBL_MAX };
+        }
+        for (int b = 0; b < num_bands; b++) {
+            const BandStats* band = &job.bands[b];
+            for (size_t i = 0; i < band->capacity; i++) {
+                if (!band->keys[i]) continue;
+                const ComponentStats* s = &band->stats[i];
+                ComponentStats* merged = &out->stats[band->keys[i] - 1];
+                merged->area += s->area;
+                merged->bbox = map_rect_union(merged->bbox, s->bbox);
+                merged->water |= s->water;
+                merged->touches_edge |= s->touches_edge;
+            }
+        }
+        for (int c = 0; c < count; c++) out->water_count += out->stats[c].water;
+
+        job.merged = out->stats;
+        mapgen_parallel_bands(ctx, map->height, rim_band, &job);
+        for (int b = 0; b < num_bands; b++) ok = ok && !job.bands[b].failed;
+    }
+    if (ok) {
+        // Entries added by the rim pass carry only a rim, so the minimum is all that is merged
+        for (int b = 0; b < num_bands; b++) {
+            const BandStats* band = &job.bands[b];
+            for (size_t i = 0; i < band->capacity; i++) {
+                if (!band->keys[i]) continue;
+                ComponentStats* merged = &out->stats[band->keys[i] - 1];
+                if (band->stats[i].surface < merged->surface) merged->surface = band->stats[i].surface;
+            }
+        }
+        for (int c = 0; c < count; c++) {
+            ComponentStats* s = &out->stats[c];
+            s->lake = s->water && !s->touches_edge && s->surface < DBL_MAX;
+            s->surface = s->lake ? s->surface : 0.0;
+        }
+    }
+
+    if (job.bands) {
+        for (int b = 0; b < num_bands; b++) band_stats_free(&job.bands[b]);
+    }
+    scratch_free(scratch, job.bands);
+    arena_release(scratch, mark);
+    if (!ok) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate component statistics.\n");
+        scratch_free(arena, out->stats);
+        out->stats = NULL;
+    }
+    return ok;
+}
+
+typedef struct {
+    const int32_t* labels;
+    int width;
+    int32_t* band_max;
+} MaxLabelJob;
+
+static void max_label_band(void* user_data, int begin, int end, int band) {
+    MaxLabelJob* job = user_data;
+    int32_t max_id = -1;
+    for (size_t i = (size_t)begin * job->width; i < (size_t)end * job->width; i++) {
+        int32_t id = COMPONENT_ID(job->labels[i]);
+        if (id > max_id) max_id = id;
+    }
+    job->band_max[band] = max_id;
+}
+
+const ComponentTable* map_components(MapGenContext* ctx, MapData* map) {
+    if (!map || !map->component) return NULL;
+    if (map->stale & MAP_STALE_COMPONENTS) {
+        // Classes patched by map_update_dirty; the ids and the table are redone here
+        if (map->components) {
+            scratch_free(map->arena, map->components->stats);
+            scratch_free(map->arena, map->components);
+            map->components = NULL;
+        }
+        if (relabel_components(ctx, map, map->component) < 0) return NULL;
+        map->stale &= ~MAP_STALE_COMPONENTS;
+    }
+    if (map->components) return map->components;
+
+    // Labels restored without their table (e.g. from the stage cache)
+    int num_bands = mapgen_context_num_threads(ctx);
+    Arena* scratch = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(scratch);
+    MaxLabelJob job = { map->component[0], map->width, scratch_alloc(scratch, num_bands * sizeof(int32_t)) };
+    if (!job.band_max) {
+        arena_release(scratch, mark);
+        return NULL;
+    }
+    for (int b = 0; b < num_bands; b++) job.band_max[b] = -1;     // Bands with no rows never run
+    mapgen_parallel_bands(ctx, map->height, max_label_band, &job);
+    int32_t max_id = -1;
+    for (int b = 0; b < num_bands; b++) max_id = job.band_max[b] > max_id ? job.band_max[b] : max_id;
+    scratch_free(scratch, job.band_max);
+    arena_release(scratch, mark);
+
+    ComponentTable* table = scratch_alloc(map->arena, sizeof(ComponentTable));
+    if (!table || !compute_component_stats(ctx, map, map->component, max_id + 1, map->arena, table)) {
+        scratch_free(map->arena, table);
+        return NULL;
+    }
+    map->components = table;
+    return table;
+}
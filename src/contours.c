@@ -0,0 +1,344 @@
+#include "contours.h"
+#include <limits.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+
+// Crossing edges are numbered by cell: 2 * (y * width + x) is the edge from
+// cell (x, y) to (x + 1, y), one more the edge from (x, y) to (x, y + 1).
+
+typedef struct {
+    int32_t start;              // Entry edge of the first segment
+    int32_t end;                // Exit edge of the last segment
+    int segments;
+    bool closed;                // Loop within its tile
+    bool used;                  // Already part of a line
+    int offset;                 // Output vertex of its start edge
+} ContourFragment;
+
+typedef struct {
+    const MapData* map;
+    double level;
+    int tiles;
+    int32_t* next;              // Exit edge of the segment entering at each edge
+    unsigned char* visited;     // Per entry edge, once traced into a fragment
+    int* tile_segments;         // Segments per tile, then first fragment slot of each tile
+    int* tile_fragments;        // Fragments per tile
+    ContourFragment* fragments;
+    ContourLine* lines;         // This level's lines, for smooth_band
+    ContourVertex* vertices;
+    int smoothing;
+} ContourJob;
+
+static inline bool is_high(const ContourJob* job, int x, int y) {
+    return job->map->elevation[y][x] >= job->level;
+}
+
+// Square row in which the segment through crossing edge e starts (entering)
+// or ends, or -1 if that square is off the map.
+static int edge_square_row(const ContourJob* job, int32_t e, bool entering) {
+    int width = job->map->width;
+    int x = (e >> 1) % width, y = (e >> 1) / width;
+    // The square holding e as an entry has the high end of e first in its
+    // clockwise order
+    bool first_high = is_high(job, x, y);
+    if (e & 1) {
+        int column = first_high == entering ? x - 1 : x;
+        return column >= 0 && column < width - 1 ? y : -1;
+    }
+    int row = first_high == entering ? y : y - 1;
+    return row >= 0 && row < job->map->height - 1 ? row : -1;
+}
+
+// Segments of square (x, y) as entry and exit edges; returns their count.
+static int square_segments(const ContourJob* job, int x, int y, int32_t* entry, int32_t* exit) {
+    int width = job->map->width;
+    int32_t cell = y * width + x;
+    const int32_t edges[4] = { 2 * cell, 2 * (cell + 1) + 1, 2 * (cell + width), 2 * cell + 1 };
+    const bool high[4] = { is_high(job, x, y), is_high(job, x + 1, y),
+                           is_high(job, x + 1, y + 1), is_high(job, x, y + 1) };
+    int n = 0;
+    if (high[0] == high[2] && high[1] == high[3] && high[0] != high[1]) {
+        // Saddle: the center decides which pair of corners is connected
+        double* const* e = job->map->elevation;
+        bool center_high = 0.25 * (e[y][x] + e[y][x + 1] + e[y + 1][x + 1] + e[y + 1][x]) >= job->level;
+        for (int k = 0; k < 4; k++) {
+            if (high[k] == center_high) continue;
+            // Cut off corner k, entering before it if it is low
+            entry[n] = edges[high[k] ? k : (k + 3) & 3];
+            exit[n] = edges[high[k] ? (k + 3) & 3 : k];
+            n++;
+        }
+        return n;
+    }
+    for (int k = 0; k < 4; k++) {
+        if (high[k] && !high[(k + 1) & 3]) entry[0] = edges[k];
+        if (!high[k] && high[(k + 1) & 3]) exit[0] = edges[k];
+        if (high[k] != high[(k + 1) & 3]) n = 1;
+    }
+    return n;
+}
+
+static inline ContourVertex crossing(const ContourJob* job, int32_t e) {
+    int width = job->map->width;
+    int x = (e >> 1) % width, y = (e >> 1) / width;
+    double a = job->map->elevation[y][x];
+    double b = (e & 1) ? job->map->elevation[y + 1][x] : job->map->elevation[y][x + 1];
+    float t = (float)((job->level - a) / (b - a));
+    return (e & 1) ? (ContourVertex){ (float)x, (float)y + t } : (ContourVertex){ (float)x + t, (float)y };
+}
+
+static inline int tile_end_row(const ContourJob* job, int tile) {
+    int end = (tile + 1) * CONTOUR_TILE_ROWS;
+    return end < job->map->height - 1 ? end : job->map->height - 1;
+}
+
+static void link_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    ContourJob* job = user_data;
+    for (int tile = begin; tile < end; tile++) {
+        int segments = 0;
+        for (int y = tile * CONTOUR_TILE_ROWS; y < tile_end_row(job, tile); y++) {
+            for (int x = 0; x < job->map->width - 1; x++) {
+                int32_t entry[2], exit[2];
+                int n = square_segments(job, x, y, entry, exit);
+                for (int s = 0; s < n; s++) {
+                    job->next[entry[s]] = exit[s];
+                    job->visited[entry[s]] = 0;
+                }
+                segments += n;
+            }
+        }
+        job->tile_segments[tile] = segments;
+    }
+}
+
+static void trace_fragment(ContourJob* job, int tile, int32_t start) {
+    int row0 = tile * CONTOUR_TILE_ROWS, row1 = tile_end_row(job, tile);
+    ContourFragment* f = &job->fragments[job->tile_segments[tile] + job->tile_fragments[tile]++];
+    *f = (ContourFragment){ start, -1, 0, false, false, 0 };
+    int32_t e = start;
+    for (;;) {
+        job->visited[e] = 1;
+        f->segments++;
+        e = job->next[e];
+        if (e == start) {
+            f->closed = true;
+            break;
+        }
+        int row = edge_square_row(job, e, true);
+        if (row < row0 || row >= row1) break;
+    }
+    f->end = e;
+}
+
+// Open fragments first (their first segment continues nothing in the tile),
+// then the loops left over.
+static void trace_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    ContourJob* job = user_data;
+    for (int tile = begin; tile < end; tile++) {
+        int row0 = tile * CONTOUR_TILE_ROWS, row1 = tile_end_row(job, tile);
+        job->tile_fragments[tile] = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int y = row0; y < row1; y++) {
+                for (int x = 0; x < job->map->width - 1; x++) {
+                    int32_t entry[2], exit[2];
+                    int n = square_segments(job, x, y, entry, exit);
+                    for (int s = 0; s < n; s++) {
+                        if (job->visited[entry[s]]) continue;
+                        int from = edge_square_row(job, entry[s], false);
+                        if (pass == 1 || from < row0 || from >= row1) trace_fragment(job, tile, entry[s]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void write_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    ContourJob* job = user_data;
+    for (int tile = begin; tile < end; tile++) {
+        const ContourFragment* fragments = &job->fragments[job->tile_segments[tile]];
+        for (int i = 0; i < job->tile_fragments[tile]; i++) {
+            int32_t e = fragments[i].start;
+            for (int s = 0; s < fragments[i].segments; s++) {
+                job->vertices[fragments[i].offset + s] = crossing(job, e);
+                e = job->next[e];
+            }
+        }
+    }
+}
+
+// In place, from the back: new points 2i + 1 and 2i + 2 (2i and 2i + 1 when
+// closed) are past every original point still to be read.
+static void smooth_line(ContourVertex* p, int n, bool closed, int iterations) {
+    for (int it = 0; it < iterations; it++) {
+        if (n < 2) return;
+        int segments = closed ? n : n - 1;
+        ContourVertex last = p[n - 1];
+        int shift = closed ? 0 : 1;
+        for (int i = segments - 1; i >= 0; i--) {
+            ContourVertex a = p[i], b = i + 1 < n ? p[i + 1] : p[0];
+            p[2 * i + shift] = (ContourVertex){ 0.75f * a.x + 0.25f * b.x, 0.75f * a.y + 0.25f * b.y };
+            p[2 * i + shift + 1] = (ContourVertex){ 0.25f * a.x + 0.75f * b.x, 0.25f * a.y + 0.75f * b.y };
+        }
+        if (!closed) p[2 * n - 1] = last;
+        n *= 2;
+    }
+}
+
+static void smooth_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    ContourJob* job = user_data;
+    for (int l = begin; l < end; l++) {
+        ContourLine* line = &job->lines[l];
+        smooth_line(job->vertices + line->first, line->count >> job->smoothing, line->closed, job->smoothing);
+    }
+}
+
+// Chains the fragments into lines appended to out, numbering their vertices
+// after out->vertex_count with room for smoothing. Returns the vertices
+// before smoothing, or -1 on overflow.
+static long long stitch_fragments(ContourJob* job, const int32_t* fragment_at, ContourSet* out) {
+    long long vertices = 0;
+    int scale = 1 << job->smoothing;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int tile = 0; tile < job->tiles; tile++) {
+            ContourFragment* fragments = &job->fragments[job->tile_segments[tile]];
+            for (int i = 0; i < job->tile_fragments[tile]; i++) {
+                ContourFragment* f = &fragments[i];
+                // Lines from the map edge first, then the loops
+                if (f->used || (pass == 0 && edge_square_row(job, f->start, false) >= 0)) continue;
+                ContourLine* line = &out->lines[out->count++];
+                line->level = job->level;
+                line->closed = pass == 1;
+                long long first = out->vertex_count + vertices * scale;
+                long long count = 0;
+                while (f && !f->used) {
+                    f->used = true;
+                    f->offset = (int)(first + count);
+                    count += f->segments;
+                    if (f->closed || edge_square_row(job, f->end, true) < 0) break;
+                    f = &job->fragments[fragment_at[f->end]];
+                }
+                if (!line->closed) count++;             // The exit at the map edge
+                vertices += count;
+                if ((out->vertex_count + vertices) * scale > INT_MAX) return -1;
+                line->first = (int)first;
+                line->count = (int)(count * scale);
+            }
+        }
+    }
+    return vertices;
+}
+
+static bool extract_level(MapGenContext* ctx, ContourJob* job, int32_t* fragment_at, ContourSet* out) {
+    mapgen_parallel_bands(ctx, job->tiles, link_band, job);
+    int slots = 0;
+    for (int tile = 0; tile < job->tiles; tile++) {
+        int segments = job->tile_segments[tile];
+        job->tile_segments[tile] = slots;
+        slots += segments;
+    }
+    ContourFragment* fragments = realloc(job->fragments, ((size_t)slots + 1) * sizeof(ContourFragment));
+    ContourLine* lines = realloc(out->lines, ((size_t)out->count + slots + 1) * sizeof(ContourLine));
+    if (fragments) job->fragments = fragments;
+    if (lines) out->lines = lines;
+    if (!fragments || !lines) return false;
+    mapgen_parallel_bands(ctx, job->tiles, trace_band, job);
+
+    // Fragments continuing one from the tile above or below
+    for (int tile = 0; tile < job->tiles; tile++) {
+        for (int i = 0; i < job->tile_fragments[tile]; i++) {
+            int index = job->tile_segments[tile] + i;
+            const ContourFragment* f = &job->fragments[index];
+            if (!f->closed && edge_square_row(job, f->start, false) >= 0) fragment_at[f->start] = index;
+        }
+    }
+
+    int first_line = out->count;
+    long long vertices = stitch_fragments(job, fragment_at, out);
+    if (vertices < 0) return false;
+    size_t total = (size_t)out->vertex_count + ((size_t)vertices << job->smoothing);
+    ContourVertex* grown = realloc(out->vertices, (total + 1) * sizeof(ContourVertex));
+    if (!grown) return false;
+    out->vertices = grown;
+    job->vertices = grown;
+    mapgen_parallel_bands(ctx, job->tiles, write_band, job);
+    // The last fragment of an open line adds the exit at the map edge
+    for (int tile = 0; tile < job->tiles; tile++) {
+        for (int i = 0; i < job->tile_fragments[tile]; i++) {
+            const ContourFragment* f = &job->fragments[job->tile_segments[tile] + i];
+            if (!f->closed && edge_square_row(job, f->end, true) < 0) {
+                out->vertices[f->offset + f->segments] = crossing(job, f->end);
+            }
+        }
+    }
+    out->vertex_count = (int)total;
+
+    if (job->smoothing > 0) {
+        job->lines = out->lines + first_line;
+        mapgen_parallel_bands(ctx, out->count - first_line, smooth_band, job);
+    }
+    return true;
+}
+
+bool extract_contours(MapGenContext* ctx, const MapData* map, const double* levels, int num_levels,
+                      int smoothing, ContourSet* out) {
+    if (!map || !map->elevation || !out || (num_levels > 0 && !levels)) return false;
+    *out = (ContourSet){ 0, NULL, 0, NULL };
+    if (map->width < 2 || map->height < 2 || num_levels <= 0) return true;
+    if ((size_t)map->width * map->height > INT32_MAX / 2) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Map too large for contour extraction.\n");
+        return false;
+    }
+    if (smoothing < 0) smoothing = 0;
+    if (smoothing > 8) smoothing = 8;
+
+    ContourJob job = { .map = map, .smoothing = smoothing };
+    job.tiles = (map->height - 1 + CONTOUR_TILE_ROWS - 1) / CONTOUR_TILE_ROWS;
+    size_t edges = 2 * (size_t)map->width * map->height;
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    job.next = scratch_alloc(arena, edges * sizeof(int32_t));
+    job.visited = scratch_alloc(arena, edges);
+    int32_t* fragment_at = scratch_alloc(arena, edges * sizeof(int32_t));
+    job.tile_segments = scratch_alloc(arena, (size_t)job.tiles * sizeof(int));
+    job.tile_fragments = scratch_alloc(arena, (size_t)job.tiles * sizeof(int));
+    bool ok = job.next && job.visited && fragment_at && job.tile_segments && job.tile_fragments;
+
+    for (int l = 0; ok && l < num_levels; l++) {
+        job.level = levels[l];
+        ok = extract_level(ctx, &job, fragment_at, out);
+    }
+
+    if (ok) {
+        int closed = 0;
+        for (int l = 0; l < out->count; l++) closed += out->lines[l].closed;
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "Contours: %d lines (%d closed), %d vertices over %d levels.\n",
+                   out->count, closed, out->vertex_count, num_levels);
+    } else {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate contours.\n");
+        free_contour_set(out);
+    }
+    free(job.fragments);
+    scratch_free(arena, job.tile_fragments);
+    scratch_free(arena, job.tile_segments);
+    scratch_free(arena, fragment_at);
+    scratch_free(arena, job.visited);
+    scratch_free(arena, job.next);
+    arena_release(arena, mark);
+    return ok;
+}
+
+void free_contour_set(ContourSet* contours) {
+    if (!contours) return;
+    free(contours->lines);
+    free(contours->vertices);
+    contours->lines = NULL;
+    contours->vertices = NULL;
+    contours->count = 0;
+    contours->vertex_count = 0;
+}
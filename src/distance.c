@@ -0,0 +1,201 @@
+#include "distance.h"
+#include <math.h>
+
+// Columns gathered per step of the column pass, so reading them walks whole
+// cache lines of each row instead of one double per row.
+#define DISTANCE_COLUMN_BLOCK 16
+
+typedef struct {
+    double* cells;              // layer[0]
+    int width;
+    int height;
+    size_t band_stride;         // Scratch elements per band
+    double* f;                  // Per band: DISTANCE_COLUMN_BLOCK lines of input
+    double* d;                  // Per band: one line of output
+    double* z;                  // Per band: parabola boundaries (length + 1)
+    int* v;                     // Per band: parabola vertices
+} DistanceJob;
+
+// Squared distance transform of the 1D function f[0, n) into d: the lower
+// envelope of the parabolas rooted at every q with height f[q].
+static void transform_line(const double* f, int n, double* d, int* v, double* z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -HUGE_VAL;
+    z[1] = HUGE_VAL;
+    for (int q = 1; q < n; q++) {
+        double fq = f[q] + (double)q * q;
+        double s = (fq - (f[v[k]] + (double)v[k] * v[k])) / (2.0 * (q - v[k]));
+        while (s <= z[k]) {
+            k--;
+            s = (fq - (f[v[k]] + (double)v[k] * v[k])) / (2.0 * (q - v[k]));
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = HUGE_VAL;
+    }
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q) k++;
+        double offset = (double)(q - v[k]);
+        d[q] = offset * offset + f[v[k]];
+    }
+}
+
+static void rows_band(void* user_data, int begin, int end, int band) {
+    DistanceJob* job = user_data;
+    double* f = job->f + band * job->band_stride;
+    double* d = job->d + band * job->band_stride;
+    double* z = job->z + band * job->band_stride;
+    int* v = job->v + band * job->band_stride;
+    int width = job->width;
+
+    for (int y = begin; y < end; y++) {
+        double* row = job->cells + (size_t)y * width;
+        for (int x = 0; x < width; x++) f[x] = row[x];
+        transform_line(f, width, d, v, z);
+        for (int x = 0; x < width; x++) row[x] = d[x];
+    }
+}
+
+static void columns_band(void* user_data, int begin, int end, int band) {
+    DistanceJob* job = user_data;
+    double* f = job->f + band * job->band_stride;
+    double* d = job->d + band * job->band_stride;
+    double* z = job->z + band * job->band_stride;
+    int* v = job->v + band * job->band_stride;
+    int width = job->width;
+    int height = job->height;
+
+    for (int x0 = begin; x0 < end; x0 += DISTANCE_COLUMN_BLOCK) {
+        int count = end - x0 < DISTANCE_COLUMN_BLOCK ? end - x0 : DISTANCE_COLUMN_BLOCK;
+        for (int y = 0; y < height; y++) {
+            const double* row = job->cells + (size_t)y * width + x0;
+            for (int c = 0; c < count; c++) f[c * height + y] = row[c];
+        }
+        for (int c = 0; c < count; c++) {
+            transform_line(f + c * height, height, d, v, z);
+            for (int y = 0; y < height; y++) {
+                job->cells[(size_t)y * width + x0 + c] = d[y] >= DISTANCE_FAR ? DISTANCE_FAR : sqrt(d[y]);
+            }
+        }
+    }
+}
+
+bool distance_transform(MapGenContext* ctx, double** layer, int width, int height) {
+    if (!layer || width <= 0 || height <= 0) return false;
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    int num_bands = mapgen_context_num_threads(ctx);
+    int longest = width > height ? width : height;
+    DistanceJob job = { layer[0], width, height, (size_t)DISTANCE_COLUMN_BLOCK * longest + 1,
+                        NULL, NULL, NULL, NULL };
+    size_t total = job.band_stride * num_bands;
+    job.f = scratch_alloc(arena, total * sizeof(double));
+    job.d = scratch_alloc(arena, total * sizeof(double));
+    job.z = scratch_alloc(arena, total * sizeof(double));
+    job.v = scratch_alloc(arena, total * sizeof(int));
+
+    bool ok = job.f && job.d && job.z && job.v;
+    if (ok) {
+        mapgen_parallel_bands(ctx, height, rows_band, &job);
+        mapgen_parallel_bands(ctx, width, columns_band, &job);
+    } else {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate distance transform scratch.\n");
+    }
+
+    scratch_free(arena, job.v);
+    scratch_free(arena, job.z);
+    scratch_free(arena, job.d);
+    scratch_free(arena, job.f);
+    arena_release(arena, mark);
+    return ok;
+}
+
+// --- Map Distances ---
+
+typedef enum {
+    SEED_WATER,                 // Features: cells below the water level
+    SEED_LAND,                  // Features: cells at or above it
+    SEED_RIVER,                 // Features: river cells
+    SIGN_COAST                  // Combine: land from cells, water from other
+} DistancePass;
+
+typedef struct {
+    const MapData* map;
+    double water_level;
+    DistancePass pass;
+    double* cells;
+    const double* other;
+} DistanceSeedJob;
+
+static void seed_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    DistanceSeedJob* job = user_data;
+    int width = job->map->width;
+    const double* elevation = job->map->elevation[0];
+    const bool* river = job->map->is_river[0];
+
+    for (size_t i = (size_t)begin * width; i < (size_t)end * width; i++) {
+        bool land = elevation[i] >= job->water_level;
+        switch (job->pass) {
+        case SEED_WATER: job->cells[i] = land ? DISTANCE_FAR : 0.0; break;
+        case SEED_LAND:  job->cells[i] = land ? 0.0 : DISTANCE_FAR; break;
+        case SEED_RIVER: job->cells[i] = river[i] ? 0.0 : DISTANCE_FAR; break;
+        case SIGN_COAST: if (!land) job->cells[i] = -job->other[i]; break;
+        }
+    }
+}
+
+static void run_seed_pass(MapGenContext* ctx, const MapData* map, double water_level, DistancePass pass,
+                          double** cells, double** other) {
+    DistanceSeedJob job = { map, water_level, pass, cells[0], other ? other[0] : NULL };
+    mapgen_parallel_bands(ctx, map->height, seed_band, &job);
+}
+
+bool compute_coast_distance(MapGenContext* ctx, const MapData* map, double water_level, double** out) {
+    if (!map || !map->elevation || !out) return false;
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    double** to_land = create_layer(ctx, map->width, map->height);
+    if (!to_land) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate coast distance scratch.\n");
+        arena_release(arena, mark);
+        return false;
+    }
+    run_seed_pass(ctx, map, water_level, SEED_WATER, out, NULL);
+    run_seed_pass(ctx, map, water_level, SEED_LAND, to_land, NULL);
+    bool ok = distance_transform(ctx, out, map->width, map->height)
+           && distance_transform(ctx, to_land, map->width, map->height);
+    if (ok) run_seed_pass(ctx, map, water_level, SIGN_COAST, out, to_land);
+    destroy_layer(ctx, to_land);
+    arena_release(arena, mark);
+    return ok;
+}
+
+bool compute_river_distance(MapGenContext* ctx, const MapData* map, double** out) {
+    if (!map || !map->is_river || !out) return false;
+    run_seed_pass(ctx, map, 0.0, SEED_RIVER, out, NULL);
+    return distance_transform(ctx, out, map->width, map->height);
+}
+
+bool map_compute_distances(MapGenContext* ctx, MapData* map, double water_level) {
+    if (!map) return false;
+    // Allocated where the other layers live, so destroy_map releases them alike
+    Arena* previous_arena = mapgen_context_arena(ctx);
+    mapgen_context_set_arena(ctx, map->arena);
+    if (!map->coast_distance) map->coast_distance = create_layer(ctx, map->width, map->height);
+    if (!map->river_distance) map->river_distance = create_layer(ctx, map->width, map->height);
+    mapgen_context_set_arena(ctx, previous_arena);
+    if (!map->coast_distance || !map->river_distance) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error allocating distance layers\n");
+        return false;
+    }
+    if (!compute_coast_distance(ctx, map, water_level, map->coast_distance)
+        || !compute_river_distance(ctx, map, map->river_distance)) return false;
+    map->stale &= ~MAP_STALE_DISTANCES;
+    return true;
+}
@@ -0,0 +1,397 @@
+#include "erosion.h"
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "rng.h"
+
+void erosion_params_default(ErosionParams* params) {
+    if (!params) return;
+    params->droplets = 0;
+    params->max_lifetime = 30;
+    params->radius = 3;
+    params->tile_size = 64;
+    params->rounds = 4;
+    params->inertia = 0.05;
+    params->sediment_capacity = 4.0;
+    params->min_capacity = 0.01;
+    params->deposit_rate = 0.3;
+    params->erode_rate = 0.3;
+    params->evaporate_rate = 0.01;
+    params->gravity = 4.0;
+    params->initial_water = 1.0;
+    params->initial_speed = 1.0;
+}
+
+// Precomputed erosion brush: cells within radius, weights summing to 1.
+typedef struct {
+    int count;
+    int* dx;
+    int* dy;
+    double* weight;
+} ErosionBrush;
+
+typedef struct {
+    const ErosionParams* params;
+    double* height;             // map->elevation[0]
+    int width;
+    int height_cells;
+    int tiles_x;
+    int reach;                  // How far droplets may leave their tile
+    ErosionBrush brush;
+    RngStream* streams;         // One per tile, advanced across rounds
+    long long* tile_droplets;   // Droplets of each tile over all rounds
+    const int* color_tiles;     // Tiles of the color being processed
+    int round;
+    long long* simulated;       // Per band, merged at the end
+} ErosionJob;
+
+static void free_brush(Arena* arena, ErosionBrush* brush) {
+    scratch_free(arena, brush->dx);
+    scratch_free(arena, brush->dy);
+    scratch_free(arena, brush->weight);
+}
+
+static bool build_brush(Arena* arena, int radius, ErosionBrush* brush) {
+    int side = 2 * radius + 1;
+    brush->count = 0;
+    brush->dx = scratch_alloc(arena, (size_t)side * side * sizeof(int));
+    brush->dy = scratch_alloc(arena, (size_t)side * side * sizeof(int));
+    brush->weight = scratch_alloc(arena, (size_t)side * side * sizeof(double));
+    if (!brush->dx || !brush->dy || !brush->weight) return false;
+
+    double total = 0.0;
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            double w = radius - sqrt((double)(dx * dx + dy * dy));
+            if (w <= 0.0 && !(dx == 0 && dy == 0)) continue;
+            if (w <= 0.0) w = 1.0;  // radius 0: the cell itself
+            brush->dx[brush->count] = dx;
+            brush->dy[brush->count] = dy;
+            brush->weight[brush->count] = w;
+            brush->count++;
+            total += w;
+        }
+    }
+    for (int i = 0; i < brush->count; i++) brush->weight[i] /= total;
+    return true;
+}
+
+// Bilinear height and gradient at (x, y); cell (x, y) + 1 must be on the map.
+static double height_and_gradient(const ErosionJob* job, double x, double y, double* gx, double* gy) {
+    int cx = (int)x;
+    int cy = (int)y;
+    double u = x - cx;
+    double v = y - cy;
+    const double* row = job->height + (size_t)cy * job->width + cx;
+    double h00 = row[0];
+    double h10 = row[1];
+    double h01 = row[job->width];
+    double h11 = row[job->width + 1];
+    *gx = (h10 - h00) * (1.0 - v) + (h11 - h01) * v;
+    *gy = (h01 - h00) * (1.0 - u) + (h11 - h10) * u;
+    return h00 * (1.0 - u) * (1.0 - v) + h10 * u * (1.0 - v) + h01 * (1.0 - u) * v + h11 * u * v;
+}
+
+// Rolls one droplet from (x, y) until it evaporates, stops or leaves bounds
+// (cells a droplet may stand on; the cell to the right and below is read too).
+static void simulate_droplet(const ErosionJob* job, double x, double y, MapRect bounds) {
+    const ErosionParams* p = job->params;
+    const ErosionBrush* brush = &job->brush;
+    double* height = job->height;
+    int width = job->width;
+    double dir_x = 0.0, dir_y = 0.0;
+    double speed = p->initial_speed;
+    double water = p->initial_water;
+    double sediment = 0.0;
+
+    for (int life = 0; life < p->max_lifetime; life++) {
+        int cx = (int)x;
+        int cy = (int)y;
+        double u = x - cx;
+        double v = y - cy;
+        double gx, gy;
+        double h = height_and_gradient(job, x, y, &gx, &gy);
+
+        dir_x = dir_x * p->inertia - gx * (1.0 - p->inertia);
+        dir_y = dir_y * p->inertia - gy * (1.0 - p->inertia);
+        double len = sqrt(dir_x * dir_x + dir_y * dir_y);
+        if (len <= 0.0) break;
+        dir_x /= len;
+        dir_y /= len;
+        x += dir_x;
+        y += dir_y;
+        if (x < bounds.x0 || y < bounds.y0 || x >= bounds.x1 || y >= bounds.y1) break;
+
+        double unused_x, unused_y;
+        double dh = height_and_gradient(job, x, y, &unused_x, &unused_y) - h;
+        double capacity = fmax(-dh * speed * water * p->sediment_capacity, p->min_capacity);
+
+        if (sediment > capacity || dh > 0.0) {
+            // Fill the pit it climbs out of, or drop the excess
+            double amount = dh > 0.0 ? fmin(dh, sediment) : (sediment - capacity) * p->deposit_rate;
+            sediment -= amount;
+            double* cell = height + (size_t)cy * width + cx;
+            cell[0] += amount * (1.0 - u) * (1.0 - v);
+            cell[1] += amount * u * (1.0 - v);
+            cell[width] += amount * (1.0 - u) * v;
+            cell[width + 1] += amount * u * v;
+        } else {
+            // Never dig deeper than the drop, so droplets don't carve pits
+            double amount = fmin((capacity - sediment) * p->erode_rate, -dh);
+            for (int i = 0; i < brush->count; i++) {
+                int bx = cx + brush->dx[i];
+                int by = cy + brush->dy[i];
+                if (bx < 0 || by < 0 || bx >= width || by >= job->height_cells) continue;
+                double* cell = height + (size_t)by * width + bx;
+                double taken = fmin(*cell, amount * brush->weight[i]);
+                *cell -= taken;
+                sediment += taken;
+            }
+        }
+
+        speed = sqrt(fmax(0.0, speed * speed - dh * p->gravity));
+        water *= 1.0 - p->evaporate_rate;
+    }
+}
+
+// Runs this round's droplets of tiles [begin, end) of the current color.
+static void erode_tiles_band(void* user_data, int begin, int end, int band) {
+    ErosionJob* job = user_data;
+    const ErosionParams* p = job->params;
+    long long simulated = 0;
+
+    for (int i = begin; i < end; i++) {
+        int tile = job->color_tiles[i];
+        int tx = tile % job->tiles_x;
+        int ty = tile / job->tiles_x;
+        MapRect area = map_rect_expand((MapRect){ tx * p->tile_size, ty * p->tile_size,
+                                                  (tx + 1) * p->tile_size, (ty + 1) * p->tile_size },
+                                       0, job->width, job->height_cells);
+        // Droplets stand on cells whose right and lower neighbours exist
+        MapRect bounds = map_rect_expand(area, job->reach, job->width - 1, job->height_cells - 1);
+        if (map_rect_is_empty(bounds)) continue;
+
+        long long total = job->tile_droplets[tile];
+        long long count = total * (job->round + 1) / p->rounds - total * job->round / p->rounds;
+        RngStream* rng = &job->streams[tile];
+        for (long long d = 0; d < count; d++) {
+            double x = area.x0 + rng_next_double(rng) * (area.x1 - area.x0);
+            double y = area.y0 + rng_next_double(rng) * (area.y1 - area.y0);
+            if (x >= bounds.x1 || y >= bounds.y1) continue;     // Last row/column of the map
+            simulate_droplet(job, x, y, bounds);
+            simulated++;
+        }
+    }
+    job->simulated[band] += simulated;
+}
+
+static void free_erosion_scratch(Arena* arena, ErosionJob* job, int* color_tiles) {
+    free_brush(arena, &job->brush);
+    scratch_free(arena, color_tiles);
+    scratch_free(arena, job->simulated);
+    scratch_free(arena, job->tile_droplets);
+    scratch_free(arena, job->streams);
+}
+
+long long hydraulic_erosion(MapGenContext* ctx, MapData* map, const ErosionParams* params) {
+    if (!map || !map->elevation || !params || params->droplets <= 0) return 0;
+    if (map->width < 2 || map->height < 2) return 0;
+
+    ErosionParams p = *params;
+    if (p.radius < 0) p.radius = 0;
+    if (p.rounds < 1) p.rounds = 1;
+    // Same-color tiles are one tile apart; each may claim half of that gap
+    if (p.tile_size < 2 * (p.radius + 2)) p.tile_size = 2 * (p.radius + 2);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+
+    int width = map->width;
+    int height = map->height;
+    int tiles_x = (width + p.tile_size - 1) / p.tile_size;
+    int tiles_y = (height + p.tile_size - 1) / p.tile_size;
+    int tiles = tiles_x * tiles_y;
+
+    ErosionJob job = { 0 };
+    job.params = &p;
+    job.height = map->elevation[0];
+    job.width = width;
+    job.height_cells = height;
+    job.tiles_x = tiles_x;
+    job.reach = p.tile_size / 2 - p.radius - 1;
+    job.streams = scratch_alloc(arena, (size_t)tiles * sizeof(RngStream));
+    job.tile_droplets = scratch_alloc(arena, (size_t)tiles * sizeof(long long));
+    int* color_tiles = scratch_alloc(arena, (size_t)tiles * sizeof(int));
+    int num_bands = mapgen_context_num_threads(ctx);
+    job.simulated = scratch_calloc(arena, (size_t)num_bands, sizeof(long long));
+    if (!job.simulated || !job.streams || !job.tile_droplets || !color_tiles || !build_brush(arena, p.radius, &job.brush)) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate erosion scratch.\n");
+        free_erosion_scratch(arena, &job, color_tiles);
+        arena_release(arena, mark);
+        return 0;
+    }
+
+    // Droplets per tile in proportion to its area, summing exactly to the total
+    long long cells = (long long)width * height;
+    long long covered = 0;
+    for (int t = 0; t < tiles; t++) {
+        int tx = t % tiles_x;
+        int ty = t / tiles_x;
+        int w = (tx + 1) * p.tile_size < width ? p.tile_size : width - tx * p.tile_size;
+        int h = (ty + 1) * p.tile_size < height ? p.tile_size : height - ty * p.tile_size;
+        long long next = covered + (long long)w * h;
+        job.tile_droplets[t] = (long long)((double)p.droplets * next / cells)
+                             - (long long)((double)p.droplets * covered / cells);
+        covered = next;
+        job.streams[t] = mapgen_rng_stream(ctx, RNG_STAGE_EROSION, (uint64_t)t);
+    }
+
+    for (int round = 0; round < p.rounds; round++) {
+        job.round = round;
+        for (int color = 0; color < 4; color++) {
+            int count = 0;
+            for (int t = 0; t < tiles; t++) {
+                int tx = t % tiles_x;
+                int ty = t / tiles_x;
+                if ((tx & 1) + 2 * (ty & 1) == color) color_tiles[count++] = t;
+            }
+            job.color_tiles = color_tiles;
+            if (count > 0) mapgen_parallel_bands(ctx, count, erode_tiles_band, &job);
+        }
+    }
+
+    long long simulated = 0;
+    for (int b = 0; b < num_bands; b++) simulated += job.simulated[b];
+    free_erosion_scratch(arena, &job, color_tiles);
+    arena_release(arena, mark);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    mapgen_log(ctx, MAPGEN_LOG_INFO,
+               "Hydraulic erosion: %lld droplets in %.1f ms (%.0f droplets/s, %d threads, %d tiles of %d)\n",
+               simulated, seconds * 1e3, seconds > 0.0 ? simulated / seconds : 0.0,
+               mapgen_context_num_threads(ctx), tiles, p.tile_size);
+    return simulated;
+}
+
+// --- Thermal Erosion ---
+
+void thermal_params_default(ThermalParams* params) {
+    if (!params) return;
+    params->iterations = 0;
+    params->talus = 0.01;
+    params->rate = 0.2;
+}
+
+typedef struct {
+    const double* src;
+    double* dst;
+    int width;
+    int height;
+    double talus;
+    double rate;
+} ThermalJob;
+
+// Net flow out of a cell at height h towards a neighbour at height n:
+// max(d - talus, 0) - max(-d - talus, 0) for d = h - n, written with fabs()
+// so there is no compare for the vectorizer to if-convert (GCC won't without
+// -fno-trapping-math). Swapping h and n exactly negates it, so every pair's
+// exchange cancels and mass is conserved.
+static inline double talus_flow(double h, double n, double talus) {
+    double d = h - n;
+    return d + 0.5 * (fabs(d - talus) - fabs(d + talus));
+}
+
+// One output row from its row and the rows above and below (the row itself
+// at the map edges, i.e. no flow there).
+static void thermal_row(const double* restrict row, const double* restrict up,
+                        const double* restrict down, double* restrict out,
+                        int width, double talus, double rate) {
+    if (width == 1) {
+        out[0] = row[0] - rate * (talus_flow(row[0], up[0], talus) + talus_flow(row[0], down[0], talus));
+        return;
+    }
+    out[0] = row[0] - rate * (talus_flow(row[0], row[1], talus) + talus_flow(row[0], up[0], talus)
+                              + talus_flow(row[0], down[0], talus));
+    for (int x = 1; x < width - 1; x++) {
+        double h = row[x];
+        double flow = talus_flow(h, row[x - 1], talus) + talus_flow(h, row[x + 1], talus)
+                    + talus_flow(h, up[x], talus) + talus_flow(h, down[x], talus);
+        out[x] = h - rate * flow;
+    }
+    int x = width - 1;
+    out[x] = row[x] - rate * (talus_flow(row[x], row[x - 1], talus) + talus_flow(row[x], up[x], talus)
+                              + talus_flow(row[x], down[x], talus));
+}
+
+static void thermal_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    const ThermalJob* job = user_data;
+    int width = job->width;
+    for (int y = begin; y < end; y++) {
+        const double* row = job->src + (size_t)y * width;
+        const double* up = y > 0 ? row - width : row;
+        const double* down = y + 1 < job->height ? row + width : row;
+        thermal_row(row, up, down, job->dst + (size_t)y * width, width, job->talus, job->rate);
+    }
+}
+
+typedef struct {
+    const double* src;
+    double* dst;
+    int width;
+} CopyRowsJob;
+
+static void copy_rows_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    const CopyRowsJob* job = user_data;
+    size_t offset = (size_t)begin * job->width;
+    memcpy(job->dst + offset, job->src + offset, (size_t)(end - begin) * job->width * sizeof(double));
+}
+
+void thermal_erosion(MapGenContext* ctx, MapData* map, const ThermalParams* params) {
+    if (!map || !map->elevation || !params || params->iterations <= 0) return;
+    if (params->rate <= 0.0) {
+        // A negative rate would move material uphill
+        if (params->rate < 0.0) {
+            mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: thermal erosion rate %.3f is negative; skipping thermal erosion.\n",
+                       params->rate);
+        }
+        return;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // The second buffer is allocated like the map layers, so each band's rows
+    // of both buffers are first touched by the thread that sweeps them.
+    double** scratch = create_layer(ctx, map->width, map->height);
+    if (!scratch) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate thermal erosion buffer.\n");
+        return;
+    }
+
+    double rate = params->rate > 0.25 ? 0.25 : params->rate;   // Beyond 1/4 a cell can overshoot
+    ThermalJob job = { map->elevation[0], scratch[0], map->width, map->height, params->talus, rate };
+    for (int i = 0; i < params->iterations; i++) {
+        mapgen_parallel_bands(ctx, map->height, thermal_band, &job);
+        const double* previous = job.src;
+        job.src = job.dst;
+        job.dst = (double*)previous;
+    }
+    if (job.src != map->elevation[0]) {
+        CopyRowsJob copy = { job.src, map->elevation[0], map->width };
+        mapgen_parallel_bands(ctx, map->height, copy_rows_band, &copy);
+    }
+    destroy_layer(ctx, scratch);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Thermal erosion: %d iterations in %.1f ms (%.0f Mcell/s)\n",
+               params->iterations, ms,
+               ms > 0.0 ? (double)map->width * map->height * params->iterations / (ms * 1e3) : 0.0);
+}
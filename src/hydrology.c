@@ -3,67 +3,17 @@
 #include <stdlib.h>
 #include <float.h>
 #include <math.h>
-#include <time.h>
 #include <stdbool.h> // Make sure bool is included
+#include <stdint.h>
+
+#include "components.h"
+#include "rivers.h"
 
 typedef struct {
     int x;
     int y;
 } Point;
 
-// --- Simple Queue Implementation for BFS ---
-typedef struct {
-    Point* points;
-    int capacity;
-    int size;
-    int head;
-    int tail;
-} PointQueue;
-
-PointQueue* create_queue(int capacity) {
-    PointQueue* q = malloc(sizeof(PointQueue));
-    if (!q) return NULL;
-    q->points = malloc(capacity * sizeof(Point));
-    if (!q->points) { free(q); return NULL; }
-    q->capacity = capacity;
-    q->size = 0;
-    q->head = 0;
-    q->tail = -1;
-    return q;
-}
-
-void destroy_queue(PointQueue* q) {
-    if (!q) return;
-    free(q->points);
-    free(q);
-}
-
-bool is_empty(PointQueue* q) {
-    return q->size == 0;
-}
-
-bool is_full(PointQueue* q) {
-    return q->size == q->capacity;
-}
-
-void enqueue(PointQueue* q, Point p) {
-    if (is_full(q)) return; // Or resize
-    q->tail = (q->tail + 1) % q->capacity;
-    q->points[q->tail] = p;
-    q->size++;
-}
-
-Point dequeue(PointQueue* q) {
-    Point p = {-1, -1}; // Invalid point
-    if (is_empty(q)) return p;
-    p = q->points[q->head];
-    q->head = (q->head + 1) % q->capacity;
-    q->size--;
-    return p;
-}
-// --- End Queue Implementation ---
-
-
 static Point find_downhill_neighbour(const MapData* map, int x, int y) {
    // ... (Implementation from previous step remains the same) ...
     Point best_neighbour = {x, y};
@@ -86,180 +36,378 @@ static Point find_downhill_neighbour(const MapData* map, int x, int y) {
     return best_neighbour;
 }
 
-void generate_rivers(MapData* map, int num_rivers, int min_length, int max_length, double start_elevation_min) {
-    // ... (Implementation from previous step remains the same) ...
+#define RIVER_WATER_LEVEL 0.18    // ELEV_BEACH: rivers end on reaching it
+
+// Follows the steepest descent from start until a pit, water, a loop or
+// max_length cells. Returns the number of cells written to path.
+static int trace_river(const MapData* map, Point start, int max_length, Point* path) {
+    int path_len = 0;
+    Point current_pos = start;
+    path[path_len++] = current_pos;
+    while (path_len < max_length) { /* Trace path */
+        Point next_pos = find_downhill_neighbour(map, current_pos.x, current_pos.y);
+        if (next_pos.x == current_pos.x && next_pos.y == current_pos.y) break;
+        if (map->elevation[next_pos.y][next_pos.x] < RIVER_WATER_LEVEL) {
+            path[path_len++] = next_pos; break;
+        }
+        bool cycle = false; for(int k=0; k<path_len; ++k) if(path[k].x==next_pos.x && path[k].y==next_pos.y) cycle=true; if(cycle) break;
+        path[path_len++] = next_pos; current_pos = next_pos;
+    }
+    return path_len;
+}
+
+// Lowers the cells of path into a river bed and marks them; records them in
+// river slot (or not, for slot < 0).
+static void carve_river(MapData* map, const Point* path, int path_len, int slot) {
+    for (int j = 0; j < path_len; ++j) {
+        int px = path[j].x; int py = path[j].y;
+        map->elevation[py][px] = fmax(RIVER_WATER_LEVEL * 0.8, map->elevation[py][px] * 0.90);
+        if (map->is_river) map->is_river[py][px] = true;
+        if (slot >= 0) map->river_paths[(size_t)slot * map->river_path_stride + j] = py * map->width + px;
+    }
+}
+
+void generate_rivers(MapGenContext* ctx, MapData* map, int num_rivers, int min_length, int max_length, double start_elevation_min) {
      if (!map || !map->elevation) return;
-     printf("Generating rivers (attempting %d)...\n", num_rivers);
-     // srand() should ideally be called once in main
+     mapgen_log(ctx, MAPGEN_LOG_INFO, "Generating rivers (attempting %d)...\n", num_rivers);
      int rivers_generated = 0;
      int width = map->width;
      int height = map->height;
-     const double WATER_LEVEL_THRESHOLD = 0.18; // Use ELEV_BEACH
+     // Paths are kept for vector export (see rivers.h); without them the rivers are only carved
+     bool record = max_length > 0 && map_reserve_river_paths(ctx, map, num_rivers, max_length);
+     map->river_min_length = min_length;
      for (int i = 0; i < num_rivers; ++i) {
          Point path[max_length];
-         int path_len = 0;
          Point current_pos = {-1, -1};
          int start_attempts = 0;
          const int max_start_attempts = width * height / 10;
+         RngStream rng = mapgen_rng_stream(ctx, RNG_STAGE_RIVERS, (uint64_t)i); // Independent of other rivers
          while (start_attempts < max_start_attempts) { /* Find start */
-             int sx = rand() % width; int sy = rand() % height;
+             int sx = (int)rng_next_below(&rng, (uint32_t)width); int sy = (int)rng_next_below(&rng, (uint32_t)height);
              if (map->elevation[sy][sx] >= start_elevation_min) {
                  current_pos.x = sx; current_pos.y = sy; break;
              } start_attempts++;
          }
          if (current_pos.x == -1) continue;
-         path[path_len++] = current_pos;
-         while (path_len < max_length) { /* Trace path */
-             Point next_pos = find_downhill_neighbour(map, current_pos.x, current_pos.y);
-             if (next_pos.x == current_pos.x && next_pos.y == current_pos.y) break;
-             if (map->elevation[next_pos.y][next_pos.x] < WATER_LEVEL_THRESHOLD) {
-                 path[path_len++] = next_pos; break;
-             }
-             bool cycle = false; for(int k=0; k<path_len; ++k) if(path[k].x==next_pos.x && path[k].y==next_pos.y) cycle=true; if(cycle) break;
-             path[path_len++] = next_pos; current_pos = next_pos;
-         }
+         int path_len = trace_river(map, current_pos, max_length, path);
          if (path_len >= min_length) { /* Carve river */
              rivers_generated++;
-             for (int j = 0; j < path_len; ++j) {
-                 int px = path[j].x; int py = path[j].y;
-                 map->elevation[py][px] = fmax(WATER_LEVEL_THRESHOLD * 0.8, map->elevation[py][px] * 0.90);
-             }
+             carve_river(map, path, path_len, record ? i : -1);
          }
      }
-     printf("River generation complete (%d rivers carved).\n", rivers_generated);
+     mapgen_log(ctx, MAPGEN_LOG_INFO, "River generation complete (%d rivers carved).\n", rivers_generated);
 }
 
+// --- Regional River Updates ---
 
-void fill_lakes(MapData* map, double ocean_level) {
-    if (!map || !map->elevation) return;
+static MapRect rect_add_cell(MapRect rect, int x, int y) {
+    return map_rect_union(rect, (MapRect){ x, y, x + 1, y + 1 });
+}
 
+MapRect update_rivers_region(MapGenContext* ctx, MapData* map, MapRect region) {
+    MapRect changed = map_rect_empty();
+    if (!map || !map->river_paths || map->river_path_stride < 1 || map_rect_is_empty(region)) return changed;
     int width = map->width;
-    int height = map->height;
-    printf("Filling lakes (Ocean Level = %.4f)...\n", ocean_level);
-
-    bool** visited = malloc(height * sizeof(bool*));
-    if (!visited) { perror("Failed to allocate visited rows"); return; }
-    for (int y = 0; y < height; ++y) {
-        visited[y] = calloc(width, sizeof(bool)); // Use calloc to initialize to false
-        if (!visited[y]) {
-            perror("Failed to allocate visited columns");
-            for(int i=0; i < y; ++i) free(visited[i]);
-            free(visited);
-            return;
+    int stride = map->river_path_stride;
+    // A path reads the 8 neighbours of its cells, so rivers next to the region count too
+    MapRect near = map_rect_expand(region, 1, width, map->height);
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    int* sources = scratch_alloc(arena, (size_t)map->river_path_count * sizeof(int));
+    Point* path = scratch_alloc(arena, (size_t)stride * sizeof(Point));
+    if (!sources || !path) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate river update scratch.\n");
+        scratch_free(arena, path);
+        scratch_free(arena, sources);
+        arena_release(arena, mark);
+        return changed;
+    }
+
+    // Unmark the rivers that pass the region, remembering their sources
+    int affected = 0;
+    for (int i = 0; i < map->river_path_count; i++) {
+        int32_t* cells = map->river_paths + (size_t)i * stride;
+        sources[i] = -1;
+        bool hit = false;
+        for (int j = 0; j < stride && cells[j] >= 0 && !hit; j++) {
+            int x = cells[j] % width, y = cells[j] / width;
+            hit = x >= near.x0 && x < near.x1 && y >= near.y0 && y < near.y1;
+        }
+        if (!hit) continue;
+        sources[i] = cells[0];
+        affected++;
+        for (int j = 0; j < stride && cells[j] >= 0; j++) {
+            int x = cells[j] % width, y = cells[j] / width;
+            if (map->is_river) map->is_river[y][x] = false;
+            changed = rect_add_cell(changed, x, y);
+            cells[j] = -1;
+        }
+    }
+    if (affected > 0) {
+        // Cells shared with a river that stays were unmarked too
+        if (map->is_river) {
+            size_t slots = (size_t)map->river_path_count * stride;
+            for (size_t k = 0; k < slots; k++) {
+                int32_t cell = map->river_paths[k];
+                if (cell >= 0) map->is_river[cell / width][cell % width] = true;
+            }
+        }
+        // Retrace from the same sources over the edited terrain, in generation order
+        for (int i = 0; i < map->river_path_count; i++) {
+            if (sources[i] < 0) continue;
+            Point start = { sources[i] % width, sources[i] / width };
+            int path_len = trace_river(map, start, stride, path);
+            if (path_len < map->river_min_length) continue;
+            carve_river(map, path, path_len, i);
+            for (int j = 0; j < path_len; j++) changed = rect_add_cell(changed, path[j].x, path[j].y);
         }
+        map_drop_river_network(map);
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "Retraced %d rivers through the edited region.\n", affected);
+    }
+
+    scratch_free(arena, path);
+    scratch_free(arena, sources);
+    arena_release(arena, mark);
+    return changed;
+}
+
+
+typedef struct {
+    double* elevation;
+    const int32_t* labels;
+    const ComponentStats* stats;
+    size_t width;
+} LakeFillJob;
+
+static void fill_lakes_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    LakeFillJob* job = user_data;
+    for (size_t i = (size_t)begin * job->width; i < (size_t)end * job->width; i++) {
+        int32_t label = job->labels[i];
+        if (!COMPONENT_IS_WATER(label)) continue;
+        const ComponentStats* lake = &job->stats[COMPONENT_ID(label)];
+        if (lake->lake && job->elevation[i] < lake->surface) job->elevation[i] = lake->surface;
     }
+}
 
-    PointQueue* q = create_queue(width * height); // Max possible size needed
-    PointQueue* pit_cells = create_queue(width * height); // Store cells in the current pit
-    if (!q || !pit_cells) {
-        fprintf(stderr, "Failed to create queues for lake filling.\n");
-        // Cleanup visited array
-        for(int y=0; y < height; ++y) free(visited[y]);
-        free(visited);
-        destroy_queue(q); // Safe to call on NULL
-        destroy_queue(pit_cells);
+void fill_lakes(MapGenContext* ctx, MapData* map, double ocean_level) {
+    if (!map || !map->elevation) return;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Filling lakes (Ocean Level = %.4f)...\n", ocean_level);
+
+    // The labels and their table live with the map's other layers
+    Arena* previous_arena = mapgen_context_arena(ctx);
+    mapgen_context_set_arena(ctx, map->arena);
+    if (!map->component) map->component = create_label_layer(ctx, map->width, map->height);
+    mapgen_context_set_arena(ctx, previous_arena);
+    if (map->components) {
+        scratch_free(map->arena, map->components->stats);
+        scratch_free(map->arena, map->components);
+        map->components = NULL;
+    }
+    ComponentTable* table = map->component ? scratch_alloc(map->arena, sizeof(ComponentTable)) : NULL;
+    int count = table ? label_components(ctx, map, ocean_level, map->component) : -1;
+    if (count < 0 || !compute_component_stats(ctx, map, map->component, count, map->arena, table)) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Failed to label water bodies for lake filling.\n");
+        scratch_free(map->arena, table);
         return;
     }
+    map->components = table;
+    map->stale &= ~MAP_STALE_COMPONENTS;
 
+    // Every water body that doesn't reach the map edge rises to its lowest rim cell
+    int lakes = 0;
+    for (int c = 0; c < table->count; c++) lakes += table->stats[c].lake;
+    LakeFillJob job = { map->elevation[0], map->component[0], table->stats, (size_t)map->width };
+    mapgen_parallel_bands(ctx, map->height, fill_lakes_band, &job);
 
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            if (visited[y][x]) continue; // Skip already processed cells
-
-            double current_elevation = map->elevation[y][x];
-            visited[y][x] = true;
-
-            // Start BFS only if this cell is potentially part of an inland depression
-            // (It must be below ocean level, otherwise it drains naturally)
-            if (current_elevation < ocean_level) {
-
-                Point start_point = {x, y};
-                double min_spill_point = DBL_MAX; // Lowest point found on the rim
-                bool reached_ocean = false;
-                int current_pit_size = 0;
-
-                // Reset queues for this potential pit
-                q->size = 0; q->head = 0; q->tail = -1;
-                pit_cells->size = 0; pit_cells->head = 0; pit_cells->tail = -1;
-
-                enqueue(q, start_point);
-                enqueue(pit_cells, start_point); // Add start to pit list
-
-
-                // BFS to find extent of depression and minimum spill point
-                while (!is_empty(q)) {
-                    Point current = dequeue(q);
-
-                    // Check 8 neighbours
-                    for (int dy = -1; dy <= 1; ++dy) {
-                        for (int dx = -1; dx <= 1; ++dx) {
-                            if (dx == 0 && dy == 0) continue;
-
-                            int nx = current.x + dx;
-                            int ny = current.y + dy;
-
-                            // Check bounds
-                            if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-                                if (!visited[ny][nx]) {
-                                    visited[ny][nx] = true; // Mark neighbour visited
-                                    double neighbour_elevation = map->elevation[ny][nx];
-
-                                    if (neighbour_elevation < ocean_level) {
-                                        // Part of the same potential depression, add to queue
-                                        enqueue(q, (Point){nx, ny});
-                                        enqueue(pit_cells, (Point){nx, ny}); // Add to pit list
-                                    } else {
-                                        // Hit the rim (or land above ocean level)
-                                        // This neighbour is a potential spill point
-                                        if (neighbour_elevation < min_spill_point) {
-                                            min_spill_point = neighbour_elevation;
-                                        }
-                                    }
-                                }
-                                // Check if neighbour *is* ocean (special case of rim)
-                                // This check is subtle - if any explored cell is *adjacent* to ocean
-                                // it means the depression connects to the ocean. We might need
-                                // to pre-mark ocean cells as visited?
-                                // Let's simplify: if min_spill_point remains DBL_MAX or goes below ocean,
-                                // assume it connects or is ocean itself.
-
-
-                            } else {
-                                // Hit the map edge, assume this connects to the ocean
-                                reached_ocean = true;
-                                // Technically, need to handle edge cases better if map isn't island-shaped
-                            }
-                        } // end dx loop
-                    } // end dy loop
-                } // end while BFS queue not empty
-
-                // Decide whether to fill the pit
-                // Fill if we didn't reach the map edge/ocean and found a valid spill point > current elevation
-                if (!reached_ocean && min_spill_point < DBL_MAX && min_spill_point > current_elevation) {
-                    // Fill all cells in pit_cells up to min_spill_point
-                    // printf("Filling pit starting at (%d, %d) to level %.4f (%d cells)\n", x, y, min_spill_point, pit_cells->size);
-                    while (!is_empty(pit_cells)) {
-                        Point pit_cell = dequeue(pit_cells);
-                        // Only raise elevation if it's currently below the spill point
-                        if (map->elevation[pit_cell.y][pit_cell.x] < min_spill_point) {
-                             map->elevation[pit_cell.y][pit_cell.x] = min_spill_point;
-                        }
-                    }
-                } else {
-                    // This wasn't a contained pit, just dequeue remaining pit cells
-                     while (!is_empty(pit_cells)) { (void)dequeue(pit_cells); }
-                }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Lake filling complete (%d water bodies, %d lakes, %d landmasses).\n",
+               table->water_count, lakes, table->count - table->water_count);
+}
+
+
+// --- Regional Lake Filling ---
+// Sparse bookkeeping sized by what is explored rather than by the map, so a
+// small edit never clears or allocates a full visited grid.
+
+// Visited cells, keyed by cell index, with the component that reached them.
+// Open addressing on a power-of-two table that doubles at half load.
+typedef struct {
+    int* keys;          // Cell index + 1, 0 = empty slot
+    int* owners;
+    size_t capacity;
+    size_t count;
+} CellSet;
+
+typedef struct {
+    int* cells;
+    size_t count;
+    size_t capacity;
+} CellList;
+
+static size_t cell_slot(const CellSet* set, int cell) {
+    size_t mask = set->capacity - 1;
+    size_t slot = ((uint32_t)cell * 2654435761u) & mask;
+    while (set->keys[slot] != 0 && set->keys[slot] != cell + 1) slot = (slot + 1) & mask;
+    return slot;
+}
+
+static bool cell_set_init(Arena* arena, CellSet* set, size_t capacity) {
+    set->keys = scratch_calloc(arena, capacity, sizeof(int));
+    set->owners = scratch_alloc(arena, capacity * sizeof(int));
+    set->capacity = capacity;
+    set->count = 0;
+    return set->keys && set->owners;
+}
+
+static void cell_set_free(Arena* arena, CellSet* set) {
+    scratch_free(arena, set->keys);
+    scratch_free(arena, set->owners);
+}
+
+// Component that reached cell, or -1 if none did yet.
+static int cell_set_owner(const CellSet* set, int cell) {
+    size_t slot = cell_slot(set, cell);
+    return set->keys[slot] ? set->owners[slot] : -1;
+}
+
+static bool cell_set_add(Arena* arena, CellSet* set, int cell, int owner) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        CellSet grown;
+        if (!cell_set_init(arena, &grown, set->capacity * 2)) {
+            cell_set_free(arena, &grown);
+            return false;
+        }
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (!set->keys[i]) continue;
+            size_t slot = cell_slot(&grown, set->keys[i] - 1);
+            grown.keys[slot] = set->keys[i];
+            grown.owners[slot] = set->owners[i];
+        }
+        grown.count = set->count;
+        cell_set_free(arena, set);
+        *set = grown;
+    }
+    size_t slot = cell_slot(set, cell);
+    set->keys[slot] = cell + 1;
+    set->owners[slot] = owner;
+    set->count++;
+    return true;
+}
+
+static bool cell_list_push(Arena* arena, CellList* list, int cell) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        int* cells = scratch_alloc(arena, capacity * sizeof(int));
+        if (!cells) return false;
+        for (size_t i = 0; i < list->count; i++) cells[i] = list->cells[i];
+        scratch_free(arena, list->cells);
+        list->cells = cells;
+        list->capacity = capacity;
+    }
+    list->cells[list->count++] = cell;
+    return true;
+}
+
+typedef enum { PIT_CONTAINED, PIT_DRAINS, PIT_FAILED } PitResult;
 
-            } // end if potential pit start
-        } // end x loop
-    } // end y loop
+// Breadth-first search of the below-level component of start (already in
+// visited), collecting its cells in pit (which doubles as the queue) and its
+// lowest rim cell. Stops early once the component is known to drain: it
+// reaches the map edge, or a cell an earlier, drained search reached.
+static PitResult explore_pit(Arena* arena, const MapData* map, double ocean_level, int start, int owner,
+                             CellSet* visited, CellList* pit, double* spill_out) {
+    int width = map->width;
+    int height = map->height;
+    const double* elevation = map->elevation[0];
+    double spill = DBL_MAX;
+
+    pit->count = 0;
+    if (!cell_list_push(arena, pit, start)) return PIT_FAILED;
+    for (size_t head = 0; head < pit->count; head++) {
+        int cx = pit->cells[head] % width;
+        int cy = pit->cells[head] / width;
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                if (dx == 0 && dy == 0) continue;
+                int nx = cx + dx;
+                int ny = cy + dy;
+                if (nx < 0 || nx >= width || ny < 0 || ny >= height) return PIT_DRAINS;
+
+                int cell = ny * width + nx;
+                double e = elevation[cell];
+                if (e >= ocean_level) {
+                    if (e < spill) spill = e;
+                    continue;
+                }
+                int reached_by = cell_set_owner(visited, cell);
+                if (reached_by == owner) continue;
+                if (reached_by >= 0) return PIT_DRAINS;
+                if (!cell_set_add(arena, visited, cell, owner) || !cell_list_push(arena, pit, cell)) {
+                    return PIT_FAILED;
+                }
+            }
+        }
+    }
+    *spill_out = spill;
+    return spill < DBL_MAX ? PIT_CONTAINED : PIT_DRAINS;
+}
 
+MapRect fill_lakes_region(MapGenContext* ctx, MapData* map, double ocean_level, MapRect region) {
+    MapRect changed = map_rect_empty();
+    if (!map || !map->elevation) return changed;
 
-    // Cleanup
-    for(int y=0; y < height; ++y) free(visited[y]);
-    free(visited);
-    destroy_queue(q);
-    destroy_queue(pit_cells);
+    int width = map->width;
+    region = map_rect_expand(region, 1, width, map->height);
+    if (map_rect_is_empty(region)) return changed;
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    CellSet visited;
+    CellList pit = { NULL, 0, 0 };
+    if (!cell_set_init(arena, &visited, 1024)) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Failed to allocate lake filling scratch\n");
+        cell_set_free(arena, &visited);
+        arena_release(arena, mark);
+        return changed;
+    }
 
-    printf("Lake filling complete.\n");
+    double* elevation = map->elevation[0];
+    int components = 0;
+    int filled = 0;
+    bool failed = false;
+    for (int y = region.y0; y < region.y1 && !failed; ++y) {
+        for (int x = region.x0; x < region.x1 && !failed; ++x) {
+            int start = y * width + x;
+            if (elevation[start] >= ocean_level || cell_set_owner(&visited, start) >= 0) continue;
+
+            int owner = components++;
+            double spill = 0.0;
+            PitResult result = PIT_FAILED;
+            if (cell_set_add(arena, &visited, start, owner)) {
+                result = explore_pit(arena, map, ocean_level, start, owner, &visited, &pit, &spill);
+            }
+            if (result == PIT_FAILED) {
+                failed = true;
+            } else if (result == PIT_CONTAINED) {
+                filled++;
+                for (size_t i = 0; i < pit.count; i++) {
+                    int cell = pit.cells[i];
+                    if (elevation[cell] >= spill) continue;
+                    elevation[cell] = spill;
+                    int cx = cell % width;
+                    int cy = cell / width;
+                    changed = map_rect_union(changed, (MapRect){ cx, cy, cx + 1, cy + 1 });
+                }
+            }
+        }
+    }
+    if (failed) mapgen_log(ctx, MAPGEN_LOG_ERROR, "Out of memory filling lakes in region; update is partial.\n");
+    mapgen_log(ctx, MAPGEN_LOG_DEBUG, "Regional lake filling: %d depressions, %d filled, %zu cells explored\n",
+               components, filled, visited.count);
+
+    scratch_free(arena, pit.cells);
+    cell_set_free(arena, &visited);
+    arena_release(arena, mark);
+    return changed;
 }
@@ -0,0 +1,251 @@
+#include "layer_stats.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+
+#include "arena.h"
+
+#define STATS_HISTOGRAM_BINS 4096
+
+typedef enum {
+    STATS_PASS_RANGE,       // Min/max/count of the selected cells
+    STATS_PASS_COARSE,      // Histogram over [lo, hi]
+    STATS_PASS_FINE,        // Histogram inside coarse bin
+    STATS_PASS_GATHER       // Copy the values of fine bin out
+} StatsPass;
+
+typedef struct {
+    StatsPass pass;
+    const double* cells;
+    const double* gate;     // NULL selects every cell
+    double gate_min;
+    int width;
+
+    double lo, scale;               // Coarse bin = (v - lo) * scale
+    int coarse_bin;
+    double fine_lo, fine_scale;     // Fine bin, for cells in coarse_bin
+    int fine_bin;
+
+    double* band_min;
+    double* band_max;
+    long long* band_count;
+    uint32_t* band_histograms;      // STATS_HISTOGRAM_BINS per band
+    long long* band_offsets;        // Gather pass: first output slot per band
+    double* gathered;
+} StatsJob;
+
+static inline int bin_of(double v, double lo, double scale) {
+    int bin = (int)((v - lo) * scale);
+    bin = bin < 0 ? 0 : bin;
+    return bin < STATS_HISTOGRAM_BINS ? bin : STATS_HISTOGRAM_BINS - 1;
+}
+
+static void stats_band(void* user_data, int begin, int end, int band) {
+    const StatsJob* job = user_data;
+    size_t first = (size_t)begin * job->width;
+    size_t last = (size_t)end * job->width;
+    uint32_t* histogram = job->band_histograms ? job->band_histograms + (size_t)band * STATS_HISTOGRAM_BINS : NULL;
+    double min_val = DBL_MAX, max_val = -DBL_MAX;
+    long long count = 0;
+    long long out = job->band_offsets ? job->band_offsets[band] : 0;
+
+    for (size_t i = first; i < last; i++) {
+        if (job->gate && !(job->gate[i] >= job->gate_min)) continue;
+        double v = job->cells[i];
+        switch (job->pass) {
+            case STATS_PASS_RANGE:
+                min_val = v < min_val ? v : min_val;
+                max_val = v > max_val ? v : max_val;
+                count++;
+                break;
+            case STATS_PASS_COARSE:
+                histogram[bin_of(v, job->lo, job->scale)]++;
+                break;
+            case STATS_PASS_FINE:
+                if (bin_of(v, job->lo, job->scale) != job->coarse_bin) break;
+                histogram[bin_of(v, job->fine_lo, job->fine_scale)]++;
+                break;
+            case STATS_PASS_GATHER:
+                if (bin_of(v, job->lo, job->scale) != job->coarse_bin) break;
+                if (bin_of(v, job->fine_lo, job->fine_scale) != job->fine_bin) break;
+                job->gathered[out++] = v;
+                break;
+        }
+    }
+    if (job->pass == STATS_PASS_RANGE) {
+        job->band_min[band] = min_val;
+        job->band_max[band] = max_val;
+        job->band_count[band] = count;
+    }
+}
+
+// Merges the per-band histograms and finds the bin holding rank *k, leaving
+// *k as the rank inside that bin. Per-band counts of the bin go to band_in_bin.
+static int find_rank_bin(const uint32_t* band_histograms, int num_bands, long long* k,
+                         long long* band_in_bin) {
+    long long below = 0;
+    for (int bin = 0; bin < STATS_HISTOGRAM_BINS; bin++) {
+        long long in_bin = 0;
+        for (int b = 0; b < num_bands; b++) in_bin += band_histograms[(size_t)b * STATS_HISTOGRAM_BINS + bin];
+        if (*k < below + in_bin) {
+            *k -= below;
+            for (int b = 0; b < num_bands; b++) {
+                band_in_bin[b] = band_histograms[(size_t)b * STATS_HISTOGRAM_BINS + bin];
+            }
+            return bin;
+        }
+        below += in_bin;
+    }
+    return -1;
+}
+
+// Hoare quickselect with a middle pivot; leaves the k-th smallest at values[k].
+static double quickselect(double* values, long long count, long long k) {
+    long long left = 0, right = count - 1;
+    while (left < right) {
+        double pivot = values[left + (right - left) / 2];
+        long long i = left, j = right;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                double t = values[i]; values[i] = values[j]; values[j] = t;
+                i++; j--;
+            }
+        }
+        if (k <= j) right = j;
+        else if (k >= i) left = i;
+        else break;
+    }
+    return values[k];
+}
+
+// The four passes, with all scratch already allocated (band_offsets and
+// gathered are allocated here once the final bin size is known).
+static bool select_kth(MapGenContext* ctx, StatsJob* job, int height, long long k,
+                       long long* band_in_bin, double* value_out, long long* selected_out) {
+    Arena* arena = mapgen_context_arena(ctx);
+    int num_bands = mapgen_context_num_threads(ctx);
+
+    // Bands with no rows never run, so their partials start out neutral
+    for (int b = 0; b < num_bands; b++) {
+        job->band_min[b] = DBL_MAX;
+        job->band_max[b] = -DBL_MAX;
+        job->band_count[b] = 0;
+    }
+    mapgen_parallel_bands(ctx, height, stats_band, job);
+    double lo = DBL_MAX, hi = -DBL_MAX;
+    long long selected = 0;
+    for (int b = 0; b < num_bands; b++) {
+        if (job->band_min[b] < lo) lo = job->band_min[b];
+        if (job->band_max[b] > hi) hi = job->band_max[b];
+        selected += job->band_count[b];
+    }
+    if (selected_out) *selected_out = selected;
+    if (k < 0 || k >= selected) return false;
+    if (hi <= lo) {
+        *value_out = lo;
+        return true;
+    }
+
+    size_t histogram_bytes = (size_t)num_bands * STATS_HISTOGRAM_BINS * sizeof(uint32_t);
+    memset(job->band_histograms, 0, histogram_bytes);
+    job->pass = STATS_PASS_COARSE;
+    job->lo = lo;
+    job->scale = STATS_HISTOGRAM_BINS / (hi - lo);
+    mapgen_parallel_bands(ctx, height, stats_band, job);
+    job->coarse_bin = find_rank_bin(job->band_histograms, num_bands, &k, band_in_bin);
+
+    memset(job->band_histograms, 0, histogram_bytes);
+    job->pass = STATS_PASS_FINE;
+    job->fine_lo = lo + job->coarse_bin / job->scale;
+    job->fine_scale = job->scale * STATS_HISTOGRAM_BINS;
+    mapgen_parallel_bands(ctx, height, stats_band, job);
+    job->fine_bin = find_rank_bin(job->band_histograms, num_bands, &k, band_in_bin);
+
+    // Usually a handful of values remain; select among them exactly
+    job->band_offsets = scratch_alloc(arena, num_bands * sizeof(long long));
+    if (!job->band_offsets) return false;
+    long long total = 0;
+    for (int b = 0; b < num_bands; b++) {
+        job->band_offsets[b] = total;
+        total += band_in_bin[b];
+    }
+    job->gathered = scratch_alloc(arena, total * sizeof(double));
+    if (!job->gathered) return false;
+    job->pass = STATS_PASS_GATHER;
+    mapgen_parallel_bands(ctx, height, stats_band, job);
+    *value_out = quickselect(job->gathered, total, k);
+    return true;
+}
+
+bool layer_select_kth(MapGenContext* ctx, double** layer, double** gate, double gate_min,
+                      int width, int height, long long k, double* value_out,
+                      long long* selected_out) {
+    if (selected_out) *selected_out = 0;
+    if (!layer || !value_out || width <= 0 || height <= 0) return false;
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    int num_bands = mapgen_context_num_threads(ctx);
+    StatsJob job = {
+        .pass = STATS_PASS_RANGE, .cells = layer[0], .gate = gate ? gate[0] : NULL,
+        .gate_min = gate_min, .width = width,
+        .band_min = scratch_alloc(arena, num_bands * sizeof(double)),
+        .band_max = scratch_alloc(arena, num_bands * sizeof(double)),
+        .band_count = scratch_alloc(arena, num_bands * sizeof(long long)),
+        .band_histograms = scratch_alloc(arena, (size_t)num_bands * STATS_HISTOGRAM_BINS * sizeof(uint32_t))
+    };
+    long long* band_in_bin = scratch_alloc(arena, num_bands * sizeof(long long));
+
+    bool found = false;
+    if (!job.band_min || !job.band_max || !job.band_count || !job.band_histograms || !band_in_bin) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate layer statistics scratch.\n");
+    } else {
+        found = select_kth(ctx, &job, height, k, band_in_bin, value_out, selected_out);
+    }
+
+    scratch_free(arena, job.gathered);
+    scratch_free(arena, job.band_offsets);
+    scratch_free(arena, band_in_bin);
+    scratch_free(arena, job.band_histograms);
+    scratch_free(arena, job.band_count);
+    scratch_free(arena, job.band_max);
+    scratch_free(arena, job.band_min);
+    arena_release(arena, mark);
+    return found;
+}
+
+typedef struct {
+    const double* cells;
+    int width;
+    double threshold;
+    long long* band_count;
+} CountJob;
+
+static void count_band(void* user_data, int begin, int end, int band) {
+    const CountJob* job = user_data;
+    long long count = 0;
+    for (size_t i = (size_t)begin * job->width; i < (size_t)end * job->width; i++) {
+        count += job->cells[i] >= job->threshold;
+    }
+    job->band_count[band] = count;
+}
+
+long long layer_count_at_least(MapGenContext* ctx, double** layer, int width, int height,
+                               double threshold) {
+    if (!layer || width <= 0 || height <= 0) return 0;
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    int num_bands = mapgen_context_num_threads(ctx);
+    CountJob job = { layer[0], width, threshold, scratch_calloc(arena, num_bands, sizeof(long long)) };
+    long long total = 0;
+    if (job.band_count) {
+        mapgen_parallel_bands(ctx, height, count_band, &job);
+        for (int b = 0; b < num_bands; b++) total += job.band_count[b];
+    }
+    scratch_free(arena, job.band_count);
+    arena_release(arena, mark);
+    return total;
+}
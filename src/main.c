@@ -1,147 +1,320 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
-#include <float.h>
 #include <stdbool.h>
-#include <math.h>
+#include <unistd.h>
 
-#include "map_data.h"
-#include "map_io.h"
-#include "noise_generator.h"
-#include "map_shaping.h"
-#include "hydrology.h"
+#include "mapgen.h"
 
-#define MAP_WIDTH 512
-#define MAP_HEIGHT 256
 #define OUTPUT_PNG_FILENAME "world_map_fix.png" // New filename
-
-
-#define CONTINENT_LAND_THRESHOLD 0.52 // Increased this value
-#define REDISTRIBUTION_EXPONENT 1.8
-#define APPLY_TERRACING false
-#define NUM_TERRACE_LEVELS 12
-
-
-#define NUM_RIVERS 100
-#define MIN_RIVER_LENGTH 15
-#define MAX_RIVER_LENGTH 500
-#define RIVER_START_ELEV_MIN 0.5
-
-
-#define OCEAN_LEVEL_FOR_LAKES 0.18
-
-
-#define LATITUDE_TEMP_EFFECT_STRENGTH 0.0
-
-#define ENABLE_CONSOLE_OUTPUT false // Set to true to print ANSI map, false to skip
-
-
-void free_temp_map(double** temp_map, int height) {
-    if (!temp_map) return;
-    for (int y = 0; y < height; y++) {
-        free(temp_map[y]);
-    }
-    free(temp_map);
+#define BATCH_OUTPUT_DIR "batch_output"
+
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [--seed N]\n"
+            "       %s --batch JOBS_FILE [--jobs N] [--out DIR]\n"
+            "       %s --planet N [--seed N] [--jobs N] [--out DIR]\n"
+            "  --seed N        Generate a single map from seed N (default: time based)\n"
+            "  --batch FILE    Generate every '<seed> [key=value ...]' line of FILE\n"
+            "  --planet N      Generate a cube-sphere planet of six N x N faces into the output\n"
+            "                  directory and reproject it to " OUTPUT_PNG_FILENAME " (4N x 2N)\n"
+            "  --jobs N        Maps generated concurrently in batch and planet mode (default: cores)\n"
+            "  --out DIR       Batch and planet face output directory (default: " BATCH_OUTPUT_DIR ")\n"
+            "  --threads N     Band threads per map (default: cores, 1 in batch and planet mode)\n"
+            "  --lanes N       Independent pipeline stages run concurrently (default 2, 1 in batch mode)\n"
+            "  --cache-mb N    Memory for reusing stage outputs between maps (default 64, 0 in batch mode)\n"
+            "  --cache-dir DIR Also keep stage outputs in DIR, reused by later runs\n"
+            "  --cache-disk-mb N  Disk budget of the cache directory (default 1024, 0 = unlimited)\n"
+            "  --set KEY=VALUE Override a parameter (same keys as batch files), repeatable\n"
+            "  --pin           Pin band threads to cores (NUMA first-touch placement)\n"
+            "  --pages MODE    Layer pages: default, thp (transparent huge) or huge (hugetlb)\n"
+            "  --adaptive-noise EPS  Evaluate noise octaves on coarse grids, max error EPS\n"
+            "  --fast-pow EPS  Redistribute elevation through a pow() table, max error EPS\n"
+            "  --land-fraction F  Pick each map's continent threshold so F of it is land\n"
+            "  --erosion N     Erode the terrain with N droplets (0 = off)\n"
+            "  --thermal N     Relax slopes steeper than the talus for N iterations (0 = off)\n"
+            "  --wrap MODE     Noise wrapping: none, cylinder (seamless east-west) or torus\n"
+            "  --wind S        Blend S of the moisture from a wind sweep with rain shadows (0 = off)\n"
+            "  --basins FILE   Label drainage basins and write their statistics to FILE (CSV)\n"
+            "  --rivers FILE   Write the rivers as polylines to FILE (GeoJSON for .geojson/.json,\n"
+            "                  else compact binary)\n"
+            "  --river-tolerance T  Simplify river polylines to within T cells (default 1)\n"
+            "  --mesh FILE     Write an adaptive triangle mesh of the terrain to FILE (OBJ for\n"
+            "                  .obj, else binary)\n"
+            "  --mesh-error E  Max elevation error of the mesh (default 0.02)\n"
+            "  --mesh-height S Scale elevation by S in OBJ output (default 50)\n"
+            "  --contours FILE Write the coastline and elevation contours to FILE (GeoJSON for\n"
+            "                  .geojson/.json, else compact binary)\n"
+            "  --contour-interval I  Elevation between contours (default 0.1, 0 = coastline only)\n"
+            "  --contour-smooth N    Chaikin smoothing passes over the contours (default 2)\n"
+            "  --query X,Y     Print the point-query terrain at (X, Y) after checking the query\n"
+            "                  noise against the generated layers (repeatable)\n"
+            "  --brush X,Y,R,D Edit the map afterwards: raise elevation by D within radius R\n"
+            "                  of (X, Y), then update lakes and colors there (repeatable)\n",
+            program, program, program);
 }
 
 
-int main() {
+int main(int argc, char** argv) {
     printf("Procedural Map Generator - Fix Attempt\n");
 
-    srand((unsigned int)time(NULL));
-    int seed1 = rand();
-    int seed2 = rand();
-    int seed3 = rand();
-    printf("Using seeds: Elev=%d, Moist=%d, Cont=%d\n", seed1, seed2, seed3);
-
-
-    NoiseParams elev_params = {
-        .octaves = 6, .persistence = 0.5, .lacunarity = 2.0,
-        .base_frequency = 0.02, .use_ridged = false
-    };
-    NoiseParams moist_params = {
-        .octaves = 4, .persistence = 0.45, .lacunarity = 2.1,
-        .base_frequency = 0.06, .use_ridged = false
-    };
-    NoiseParams cont_params = {
-        .octaves = 2, .persistence = 0.5, .lacunarity = 2.0,
-        .base_frequency = 0.008, .use_ridged = false
-    };
-
-
-    NoiseState* noise_gen_elev = init_noise_generator(seed1);
-    NoiseState* noise_gen_moist = init_noise_generator(seed2);
-    NoiseState* noise_gen_cont = init_noise_generator(seed3);
-    MapData* map = create_map(MAP_WIDTH, MAP_HEIGHT);
-
-
-    double** continent_map = malloc(MAP_HEIGHT * sizeof(double*));
-    bool cont_map_ok = (continent_map != NULL);
-    if(cont_map_ok) {
-        for(int y = 0; y < MAP_HEIGHT; ++y) {
-            continent_map[y] = malloc(MAP_WIDTH * sizeof(double));
-            if (!continent_map[y]) {
-                cont_map_ok = false;
-                free_temp_map(continent_map, y);
-                break;
+    unsigned int seed = (unsigned int)time(NULL);
+    const char* batch_file = NULL;
+    const char* output_dir = BATCH_OUTPUT_DIR;
+    long num_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_threads = -1; // Not given
+    int num_lanes = -1;
+    int cache_mb = -1;
+    int cache_disk_mb = -1;
+    const char* cache_dir = NULL;
+    const char* overrides[64];
+    int num_overrides = 0;
+    bool pin_threads = false;
+    PageMode page_mode = PAGE_MODE_DEFAULT;
+    double adaptive_noise_error = 0.0;
+    double fast_pow_error = 0.0;
+    double land_fraction = 0.0;
+    long long erosion_droplets = -1;
+    int thermal_iterations = -1;
+    double wind_strength = -1.0;
+    const char* wrap_mode = NULL;
+    int planet_size = 0;
+    const char* basins_file = NULL;
+    const char* rivers_file = NULL;
+    double river_tolerance = 1.0;
+    const char* mesh_file = NULL;
+    double mesh_error = 0.02;
+    double mesh_height = 50.0;
+    const char* contours_file = NULL;
+    double contour_interval = 0.1;
+    int contour_smoothing = 2;
+    double brushes[16][4];
+    int num_brushes = 0;
+    double queries[16][2];
+    int num_queries = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--batch") == 0 && has_value) {
+            batch_file = argv[++i];
+        } else if (strcmp(argv[i], "--jobs") == 0 && has_value) {
+            num_jobs = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--out") == 0 && has_value) {
+            output_dir = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+            num_threads = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--lanes") == 0 && has_value) {
+            num_lanes = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cache-disk-mb") == 0 && has_value) {
+            cache_disk_mb = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cache-mb") == 0 && has_value) {
+            cache_mb = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cache-dir") == 0 && has_value) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--set") == 0 && has_value && num_overrides < 64) {
+            overrides[num_overrides++] = argv[++i];
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            pin_threads = true;
+        } else if (strcmp(argv[i], "--pages") == 0 && has_value) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "thp") == 0) page_mode = PAGE_MODE_TRANSPARENT_HUGE;
+            else if (strcmp(mode, "huge") == 0) page_mode = PAGE_MODE_EXPLICIT_HUGE;
+            else page_mode = PAGE_MODE_DEFAULT;
+        } else if (strcmp(argv[i], "--adaptive-noise") == 0 && has_value) {
+            adaptive_noise_error = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--fast-pow") == 0 && has_value) {
+            fast_pow_error = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--land-fraction") == 0 && has_value) {
+            land_fraction = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--erosion") == 0 && has_value) {
+            erosion_droplets = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--thermal") == 0 && has_value) {
+            thermal_iterations = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--planet") == 0 && has_value) {
+            planet_size = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--wrap") == 0 && has_value) {
+            wrap_mode = argv[++i];
+        } else if (strcmp(argv[i], "--wind") == 0 && has_value) {
+            wind_strength = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--basins") == 0 && has_value) {
+            basins_file = argv[++i];
+        } else if (strcmp(argv[i], "--rivers") == 0 && has_value) {
+            rivers_file = argv[++i];
+        } else if (strcmp(argv[i], "--river-tolerance") == 0 && has_value) {
+            river_tolerance = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--mesh") == 0 && has_value) {
+            mesh_file = argv[++i];
+        } else if (strcmp(argv[i], "--mesh-error") == 0 && has_value) {
+            mesh_error = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--mesh-height") == 0 && has_value) {
+            mesh_height = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--contours") == 0 && has_value) {
+            contours_file = argv[++i];
+        } else if (strcmp(argv[i], "--contour-interval") == 0 && has_value) {
+            contour_interval = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--contour-smooth") == 0 && has_value) {
+            contour_smoothing = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--query") == 0 && has_value && num_queries < 16) {
+            double* q = queries[num_queries++];
+            if (sscanf(argv[++i], "%lf,%lf", &q[0], &q[1]) != 2) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--brush") == 0 && has_value && num_brushes < 16) {
+            double* b = brushes[num_brushes++];
+            if (sscanf(argv[++i], "%lf,%lf,%lf,%lf", &b[0], &b[1], &b[2], &b[3]) != 4) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
             }
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
         }
     }
 
-
-    if (!noise_gen_elev || !noise_gen_moist || !noise_gen_cont || !map || !cont_map_ok) {
-        fprintf(stderr, "Initialization or temp map allocation failed.\n");
-        cleanup_noise_generator(noise_gen_elev);
-        cleanup_noise_generator(noise_gen_moist);
-        cleanup_noise_generator(noise_gen_cont);
-        destroy_map(map);
-        if(cont_map_ok) free_temp_map(continent_map, MAP_HEIGHT);
+    MapGenContext* ctx = mapgen_context_create();
+    if (!ctx) return EXIT_FAILURE;
+
+    MapGenConfig* config = mapgen_context_config(ctx);
+    // Batch and planet mode already run one map per core, so maps default to one band each
+    bool multi_map = batch_file || planet_size > 0;
+    if (num_threads >= 0) config->num_threads = num_threads;
+    else if (multi_map) config->num_threads = 1;
+    if (num_lanes >= 0) config->stage_lanes = num_lanes;
+    else if (multi_map) config->stage_lanes = 1;
+    if (cache_mb >= 0) config->cache_memory_mb = cache_mb;
+    else if (multi_map) config->cache_memory_mb = 0;
+    config->cache_dir = cache_dir;
+    if (cache_disk_mb >= 0) config->cache_disk_mb = cache_disk_mb;
+    config->pin_threads = pin_threads;
+    config->page_mode = page_mode;
+    config->elev_params.max_interp_error = adaptive_noise_error;
+    config->moist_params.max_interp_error = adaptive_noise_error;
+    config->cont_params.max_interp_error = adaptive_noise_error;
+    config->redistribution_max_error = fast_pow_error;
+    config->target_land_fraction = land_fraction;
+    if (erosion_droplets >= 0) config->erosion.droplets = erosion_droplets;
+    if (thermal_iterations >= 0) config->thermal.iterations = thermal_iterations;
+    if (wind_strength >= 0.0) config->wind.strength = wind_strength;
+    if (basins_file) config->compute_basins = true;
+    if (wrap_mode && !mapgen_config_set(config, "wrap", wrap_mode)) {
+        fprintf(stderr, "Unknown --wrap mode '%s'\n", wrap_mode);
+        mapgen_context_destroy(ctx);
         return EXIT_FAILURE;
     }
 
-
-    printf("Generating Base Elevation Map...\n");
-    generate_octave_noise_to_layer(noise_gen_elev, map->width, map->height, map->elevation, &elev_params);
-    printf("Generating Moisture Map...\n");
-    generate_octave_noise_to_layer(noise_gen_moist, map->width, map->height, map->moisture, &moist_params);
-    printf("Generating Continent Noise Map...\n");
-    generate_octave_noise_to_layer(noise_gen_cont, map->width, map->height, continent_map, &cont_params);
-
-
-    printf("Applying Continent Mask...\n");
-    apply_continent_mask(map, continent_map, map->width, map->height, CONTINENT_LAND_THRESHOLD);
-    printf("Redistributing Elevation Map...\n");
-    redistribute_map(map, REDISTRIBUTION_EXPONENT);
-    if (APPLY_TERRACING) {
-        printf("Applying Terraces...\n");
-        apply_terraces(map, NUM_TERRACE_LEVELS);
+    for (int i = 0; i < num_overrides; i++) {
+        char key[64];
+        const char* eq = strchr(overrides[i], '=');
+        size_t key_len = eq ? (size_t)(eq - overrides[i]) : 0;
+        if (!eq || key_len >= sizeof(key)) {
+            fprintf(stderr, "Invalid --set '%s', expected KEY=VALUE\n", overrides[i]);
+            mapgen_context_destroy(ctx);
+            return EXIT_FAILURE;
+        }
+        memcpy(key, overrides[i], key_len);
+        key[key_len] = '\0';
+        if (!mapgen_config_set(config, key, eq + 1)) {
+            fprintf(stderr, "Unknown --set key '%s'\n", key);
+            mapgen_context_destroy(ctx);
+            return EXIT_FAILURE;
+        }
     }
 
+    if (batch_file) {
+        BatchJob* jobs = NULL;
+        int count = 0;
+        if (load_batch_jobs(ctx, batch_file, config, &jobs, &count) != 0) {
+            mapgen_context_destroy(ctx);
+            return EXIT_FAILURE;
+        }
+        int failed = run_batch(ctx, jobs, count, num_jobs > 0 ? (int)num_jobs : 1, output_dir);
+        free(jobs);
+        mapgen_context_destroy(ctx);
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    printf("Filling Lakes...\n");
-    fill_lakes(map, OCEAN_LEVEL_FOR_LAKES);
-
-
-    printf("Generating Rivers...\n");
-    generate_rivers(map, NUM_RIVERS, MIN_RIVER_LENGTH, MAX_RIVER_LENGTH, RIVER_START_ELEV_MIN);
-
-
-    if (ENABLE_CONSOLE_OUTPUT) {
-    	printf("Printing text map to console...\n");
-    	print_map_text(map, LATITUDE_TEMP_EFFECT_STRENGTH);
-	}
+    printf("Using seed: %u\n", seed);
 
-    printf("Writing map to PNG image file...\n");
-    if (write_map_png(map, OUTPUT_PNG_FILENAME, LATITUDE_TEMP_EFFECT_STRENGTH) != 0) {
-        fprintf(stderr, "Error writing PNG file.\n");
+    if (planet_size > 0) {
+        int failed = generate_planet(ctx, seed, planet_size, num_jobs > 0 ? (int)num_jobs : 1, output_dir,
+                                     OUTPUT_PNG_FILENAME);
+        mapgen_context_destroy(ctx);
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
+    MapGenWorkspace ws;
+    init_map_workspace(&ws);
+    int result = generate_map(ctx, &ws, seed, OUTPUT_PNG_FILENAME);
+    // Basins, rivers, mesh and contours of the generated terrain, before any brush edits
+    if (result == 0 && basins_file) {
+        result = write_basin_csv(ctx, map_basins(ctx, ws.map, config->ocean_level_for_lakes), basins_file);
+    }
+    if (result == 0 && rivers_file) {
+        const RiverNetwork* rivers = map_river_network(ctx, ws.map, river_tolerance);
+        const char* ext = strrchr(rivers_file, '.');
+        bool geojson = ext && (strcmp(ext, ".geojson") == 0 || strcmp(ext, ".json") == 0);
+        result = geojson ? write_river_geojson(ctx, rivers, rivers_file) : write_river_binary(ctx, rivers, rivers_file);
+    }
+    if (result == 0 && mesh_file) {
+        TerrainMesh mesh;
+        const char* ext = strrchr(mesh_file, '.');
+        if (!build_terrain_mesh(ctx, ws.map, mesh_error, &mesh)) result = 1;
+        else if (ext && strcmp(ext, ".obj") == 0) result = write_mesh_obj(ctx, &mesh, mesh_height, mesh_file);
+        else result = write_mesh_binary(ctx, &mesh, mesh_file);
+        free_terrain_mesh(&mesh);
+    }
+    if (result == 0 && contours_file) {
+        // The coastline at the lake level, then every multiple of the interval
+        double levels[64] = { config->ocean_level_for_lakes };
+        int num_levels = 1;
+        for (int k = 1; contour_interval > 0.0 && k * contour_interval < 1.0 && num_levels < 64; k++) {
+            if (fabs(k * contour_interval - levels[0]) > 1e-9) levels[num_levels++] = k * contour_interval;
+        }
+        ContourSet contours;
+        const char* ext = strrchr(contours_file, '.');
+        bool geojson = ext && (strcmp(ext, ".geojson") == 0 || strcmp(ext, ".json") == 0);
+        if (!extract_contours(ctx, ws.map, levels, num_levels, contour_smoothing, &contours)) result = 1;
+        else if (geojson) result = write_contour_geojson(ctx, &contours, contours_file);
+        else result = write_contour_binary(ctx, &contours, contours_file);
+        free_contour_set(&contours);
+    }
+    if (result == 0 && num_queries > 0) {
+        TerrainQuery query;
+        if (!terrain_query_init(ctx, &query, config, seed)) {
+            result = 1;
+        } else {
+            // The query promises the layer values at integer points; hold it to that
+            double diff = terrain_query_check_noise(ctx, &query);
+            if (diff != 0.0) {
+                mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Point queries differ from the noise layers by %g.\n", diff);
+                result = 1;
+            } else {
+                printf("Point queries match the noise layers at all %d x %d cells.\n", config->width, config->height);
+            }
+            for (int q = 0; q < num_queries && result == 0; q++) {
+                TerrainSample s = terrain_query_point(&query, queries[q][0], queries[q][1]);
+                printf("Query (%.2f, %.2f): elevation %.4f, moisture %.4f, temperature %.4f, %s\n",
+                       queries[q][0], queries[q][1], s.elevation, s.moisture, s.temperature, biome_name(s.biome));
+            }
+            terrain_query_cleanup(ctx, &query);
+        }
+    }
+    if (result == 0 && num_brushes > 0) {
+        for (int b = 0; b < num_brushes; b++) {
+            map_brush_elevation(ws.map, brushes[b][0], brushes[b][1], brushes[b][2], brushes[b][3]);
+            map_update_dirty(ctx, ws.map, config->ocean_level_for_lakes,
+                             config->latitude_temp_effect_strength, ws.pixels);
+        }
+        if (ws.pixels) result = write_rgb_png(ctx, ws.pixels, ws.map->width, ws.map->height, OUTPUT_PNG_FILENAME);
+    }
+    cleanup_map_workspace(ctx, &ws);
+    mapgen_context_destroy(ctx);
 
-    destroy_map(map);
-    cleanup_noise_generator(noise_gen_elev);
-    cleanup_noise_generator(noise_gen_moist);
-    cleanup_noise_generator(noise_gen_cont);
-    free_temp_map(continent_map, MAP_HEIGHT);
-
-    return EXIT_SUCCESS;
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
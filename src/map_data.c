@@ -4,155 +4,250 @@
 #include <math.h>
 #include <float.h>
 #include <stdbool.h>
+#include <string.h>
+
+#include "point_ops.h"
+#include "components.h"
+#include "watershed.h"
+#include "rivers.h"
+
+typedef struct {
+    unsigned char* cells;
+    size_t row_bytes;
+} ZeroRowsJob;
+
+static void zero_rows_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    ZeroRowsJob* job = user_data;
+    memset(job->cells + (size_t)begin * job->row_bytes, 0, (size_t)(end - begin) * job->row_bytes);
+}
+
+// Allocates a layer as one contiguous block of cells plus a row pointer table,
+// from the context arena when one is set. The cells are zeroed band by band on
+// the context thread pool, so with an mmap'd arena each band's pages are first
+// touched (and placed) by the thread that processes that band later on.
+static void** alloc_layer_rows(MapGenContext* ctx, size_t cell_size, int width, int height) {
+    Arena* arena = mapgen_context_arena(ctx);
+    void** rows = scratch_alloc(arena, height * sizeof(void*));
+    unsigned char* cells = scratch_alloc(arena, (size_t)width * height * cell_size);
+    if (!rows || !cells) {
+        scratch_free(arena, rows);
+        scratch_free(arena, cells);
+        return NULL;
+    }
+    for (int y = 0; y < height; y++) {
+        rows[y] = cells + (size_t)y * width * cell_size;
+    }
+    ZeroRowsJob job = { cells, (size_t)width * cell_size };
+    mapgen_parallel_bands(ctx, height, zero_rows_band, &job);
+    return rows;
+}
+
+static void free_layer_rows(Arena* arena, void** rows) {
+    if (!rows) return;
+    scratch_free(arena, rows[0]);
+    scratch_free(arena, rows);
+}
+
+int32_t** create_label_layer(MapGenContext* ctx, int width, int height) {
+    if (width <= 0 || height <= 0) return NULL;
+    return (int32_t**)alloc_layer_rows(ctx, sizeof(int32_t), width, height);
+}
+
+void destroy_label_layer(MapGenContext* ctx, int32_t** layer) {
+    free_layer_rows(mapgen_context_arena(ctx), (void**)layer);
+}
 
-MapData* create_map(int width, int height) {
+double** create_layer(MapGenContext* ctx, int width, int height) {
+    if (width <= 0 || height <= 0) return NULL;
+    return (double**)alloc_layer_rows(ctx, sizeof(double), width, height);
+}
+
+void destroy_layer(MapGenContext* ctx, double** layer) {
+    free_layer_rows(mapgen_context_arena(ctx), (void**)layer);
+}
+
+// One line describing where the elevation layer's pages ended up.
+static void log_layer_placement(MapGenContext* ctx, const MapData* map) {
+    PageStats stats;
+    size_t bytes = (size_t)map->width * map->height * sizeof(double);
+    page_query_stats(map->elevation[0], bytes, &stats);
+
+    char nodes[128] = "";
+    size_t len = 0;
+    int placed = stats.sampled_pages - stats.unplaced_pages;
+    for (int node = 0; node < PAGE_STATS_MAX_NODES && len < sizeof(nodes); node++) {
+        if (stats.node_pages[node] == 0) continue;
+        len += snprintf(nodes + len, sizeof(nodes) - len, " node%d=%.0f%%", node,
+                        100.0 * stats.node_pages[node] / (placed > 0 ? placed : 1));
+    }
+    if (placed <= 0) snprintf(nodes, sizeof(nodes), " unknown");
+
+    double huge_percent = stats.mapping_bytes ? 100.0 * stats.huge_bytes / stats.mapping_bytes : 0.0;
+    mapgen_log(ctx, MAPGEN_LOG_INFO,
+               "Layer pages: %zu KiB base, %.0f%% of %.1f MiB mapping in %zu KiB huge pages, %d band threads, NUMA:%s\n",
+               stats.kernel_page_size / 1024, huge_percent, stats.mapping_bytes / (1024.0 * 1024.0),
+               HUGE_PAGE_SIZE / 1024, mapgen_context_num_threads(ctx), nodes);
+}
+
+MapData* create_map(MapGenContext* ctx, int width, int height) {
     if (width <= 0 || height <= 0) {
-        fprintf(stderr, "Error: Map dimensions must be positive.\n");
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Map dimensions must be positive.\n");
         return NULL;
     }
 
-    MapData* map = malloc(sizeof(MapData));
+    Arena* arena = mapgen_context_arena(ctx);
+    MapData* map = scratch_alloc(arena, sizeof(MapData));
     if (!map) {
-        perror("Error allocating MapData structure");
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error allocating MapData structure\n");
         return NULL;
     }
 
     map->width = width;
     map->height = height;
-    map->elevation = NULL;
-    map->moisture = NULL;
-    map->is_river = NULL;
-
-    // Allocate elevation
-    map->elevation = malloc(height * sizeof(double*));
-    if (!map->elevation) {
-        perror("Error allocating map elevation rows");
-        free(map);
+    map->cube_face = -1;
+    map->arena = arena;
+    map->dirty = map_rect_empty();
+    map->stale = 0;
+    map->temperature = NULL;
+    map->coast_distance = NULL;
+    map->river_distance = NULL;
+    map->component = NULL;
+    map->components = NULL;
+    map->basin = NULL;
+    map->basins = NULL;
+    map->river_paths = NULL;
+    map->river_path_count = 0;
+    map->river_path_stride = 0;
+    map->river_min_length = 0;
+    map->river_network = NULL;
+    // Layers are zero-initialised (0.0 elevation/moisture, no rivers)
+    map->elevation = create_layer(ctx, width, height);
+    map->moisture = create_layer(ctx, width, height);
+    map->is_river = (bool**)alloc_layer_rows(ctx, sizeof(bool), width, height);
+
+    if (!map->elevation || !map->moisture || !map->is_river) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error allocating map layers\n");
+        destroy_map(ctx, map);
         return NULL;
     }
 
-    for (int y = 0; y < height; y++) {
-        map->elevation[y] = malloc(width * sizeof(double));
-        if (!map->elevation[y]) {
-            perror("Error allocating map elevation columns");
-            for (int i = 0; i < y; i++) free(map->elevation[i]);
-            free(map->elevation);
-            free(map);
-            return NULL;
-        }
-    }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Created map (%dx%d) with elevation, moisture, and river layers%s\n",
+               width, height, arena ? " (session arena)" : "");
+    log_layer_placement(ctx, map);
+    return map;
+}
 
-    // Allocate moisture
-    map->moisture = malloc(height * sizeof(double*));
-    if (!map->moisture) {
-        perror("Error allocating map moisture rows");
-        for (int y = 0; y < height; y++) free(map->elevation[y]);
-        free(map->elevation);
-        free(map);
-        return NULL;
-    }
+void destroy_map(MapGenContext* ctx, MapData* map) {
+    if (!map) return;
 
-    for (int y = 0; y < height; y++) {
-        map->moisture[y] = malloc(width * sizeof(double));
-        if (!map->moisture[y]) {
-            perror("Error allocating map moisture columns");
-            for (int i = 0; i < y; i++) free(map->moisture[i]);
-            free(map->moisture);
-            for (int i = 0; i < height; i++) free(map->elevation[i]);
-            free(map->elevation);
-            free(map);
-            return NULL;
-        }
+    // Arena-backed maps are reclaimed by the session's arena_reset
+    Arena* arena = map->arena;
+    free_layer_rows(arena, (void**)map->elevation);
+    free_layer_rows(arena, (void**)map->moisture);
+    free_layer_rows(arena, (void**)map->is_river);
+    free_layer_rows(arena, (void**)map->temperature);
+    free_layer_rows(arena, (void**)map->coast_distance);
+    free_layer_rows(arena, (void**)map->river_distance);
+    free_layer_rows(arena, (void**)map->component);
+    if (map->components) scratch_free(arena, map->components->stats);
+    scratch_free(arena, map->components);
+    free_layer_rows(arena, (void**)map->basin);
+    if (map->basins) scratch_free(arena, map->basins->stats);
+    scratch_free(arena, map->basins);
+    if (map->river_network) {
+        scratch_free(arena, map->river_network->rivers);
+        scratch_free(arena, map->river_network->vertices);
     }
+    scratch_free(arena, map->river_network);
+    scratch_free(arena, map->river_paths);
+    scratch_free(arena, map);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Destroyed map\n");
+}
 
-    // Allocate is_river
-    map->is_river = malloc(height * sizeof(bool*));
-    if (!map->is_river) {
-        perror("Error allocating map is_river rows");
-        for(int y=0; y<height; y++) free(map->moisture[y]);
-        free(map->moisture);
-        for(int y=0; y<height; y++) free(map->elevation[y]);
-        free(map->elevation);
-        free(map);
-        return NULL;
+void clear_map(MapData* map) {
+    if (!map || !map->elevation || !map->moisture || !map->is_river) return;
+
+    size_t cells = (size_t)map->width * map->height;
+    memset(map->elevation[0], 0, cells * sizeof(double));
+    memset(map->moisture[0], 0, cells * sizeof(double));
+    memset(map->is_river[0], 0, cells * sizeof(bool));
+    if (map->temperature) memset(map->temperature[0], 0, cells * sizeof(double));
+    if (map->coast_distance) memset(map->coast_distance[0], 0, cells * sizeof(double));
+    if (map->river_distance) memset(map->river_distance[0], 0, cells * sizeof(double));
+    if (map->component) memset(map->component[0], 0, cells * sizeof(int32_t));
+    if (map->components) {
+        scratch_free(map->arena, map->components->stats);
+        scratch_free(map->arena, map->components);
+        map->components = NULL;
     }
-
-    for (int y = 0; y < height; y++) {
-        map->is_river[y] = malloc(width * sizeof(bool));
-        if (!map->is_river[y]) {
-            perror("Error allocating map is_river columns");
-            for(int i=0; i<y; i++) free(map->is_river[i]);
-            free(map->is_river);
-            for(int i=0; i<height; i++) free(map->moisture[i]);
-            free(map->moisture);
-            for(int i=0; i<height; i++) free(map->elevation[i]);
-            free(map->elevation);
-            free(map);
-            return NULL;
-        }
-        for (int x = 0; x < width; x++) {
-            map->is_river[y][x] = false;
-        }
+    if (map->basin) memset(map->basin[0], 0, cells * sizeof(int32_t));
+    if (map->basins) {
+        scratch_free(map->arena, map->basins->stats);
+        scratch_free(map->arena, map->basins);
+        map->basins = NULL;
     }
-
-    printf("Created map (%dx%d) with elevation, moisture, and river layers\n", width, height);
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            map->elevation[y][x] = 0.0;
-            map->moisture[y][x] = 0.0;
-        }
+    if (map->river_paths) {
+        for (size_t i = 0; i < (size_t)map->river_path_count * map->river_path_stride; i++) map->river_paths[i] = -1;
     }
+    map_drop_river_network(map);
+    map->dirty = map_rect_empty();
+    map->stale = 0;
+}
 
-    return map;
+// --- Dirty Regions ---
+
+MapRect map_rect_empty(void) {
+    return (MapRect){ 0, 0, 0, 0 };
 }
 
-void destroy_map(MapData* map) {
-    if (!map) return;
+bool map_rect_is_empty(MapRect rect) {
+    return rect.x0 >= rect.x1 || rect.y0 >= rect.y1;
+}
 
-    if (map->elevation) {
-        for (int y = 0; y < map->height; y++) {
-            free(map->elevation[y]);
-        }
-        free(map->elevation);
-    }
+MapRect map_rect_union(MapRect a, MapRect b) {
+    if (map_rect_is_empty(a)) return b;
+    if (map_rect_is_empty(b)) return a;
+    return (MapRect){ a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+                      a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1 };
+}
 
-    if (map->moisture) {
-        for (int y = 0; y < map->height; y++) {
-            free(map->moisture[y]);
-        }
-        free(map->moisture);
-    }
+MapRect map_rect_expand(MapRect rect, int margin, int width, int height) {
+    if (map_rect_is_empty(rect)) return map_rect_empty();
+    rect.x0 = rect.x0 - margin > 0 ? rect.x0 - margin : 0;
+    rect.y0 = rect.y0 - margin > 0 ? rect.y0 - margin : 0;
+    rect.x1 = rect.x1 + margin < width ? rect.x1 + margin : width;
+    rect.y1 = rect.y1 + margin < height ? rect.y1 + margin : height;
+    return map_rect_is_empty(rect) ? map_rect_empty() : rect;
+}
 
-    if (map->is_river) {
-        for (int y = 0; y < map->height; y++) {
-            free(map->is_river[y]);
-        }
-        free(map->is_river);
-    }
+void map_mark_dirty(MapData* map, MapRect rect) {
+    if (!map) return;
+    map->dirty = map_rect_union(map->dirty, map_rect_expand(rect, 0, map->width, map->height));
+}
 
-    free(map);
-    printf("Destroyed map\n");
+MapRect map_take_dirty(MapData* map) {
+    if (!map) return map_rect_empty();
+    MapRect dirty = map->dirty;
+    map->dirty = map_rect_empty();
+    return dirty;
 }
 
-void redistribute_map(MapData* map, double exponent) {
+void redistribute_map(MapGenContext* ctx, MapData* map, double exponent) {
     if (!map || !map->elevation) {
-        fprintf(stderr, "Error: Cannot redistribute NULL map.\n");
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Cannot redistribute NULL map.\n");
         return;
     }
     if (exponent <= 0) {
-        fprintf(stderr, "Warning: Using non-positive exponent (%.2f) in redistribution might lead to unexpected results. Applying anyway.\n", exponent);
-        if (exponent == 0.0) exponent = 1e-9;
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Using non-positive exponent (%.2f) in redistribution might lead to unexpected results. Applying anyway.\n", exponent);
     }
 
-    printf("Applying redistribution with exponent %.2f...\n", exponent);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Applying redistribution with exponent %.2f...\n", exponent);
 
-    for (int y = 0; y < map->height; y++) {
-        for (int x = 0; x < map->width; x++) {
-            double original_elevation = map->elevation[y][x];
-            map->elevation[y][x] = pow(original_elevation, exponent);
-        }
-    }
+    PointChain chain;
+    point_chain_init(&chain);
+    point_chain_pow(&chain, exponent, 0.0);
+    point_chain_apply(ctx, &chain, map->elevation, map->width, map->height);
 
-    printf("Redistribution complete.\n");
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Redistribution complete.\n");
 }
@@ -0,0 +1,100 @@
+#include "map_edit.h"
+#include <math.h>
+#include <time.h>
+
+#include "climate.h"
+#include "components.h"
+#include "hydrology.h"
+#include "map_io.h"
+#include "watershed.h"
+
+void map_brush_elevation(MapData* map, double cx, double cy, double radius, double delta) {
+    if (!map || !map->elevation || radius <= 0.0) return;
+
+    MapRect rect = map_rect_expand((MapRect){ (int)floor(cx - radius), (int)floor(cy - radius),
+                                              (int)ceil(cx + radius) + 1, (int)ceil(cy + radius) + 1 },
+                                   0, map->width, map->height);
+    double inv_r2 = 1.0 / (radius * radius);
+    for (int y = rect.y0; y < rect.y1; y++) {
+        for (int x = rect.x0; x < rect.x1; x++) {
+            double d2 = ((x - cx) * (x - cx) + (y - cy) * (y - cy)) * inv_r2;
+            if (d2 >= 1.0) continue;
+            double falloff = (1.0 - d2) * (1.0 - d2);
+            double e = map->elevation[y][x] + delta * falloff;
+            map->elevation[y][x] = e < 0.0 ? 0.0 : (e > 1.0 ? 1.0 : e);
+        }
+    }
+    map_mark_dirty(map, rect);
+}
+
+typedef struct {
+    const MapData* map;
+    unsigned char* pixels;
+    MapRect rect;
+} RenderRectJob;
+
+static void render_rect_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    RenderRectJob* job = user_data;
+    MapRect rows = { job->rect.x0, job->rect.y0 + begin, job->rect.x1, job->rect.y0 + end };
+    render_map_rect(job->map, job->pixels, rows);
+}
+
+// Sets the water bit of the component labels in rect from the edited
+// elevation, before fill_lakes_region raises new pits above ocean_level: a
+// cell is water below the level, or if it was in a filled lake and is still
+// no higher than the lake surface. The ids are left to map_components; until
+// it renumbers them they still index map->components.
+static void patch_component_classes(MapGenContext* ctx, MapData* map, double ocean_level, MapRect rect) {
+    const ComponentTable* table = map->components ? map->components : map_components(ctx, map);
+    for (int y = rect.y0; y < rect.y1; y++) {
+        for (int x = rect.x0; x < rect.x1; x++) {
+            int32_t label = map->component[y][x];
+            double e = map->elevation[y][x];
+            bool water = e < ocean_level;
+            if (!water && COMPONENT_IS_WATER(label) && table && COMPONENT_ID(label) < table->count) {
+                const ComponentStats* lake = &table->stats[COMPONENT_ID(label)];
+                water = lake->lake && e <= lake->surface;
+            }
+            map->component[y][x] = (label & ~1) | water;
+        }
+    }
+}
+
+MapRect map_update_dirty(MapGenContext* ctx, MapData* map, double ocean_level,
+                         double latitude_temp_factor, unsigned char* pixels) {
+    MapRect dirty = map_take_dirty(map);
+    if (map_rect_is_empty(dirty)) return dirty;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (map->component) patch_component_classes(ctx, map, ocean_level, dirty);
+    MapRect filled = fill_lakes_region(ctx, map, ocean_level, dirty);
+    MapRect changed = map_rect_union(dirty, filled);
+    MapRect rivers = update_rivers_region(ctx, map, changed);
+    changed = map_rect_union(changed, rivers);
+
+    // Whole-map ids, tables and distances are not patched; flag them for their accessors
+    if (map->component) map->stale |= MAP_STALE_COMPONENTS;
+    if (map->basin) {
+        if (map->basins) {
+            scratch_free(map->arena, map->basins->stats);
+            scratch_free(map->arena, map->basins);
+            map->basins = NULL;
+        }
+        map->stale |= MAP_STALE_BASINS;
+    }
+    if (map->coast_distance || map->river_distance) map->stale |= MAP_STALE_DISTANCES;
+    update_temperature_rect(map, latitude_temp_factor, changed);
+    if (pixels) {
+        RenderRectJob job = { map, pixels, changed };
+        mapgen_parallel_bands(ctx, changed.y1 - changed.y0, render_rect_band, &job);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Updated edited region [%d,%d)x[%d,%d) in %.2f ms\n",
+               changed.x0, changed.x1, changed.y0, changed.y1,
+               (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    return changed;
+}
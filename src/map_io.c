@@ -1,64 +1,68 @@
 #include "map_io.h"
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
 
+#include "climate.h"
+#include "map_pipeline.h"
+
+// Keep stb's symbols (and its global settings) private to this file, so a host
+// application linking its own stb_image_write cannot interfere with ours.
+#define STB_IMAGE_WRITE_STATIC
 #define STB_IMAGE_WRITE_IMPLEMENTATION
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-variable"
 #include "stb_image_write.h"
+#pragma GCC diagnostic pop
+
+#define PNG_DEFAULT_COMPRESSION_LEVEL 8
 
 typedef struct { unsigned char r, g, b; } RGBColor;
 
-const RGBColor COLOR_LAKE_WATER      = { 93, 173, 226};
-const RGBColor COLOR_OCEAN           = { 68, 108, 179};
-const RGBColor COLOR_BEACH           = {247, 220, 111};
-const RGBColor COLOR_FOREST_GREEN    = { 39, 174,  96};
-const RGBColor COLOR_JUNGLE_GREEN    = { 46, 204, 113};
-const RGBColor COLOR_GRASS           = { 88, 214, 141};
-const RGBColor COLOR_SAVANNAH        = {212, 172,  13};
-const RGBColor COLOR_SHRUBLAND       = {241, 196,  15};
-const RGBColor COLOR_TAIGA           = { 93, 173, 226};
-const RGBColor COLOR_TUNDRA          = {169, 204, 227};
-const RGBColor COLOR_SNOW            = {236, 240, 241};
-const RGBColor COLOR_SCORCHED        = {192,  57,  43};
-const RGBColor COLOR_BARE_ROCK       = {149, 165, 166};
-const RGBColor COLOR_DESERT_SAND     = {210, 180, 140};
-const RGBColor COLOR_SHALLOW_OCEAN   = { 77, 136, 209}; // Defined but not used now
-
-#define ELEV_OCEAN           0.15
-#define ELEV_LAKE_MAX        0.18
-#define ELEV_BEACH           0.18
-#define ELEV_TROPICAL_MAX    0.40
-#define ELEV_TEMPERATE_MAX   0.65
-#define ELEV_BOREAL_MAX      0.85
-
-#define MOIST_DESERT         0.20
-#define MOIST_GRASS_SAVANNAH 0.40
-#define MOIST_WOODLAND_SHRUB 0.70
-
-#define ANSI_BG_LAKE_WATER   "\x1b[46m"
-#define ANSI_BG_DEEP_BLUE    "\x1b[44m"
-#define ANSI_BG_SAND         "\x1b[103m"
-#define ANSI_BG_FOREST_GREEN "\x1b[42m"
-#define ANSI_BG_JUNGLE_GREEN "\x1b[102m"
-#define ANSI_BG_GRASS        "\x1b[42m"
-#define ANSI_BG_SAVANNAH     "\x1b[43m"
-#define ANSI_BG_SHRUBLAND    "\x1b[103m"
-#define ANSI_BG_TAIGA        "\x1b[46m"
-#define ANSI_BG_TUNDRA       "\x1b[106m"
-#define ANSI_BG_SNOW         "\x1b[107m"
-#define ANSI_BG_SCORCHED     "\x1b[41m"
-#define ANSI_BG_BARE_ROCK    "\x1b[100m"
-#define ANSI_BG_DESERT_SAND  "\x1b[43m"
-#define ANSI_BG_SHALLOW_OCEAN "\x1b[104m" // Defined but not used now
+// Indexed by Biome (see climate.h)
+static const RGBColor BIOME_PALETTE[BIOME_COUNT] = {
+    [BIOME_OCEAN]     = { 68, 108, 179},
+    [BIOME_LAKE]      = { 93, 173, 226},
+    [BIOME_SCORCHED]  = {192,  57,  43},
+    [BIOME_BARE_ROCK] = {149, 165, 166},
+    [BIOME_TUNDRA]    = {169, 204, 227},
+    [BIOME_SNOW]      = {236, 240, 241},
+    [BIOME_SAVANNAH]  = {212, 172,  13},
+    [BIOME_SHRUBLAND] = {241, 196,  15},
+    [BIOME_TAIGA]     = { 93, 173, 226},
+    [BIOME_GRASSLAND] = { 88, 214, 141},
+    [BIOME_FOREST]    = { 39, 174,  96},
+    [BIOME_DESERT]    = {210, 180, 140},
+    [BIOME_JUNGLE]    = { 46, 204, 113},
+};
+
+static const char* const BIOME_ANSI[BIOME_COUNT] = {
+    [BIOME_OCEAN]     = "\x1b[44m",
+    [BIOME_LAKE]      = "\x1b[46m",
+    [BIOME_SCORCHED]  = "\x1b[41m",
+    [BIOME_BARE_ROCK] = "\x1b[100m",
+    [BIOME_TUNDRA]    = "\x1b[106m",
+    [BIOME_SNOW]      = "\x1b[107m",
+    [BIOME_SAVANNAH]  = "\x1b[43m",
+    [BIOME_SHRUBLAND] = "\x1b[103m",
+    [BIOME_TAIGA]     = "\x1b[46m",
+    [BIOME_GRASSLAND] = "\x1b[42m",
+    [BIOME_FOREST]    = "\x1b[42m",
+    [BIOME_DESERT]    = "\x1b[43m",
+    [BIOME_JUNGLE]    = "\x1b[102m",
+};
+
 #define ANSI_RESET           "\x1b[0m"
 
-static inline double clamp_io(double value, double min_val, double max_val) {
-    if (value < min_val) return min_val;
-    if (value > max_val) return max_val;
-    return value;
+// Biome of cell (x, y), from map->temperature when the map has it.
+static inline Biome cell_biome(const MapData* map, int x, int y) {
+    double t = map->temperature ? map->temperature[y][x] : temperature_from_elevation(map->elevation[y][x]);
+    return classify_biome(t, map->moisture[y][x]);
 }
 
-void print_map_text(const MapData* map, double latitude_temp_factor) {
+void print_map_text(const MapData* map) {
     if (!map || !map->elevation || !map->moisture) { return; }
 
     printf("--- Map (%dx%d) ---\n", map->width, map->height);
@@ -66,27 +70,8 @@ void print_map_text(const MapData* map, double latitude_temp_factor) {
     int height = map->height;
 
     for (int y = 0; y < height; y++) {
-        double latitude_norm = (double)y / (height > 1 ? height - 1 : 1);
-        double dist_from_equator = fabs(latitude_norm - 0.5) * 2.0;
-
         for (int x = 0; x < width; x++) {
-            double e_orig = map->elevation[y][x];
-            double m = map->moisture[y][x];
-            double e_effective = clamp_io(e_orig + latitude_temp_factor * dist_from_equator, 0.0, 1.0);
-            const char* bg_color_code;
-
-            if (e_effective < ELEV_OCEAN) {
-                bg_color_code = ANSI_BG_DEEP_BLUE;
-            }
-            else if (e_effective < ELEV_BEACH) {
-                 bg_color_code = ANSI_BG_LAKE_WATER;
-            }
-            else if (e_effective > ELEV_BOREAL_MAX) { if (m < MOIST_DESERT) bg_color_code = ANSI_BG_SCORCHED; else if (m < MOIST_GRASS_SAVANNAH) bg_color_code = ANSI_BG_BARE_ROCK; else if (m < MOIST_WOODLAND_SHRUB) bg_color_code = ANSI_BG_TUNDRA; else bg_color_code = ANSI_BG_SNOW;}
-            else if (e_effective > ELEV_TEMPERATE_MAX) { if (m < MOIST_DESERT) bg_color_code = ANSI_BG_SAVANNAH; else if (m < MOIST_GRASS_SAVANNAH) bg_color_code = ANSI_BG_SHRUBLAND; else if (m < MOIST_WOODLAND_SHRUB) bg_color_code = ANSI_BG_TAIGA; else bg_color_code = ANSI_BG_TAIGA; }
-            else if (e_effective > ELEV_TROPICAL_MAX) { if (m < MOIST_DESERT) bg_color_code = ANSI_BG_SAVANNAH; else if (m < MOIST_GRASS_SAVANNAH) bg_color_code = ANSI_BG_GRASS; else if (m < MOIST_WOODLAND_SHRUB) bg_color_code = ANSI_BG_FOREST_GREEN; else bg_color_code = ANSI_BG_FOREST_GREEN; }
-            else { if (m < MOIST_DESERT) bg_color_code = ANSI_BG_DESERT_SAND; else if (m < MOIST_GRASS_SAVANNAH) bg_color_code = ANSI_BG_GRASS; else if (m < MOIST_WOODLAND_SHRUB) bg_color_code = ANSI_BG_JUNGLE_GREEN; else bg_color_code = ANSI_BG_JUNGLE_GREEN; }
-
-            printf("%s %s", bg_color_code, ANSI_RESET);
+            printf("%s %s", BIOME_ANSI[cell_biome(map, x, y)], ANSI_RESET);
          }
          putchar('\n');
      }
@@ -94,50 +79,384 @@ void print_map_text(const MapData* map, double latitude_temp_factor) {
 }
 
 
-int write_map_png(const MapData* map, const char* filename, double latitude_temp_factor) {
-     if (!map || !map->elevation || !map->moisture) { return 1; }
-     if (!filename) { return 1; }
+void render_map_rgb(const MapData* map, unsigned char* pixel_data) {
+     if (!map) { return; }
+     render_map_rows(map, pixel_data, 0, map->height);
+}
+
+void render_map_rows(const MapData* map, unsigned char* pixel_data, int y_begin, int y_end) {
+     if (!map) { return; }
+     render_map_rect(map, pixel_data, (MapRect){ 0, y_begin, map->width, y_end });
+}
+
+void render_map_rect(const MapData* map, unsigned char* pixel_data, MapRect rect) {
+     if (!map || !map->elevation || !map->moisture || !pixel_data) { return; }
 
      int width = map->width;
-     int height = map->height;
      int channels = 3;
-     unsigned char *pixel_data = malloc(width * height * channels * sizeof(unsigned char));
-     if (!pixel_data) { return 1; }
-
-     printf("Preparing pixel data for PNG file: %s\n", filename);
-
-     for (int y = 0; y < height; y++) {
-         double latitude_norm = (double)y / (height > 1 ? height - 1 : 1);
-         double dist_from_equator = fabs(latitude_norm - 0.5) * 2.0;
-
-         for (int x = 0; x < width; x++) {
-             double e_orig = map->elevation[y][x];
-             double m = map->moisture[y][x];
-             double e_effective = clamp_io(e_orig + latitude_temp_factor * dist_from_equator, 0.0, 1.0);
-             RGBColor color;
-
-             if (e_effective < ELEV_OCEAN) {
-                 color = COLOR_OCEAN;
-             }
-             else if (e_effective < ELEV_BEACH) {
-                 color = COLOR_LAKE_WATER;
-             }
-             else if (e_effective > ELEV_BOREAL_MAX) { if (m < MOIST_DESERT) color = COLOR_SCORCHED; else if (m < MOIST_GRASS_SAVANNAH) color = COLOR_BARE_ROCK; else if (m < MOIST_WOODLAND_SHRUB) color = COLOR_TUNDRA; else color = COLOR_SNOW;}
-             else if (e_effective > ELEV_TEMPERATE_MAX) { if (m < MOIST_DESERT) color = COLOR_SAVANNAH; else if (m < MOIST_GRASS_SAVANNAH) color = COLOR_SHRUBLAND; else if (m < MOIST_WOODLAND_SHRUB) color = COLOR_TAIGA; else color = COLOR_TAIGA; }
-             else if (e_effective > ELEV_TROPICAL_MAX) { if (m < MOIST_DESERT) color = COLOR_SAVANNAH; else if (m < MOIST_GRASS_SAVANNAH) color = COLOR_GRASS; else if (m < MOIST_WOODLAND_SHRUB) color = COLOR_FOREST_GREEN; else color = COLOR_FOREST_GREEN; }
-             else { if (m < MOIST_DESERT) color = COLOR_DESERT_SAND; else if (m < MOIST_GRASS_SAVANNAH) color = COLOR_GRASS; else if (m < MOIST_WOODLAND_SHRUB) color = COLOR_JUNGLE_GREEN; else color = COLOR_JUNGLE_GREEN; }
 
+     for (int y = rect.y0; y < rect.y1; y++) {
+         for (int x = rect.x0; x < rect.x1; x++) {
+             RGBColor color = BIOME_PALETTE[cell_biome(map, x, y)];
              int index = (y * width + x) * channels;
              pixel_data[index + 0] = color.r;
              pixel_data[index + 1] = color.g;
              pixel_data[index + 2] = color.b;
          }
      }
+}
+
+
+// Encodes an RGB/RGBA image as PNG. Mirrors stbi_write_png_to_mem, except the
+// zlib level is a parameter instead of stb's global stbi_write_png_compression_level,
+// so concurrent writers with different settings don't race. Filter scratch
+// comes from arena (may be NULL). Returns a STBIW_MALLOC'd buffer (free with
+// STBIW_FREE) or NULL.
+static unsigned char* encode_png(Arena* arena, const unsigned char* pixels, int x, int y, int n,
+                                 int compression_level, int* out_len) {
+    int ctype[5] = { -1, 0, 4, 2, 6 };
+    unsigned char sig[8] = { 137,80,78,71,13,10,26,10 };
+    int stride_bytes = x * n;
+    int zlen;
+
+    unsigned char* filt = scratch_alloc(arena, (size_t)(x * n + 1) * y);
+    signed char* line_buffer = scratch_alloc(arena, (size_t)x * n);
+    if (!filt || !line_buffer) {
+        scratch_free(arena, filt);
+        scratch_free(arena, line_buffer);
+        return NULL;
+    }
+
+    for (int j = 0; j < y; ++j) {
+        // Pick the filter with the lowest estimated entropy, as stb does
+        int best_filter = 0, best_filter_val = 0x7fffffff;
+        for (int filter_type = 0; filter_type < 5; filter_type++) {
+            stbiw__encode_png_line((unsigned char*)pixels, stride_bytes, x, y, j, n, filter_type, line_buffer);
+            int est = 0;
+            for (int i = 0; i < x * n; ++i) {
+                est += abs((signed char)line_buffer[i]);
+            }
+            if (est < best_filter_val) {
+                best_filter_val = est;
+                best_filter = filter_type;
+            }
+        }
+        if (best_filter != 4) { // line_buffer still holds the last filter tried
+            stbiw__encode_png_line((unsigned char*)pixels, stride_bytes, x, y, j, n, best_filter, line_buffer);
+        }
+        filt[j * (x * n + 1)] = (unsigned char)best_filter;
+        STBIW_MEMMOVE(filt + j * (x * n + 1) + 1, line_buffer, x * n);
+    }
+    scratch_free(arena, line_buffer);
+
+    unsigned char* zlib = stbi_zlib_compress(filt, y * (x * n + 1), &zlen, compression_level);
+    scratch_free(arena, filt);
+    if (!zlib) return NULL;
+
+    // each tag requires 12 bytes of overhead
+    *out_len = 8 + 12 + 13 + 12 + zlen + 12;
+    unsigned char* out = STBIW_MALLOC(*out_len);
+    if (!out) { STBIW_FREE(zlib); return NULL; }
 
-     printf("Writing map to PNG file: %s\n", filename);
-     int success = stbi_write_png(filename, width, height, channels, pixel_data, width * channels);
-     free(pixel_data);
+    unsigned char* o = out;
+    STBIW_MEMMOVE(o, sig, 8); o += 8;
+    stbiw__wp32(o, 13); // header length
+    stbiw__wptag(o, "IHDR");
+    stbiw__wp32(o, x);
+    stbiw__wp32(o, y);
+    *o++ = 8;
+    *o++ = STBIW_UCHAR(ctype[n]);
+    *o++ = 0;
+    *o++ = 0;
+    *o++ = 0;
+    stbiw__wpcrc(&o, 13);
 
-     if (success) { printf("PNG file write complete.\n"); return 0; }
-     else { fprintf(stderr, "Error writing PNG file using stb_image_write.\n"); return 1; }
+    stbiw__wp32(o, zlen);
+    stbiw__wptag(o, "IDAT");
+    STBIW_MEMMOVE(o, zlib, zlen);
+    o += zlen;
+    STBIW_FREE(zlib);
+    stbiw__wpcrc(&o, zlen);
+
+    stbiw__wp32(o, 0);
+    stbiw__wptag(o, "IEND");
+    stbiw__wpcrc(&o, 0);
+
+    return out;
+}
+
+
+int write_map_png(MapGenContext* ctx, const MapData* map, const char* filename) {
+     if (!map || !map->elevation || !map->moisture) { return 1; }
+     if (!filename) { return 1; }
+
+     int width = map->width;
+     int height = map->height;
+     int channels = 3;
+     Arena* arena = mapgen_context_arena(ctx);
+     ArenaMark mark = arena_mark(arena);
+     unsigned char* pixel_data = scratch_alloc(arena, (size_t)width * height * channels * sizeof(unsigned char));
+     if (!pixel_data) {
+         arena_release(arena, mark);
+         return 1;
+     }
+
+     mapgen_log(ctx, MAPGEN_LOG_INFO, "Preparing pixel data for PNG file: %s\n", filename);
+     render_map_rgb(map, pixel_data);
+
+     int result = write_rgb_png(ctx, pixel_data, width, height, filename);
+     scratch_free(arena, pixel_data);
+     arena_release(arena, mark);
+     return result;
+}
+
+int write_rgb_png(MapGenContext* ctx, const unsigned char* pixel_data, int width, int height,
+                  const char* filename) {
+     if (!pixel_data || !filename) { return 1; }
+
+     int channels = 3;
+     Arena* arena = mapgen_context_arena(ctx);
+     ArenaMark mark = arena_mark(arena);
+     mapgen_log(ctx, MAPGEN_LOG_INFO, "Writing map to PNG file: %s\n", filename);
+     const MapGenConfig* config = mapgen_context_config(ctx);
+     int level = config ? config->png_compression_level : PNG_DEFAULT_COMPRESSION_LEVEL;
+     int png_len = 0;
+     unsigned char* png = encode_png(arena, pixel_data, width, height, channels, level, &png_len);
+     bool success = false;
+     if (png) {
+         FILE* f = fopen(filename, "wb");
+         if (f) {
+             success = fwrite(png, 1, png_len, f) == (size_t)png_len;
+             success = (fclose(f) == 0) && success;
+         }
+         STBIW_FREE(png);
+     }
+     arena_release(arena, mark);
+
+     if (success) { mapgen_log(ctx, MAPGEN_LOG_INFO, "PNG file write complete.\n"); return 0; }
+     else { mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing PNG file %s.\n", filename); return 1; }
+}
+
+int write_basin_csv(MapGenContext* ctx, const BasinTable* basins, const char* filename) {
+     if (!basins || !filename) { return 1; }
+
+     static const char* const DRAINS[] = { "ocean", "lake", "edge", "sink" };
+     FILE* f = fopen(filename, "w");
+     if (!f) {
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error opening basin file %s.\n", filename);
+         return 1;
+     }
+     bool success = fprintf(f, "id,area,x0,y0,x1,y1,outlet_x,outlet_y,drains,water_body,"
+                               "outlet_elevation,peak_elevation\n") > 0;
+     for (int b = 0; success && b < basins->count; b++) {
+         const BasinStats* s = &basins->stats[b];
+         success = fprintf(f, "%d,%lld,%d,%d,%d,%d,%d,%d,%s,%d,%.6f,%.6f\n", b, s->area,
+                           s->bbox.x0, s->bbox.y0, s->bbox.x1, s->bbox.y1, s->outlet_x, s->outlet_y,
+                           DRAINS[s->outlet], (int)s->water_body, s->outlet_elevation, s->peak_elevation) > 0;
+     }
+     success = (fclose(f) == 0) && success;
+
+     if (success) { mapgen_log(ctx, MAPGEN_LOG_INFO, "Wrote %d basins to %s.\n", basins->count, filename); return 0; }
+     else { mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing basin file %s.\n", filename); return 1; }
+}
+
+int write_river_geojson(MapGenContext* ctx, const RiverNetwork* rivers, const char* filename) {
+     if (!rivers || !filename) { return 1; }
+
+     FILE* f = fopen(filename, "w");
+     if (!f) {
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error opening river file %s.\n", filename);
+         return 1;
+     }
+     bool success = fputs("{\"type\":\"FeatureCollection\",\"features\":[", f) >= 0;
+     for (int r = 0; success && r < rivers->count; r++) {
+         const RiverPolyline* river = &rivers->rivers[r];
+         success = fprintf(f, "%s\n{\"type\":\"Feature\",\"properties\":{\"id\":%d,\"order\":%d,\"length\":%.3f,"
+                              "\"cells\":%d,\"joins\":%d},\"geometry\":{\"type\":\"LineString\",\"coordinates\":[",
+                           r > 0 ? "," : "", r, river->order, river->length, river->cells, river->joins) > 0;
+         for (int v = 0; success && v < river->count; v++) {
+             const RiverVertex* vertex = &rivers->vertices[river->first + v];
+             success = fprintf(f, "%s[%d,%d]", v > 0 ? "," : "", vertex->x, vertex->y) > 0;
+         }
+         success = success && fputs("]}}", f) >= 0;
+     }
+     success = success && fputs("\n]}\n", f) >= 0;
+     success = (fclose(f) == 0) && success;
+
+     if (success) { mapgen_log(ctx, MAPGEN_LOG_INFO, "Wrote %d rivers to %s.\n", rivers->count, filename); return 0; }
+     else { mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing river file %s.\n", filename); return 1; }
+}
+
+// LEB128: 7 bits per byte, low bits first, high bit set on all but the last.
+static bool put_varint(FILE* f, uint64_t value) {
+     while (value >= 0x80) {
+         if (fputc((int)(value & 0x7F) | 0x80, f) == EOF) return false;
+         value >>= 7;
+     }
+     return fputc((int)value, f) != EOF;
+}
+
+static bool put_zigzag(FILE* f, int64_t value) {
+     return put_varint(f, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+int write_river_binary(MapGenContext* ctx, const RiverNetwork* rivers, const char* filename) {
+     if (!rivers || !filename) { return 1; }
+
+     FILE* f = fopen(filename, "wb");
+     if (!f) {
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error opening river file %s.\n", filename);
+         return 1;
+     }
+     bool success = fwrite("MGRV\x01", 1, 5, f) == 5
+                    && put_varint(f, (uint64_t)rivers->count) && put_varint(f, (uint64_t)rivers->vertex_count);
+     for (int r = 0; success && r < rivers->count; r++) {
+         const RiverPolyline* river = &rivers->rivers[r];
+         float length = (float)river->length;
+         uint32_t bits;
+         memcpy(&bits, &length, sizeof(bits));
+         unsigned char le[4] = { bits & 0xFF, (bits >> 8) & 0xFF, (bits >> 16) & 0xFF, bits >> 24 };
+         success = put_varint(f, (uint64_t)river->count) && put_varint(f, (uint64_t)river->cells)
+                   && put_varint(f, (uint64_t)(river->joins + 1)) && put_varint(f, (uint64_t)river->order)
+                   && fwrite(le, 1, 4, f) == 4;
+         int px = 0, py = 0;
+         for (int v = 0; success && v < river->count; v++) {
+             const RiverVertex* vertex = &rivers->vertices[river->first + v];
+             if (v == 0) success = put_varint(f, (uint64_t)vertex->x) && put_varint(f, (uint64_t)vertex->y);
+             else success = put_zigzag(f, vertex->x - px) && put_zigzag(f, vertex->y - py);
+             px = vertex->x;
+             py = vertex->y;
+         }
+     }
+     long bytes = success ? ftell(f) : -1;
+     success = (fclose(f) == 0) && success;
+
+     if (success) {
+         mapgen_log(ctx, MAPGEN_LOG_INFO, "Wrote %d rivers (%d vertices, %ld bytes) to %s.\n",
+                    rivers->count, rivers->vertex_count, bytes, filename);
+         return 0;
+     }
+     else { mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing river file %s.\n", filename); return 1; }
+}
+
+int write_mesh_obj(MapGenContext* ctx, const TerrainMesh* mesh, double height_scale, const char* filename) {
+     if (!mesh || !filename) { return 1; }
+
+     FILE* f = fopen(filename, "w");
+     if (!f) {
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error opening mesh file %s.\n", filename);
+         return 1;
+     }
+     bool success = fprintf(f, "# %d vertices, %d triangles, max error %g\n",
+                            mesh->vertex_count, mesh->triangle_count, mesh->max_error) > 0;
+     for (int v = 0; success && v < mesh->vertex_count; v++) {
+         const float* p = mesh->positions + 3 * (size_t)v;
+         success = fprintf(f, "v %g %g %g\n", p[0], p[2] * height_scale, p[1]) > 0;
+     }
+     for (int t = 0; success && t < mesh->triangle_count; t++) {
+         const uint32_t* i = mesh->indices + 3 * (size_t)t;
+         success = fprintf(f, "f %u %u %u\n", i[0] + 1, i[1] + 1, i[2] + 1) > 0;
+     }
+     success = (fclose(f) == 0) && success;
+
+     if (success) { mapgen_log(ctx, MAPGEN_LOG_INFO, "Wrote %d triangles to %s.\n", mesh->triangle_count, filename); return 0; }
+     else { mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing mesh file %s.\n", filename); return 1; }
+}
+
+static bool put_u32(FILE* f, uint32_t value) {
+     unsigned char le[4] = { value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24 };
+     return fwrite(le, 1, 4, f) == 4;
+}
+
+int write_mesh_binary(MapGenContext* ctx, const TerrainMesh* mesh, const char* filename) {
+     if (!mesh || !filename) { return 1; }
+
+     FILE* f = fopen(filename, "wb");
+     if (!f) {
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error opening mesh file %s.\n", filename);
+         return 1;
+     }
+     bool success = fwrite("MGMS", 1, 4, f) == 4 && put_u32(f, 1)
+                    && put_u32(f, (uint32_t)mesh->vertex_count) && put_u32(f, (uint32_t)mesh->triangle_count);
+     for (size_t k = 0; success && k < 3 * (size_t)mesh->vertex_count; k++) {
+         uint32_t bits;
+         memcpy(&bits, &mesh->positions[k], sizeof(bits));
+         success = put_u32(f, bits);
+     }
+     for (size_t k = 0; success && k < 3 * (size_t)mesh->triangle_count; k++) success = put_u32(f, mesh->indices[k]);
+     long bytes = success ? ftell(f) : -1;
+     success = (fclose(f) == 0) && success;
+
+     if (success) {
+         mapgen_log(ctx, MAPGEN_LOG_INFO, "Wrote %d vertices and %d triangles (%ld bytes) to %s.\n",
+                    mesh->vertex_count, mesh->triangle_count, bytes, filename);
+         return 0;
+     }
+     else { mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing mesh file %s.\n", filename); return 1; }
+}
+
+int write_contour_geojson(MapGenContext* ctx, const ContourSet* contours, const char* filename) {
+     if (!contours || !filename) { return 1; }
+
+     FILE* f = fopen(filename, "w");
+     if (!f) {
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error opening contour file %s.\n", filename);
+         return 1;
+     }
+     bool success = fputs("{\"type\":\"FeatureCollection\",\"features\":[", f) >= 0;
+     for (int l = 0; success && l < contours->count; l++) {
+         const ContourLine* line = &contours->lines[l];
+         success = fprintf(f, "%s\n{\"type\":\"Feature\",\"properties\":{\"level\":%g,\"closed\":%s},"
+                              "\"geometry\":{\"type\":\"LineString\",\"coordinates\":[",
+                           l > 0 ? "," : "", line->level, line->closed ? "true" : "false") > 0;
+         for (int v = 0; success && v <= line->count; v++) {
+             if (v == line->count && !line->closed) break;
+             const ContourVertex* vertex = &contours->vertices[line->first + v % line->count];
+             success = fprintf(f, "%s[%.3f,%.3f]", v > 0 ? "," : "", vertex->x, vertex->y) > 0;
+         }
+         success = success && fputs("]}}", f) >= 0;
+     }
+     success = success && fputs("\n]}\n", f) >= 0;
+     success = (fclose(f) == 0) && success;
+
+     if (success) { mapgen_log(ctx, MAPGEN_LOG_INFO, "Wrote %d contour lines to %s.\n", contours->count, filename); return 0; }
+     else { mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing contour file %s.\n", filename); return 1; }
+}
+
+int write_contour_binary(MapGenContext* ctx, const ContourSet* contours, const char* filename) {
+     if (!contours || !filename) { return 1; }
+
+     FILE* f = fopen(filename, "wb");
+     if (!f) {
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error opening contour file %s.\n", filename);
+         return 1;
+     }
+     bool success = fwrite("MGCT\x01", 1, 5, f) == 5 && put_varint(f, CONTOUR_BINARY_SUBDIVISIONS)
+                    && put_varint(f, (uint64_t)contours->count) && put_varint(f, (uint64_t)contours->vertex_count);
+     for (int l = 0; success && l < contours->count; l++) {
+         const ContourLine* line = &contours->lines[l];
+         float level = (float)line->level;
+         uint32_t bits;
+         memcpy(&bits, &level, sizeof(bits));
+         success = put_varint(f, (uint64_t)line->count * 2 + line->closed) && put_u32(f, bits);
+         long px = 0, py = 0;
+         for (int v = 0; success && v < line->count; v++) {
+             const ContourVertex* vertex = &contours->vertices[line->first + v];
+             long x = lrintf(vertex->x * CONTOUR_BINARY_SUBDIVISIONS);
+             long y = lrintf(vertex->y * CONTOUR_BINARY_SUBDIVISIONS);
+             if (v == 0) success = put_varint(f, (uint64_t)x) && put_varint(f, (uint64_t)y);
+             else success = put_zigzag(f, x - px) && put_zigzag(f, y - py);
+             px = x;
+             py = y;
+         }
+     }
+     long bytes = success ? ftell(f) : -1;
+     success = (fclose(f) == 0) && success;
+
+     if (success) {
+         mapgen_log(ctx, MAPGEN_LOG_INFO, "Wrote %d contour lines (%d vertices, %ld bytes) to %s.\n",
+                    contours->count, contours->vertex_count, bytes, filename);
+         return 0;
+     }
+     else { mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing contour file %s.\n", filename); return 1; }
 }
@@ -0,0 +1,637 @@
+#include "map_pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+
+#include "rng.h"
+#include "map_io.h"
+#include "map_shaping.h"
+#include "hydrology.h"
+#include "distance.h"
+#include "watershed.h"
+#include "rivers.h"
+#include "point_ops.h"
+#include "layer_stats.h"
+#include "stage_graph.h"
+
+#define CONTINENT_LAND_THRESHOLD 0.52 // Increased this value
+#define REDISTRIBUTION_EXPONENT 1.8
+#define OCEAN_DEPTH_TARGET 0.05 // Elevation forced below the continent threshold
+#define APPLY_TERRACING false
+#define NUM_TERRACE_LEVELS 12
+
+
+#define NUM_RIVERS 100
+#define MIN_RIVER_LENGTH 15
+#define MAX_RIVER_LENGTH 500
+#define RIVER_START_ELEV_MIN 0.5
+
+
+#define OCEAN_LEVEL_FOR_LAKES 0.18
+#define RIVER_MOISTURE_RANGE 12.0
+
+
+#define LATITUDE_TEMP_EFFECT_STRENGTH 0.0
+
+#define ENABLE_CONSOLE_OUTPUT false // Set to true to print ANSI map, false to skip
+
+#define DEFAULT_MAP_WIDTH 512
+#define DEFAULT_MAP_HEIGHT 256
+#define DEFAULT_PNG_COMPRESSION_LEVEL 8
+#define DEFAULT_STAGE_LANES 2
+#define DEFAULT_CACHE_MEMORY_MB 64
+#define DEFAULT_CACHE_DISK_MB 1024
+#define STAGE_CACHE_FORMAT "mapgen-stages-4" // Change when a stage's algorithm changes
+
+
+void mapgen_config_default(MapGenConfig* config) {
+    if (!config) return;
+
+    config->width = DEFAULT_MAP_WIDTH;
+    config->height = DEFAULT_MAP_HEIGHT;
+
+    config->elev_params = (NoiseParams){
+        .octaves = 6, .persistence = 0.5, .lacunarity = 2.0,
+        .base_frequency = 0.02, .use_ridged = false
+    };
+    config->moist_params = (NoiseParams){
+        .octaves = 4, .persistence = 0.45, .lacunarity = 2.1,
+        .base_frequency = 0.06, .use_ridged = false
+    };
+    config->cont_params = (NoiseParams){
+        .octaves = 2, .persistence = 0.5, .lacunarity = 2.0,
+        .base_frequency = 0.008, .use_ridged = false
+    };
+
+    config->continent_land_threshold = CONTINENT_LAND_THRESHOLD;
+    config->target_land_fraction = 0.0;
+    config->redistribution_exponent = REDISTRIBUTION_EXPONENT;
+    config->redistribution_max_error = 0.0;
+    config->apply_terracing = APPLY_TERRACING;
+    config->num_terrace_levels = NUM_TERRACE_LEVELS;
+
+    erosion_params_default(&config->erosion);
+    thermal_params_default(&config->thermal);
+
+    config->num_rivers = NUM_RIVERS;
+    config->min_river_length = MIN_RIVER_LENGTH;
+    config->max_river_length = MAX_RIVER_LENGTH;
+    config->river_start_elev_min = RIVER_START_ELEV_MIN;
+
+    config->ocean_level_for_lakes = OCEAN_LEVEL_FOR_LAKES;
+    config->shelf_width = 0.0;
+    config->river_moisture = 0.0;
+    config->river_moisture_range = RIVER_MOISTURE_RANGE;
+    wind_params_default(&config->wind);
+    config->latitude_temp_effect_strength = LATITUDE_TEMP_EFFECT_STRENGTH;
+    config->compute_basins = false;
+
+    config->enable_console_output = ENABLE_CONSOLE_OUTPUT;
+    config->png_compression_level = DEFAULT_PNG_COMPRESSION_LEVEL;
+
+    config->num_threads = 0;
+    config->pin_threads = false;
+    config->stage_lanes = DEFAULT_STAGE_LANES;
+    config->cache_memory_mb = DEFAULT_CACHE_MEMORY_MB;
+    config->cache_dir = NULL;
+    config->cache_disk_mb = DEFAULT_CACHE_DISK_MB;
+    config->page_mode = PAGE_MODE_DEFAULT;
+}
+
+
+// Each noise layer gets an independent seed that depends only on the map seed.
+int mapgen_noise_seed(unsigned int seed, MapNoiseLayer layer) {
+    return (int)(rng_hash(seed, RNG_STAGE_NOISE_SEEDS, (uint64_t)layer) & 0x7FFFFFFFu);
+}
+
+void init_map_workspace(MapGenWorkspace* ws) {
+    if (!ws) return;
+    arena_init(&ws->arena, ARENA_DEFAULT_BLOCK_SIZE);
+    ws->map = NULL;
+    ws->continent_map = NULL;
+    ws->pixels = NULL;
+    ws->noise_elev = NULL;
+    ws->noise_moist = NULL;
+    ws->noise_cont = NULL;
+    ws->cache = NULL;
+}
+
+void cleanup_map_workspace(MapGenContext* ctx, MapGenWorkspace* ws) {
+    if (!ws) return;
+    cleanup_noise_generator(ctx, ws->noise_elev);
+    cleanup_noise_generator(ctx, ws->noise_moist);
+    cleanup_noise_generator(ctx, ws->noise_cont);
+    stage_cache_destroy(ws->cache);
+    arena_destroy(&ws->arena);
+    init_map_workspace(ws);
+}
+
+// Starts a new session: drops the previous map in one arena_reset and carves
+// the new layers out of the retained blocks. Returns false on allocation failure.
+static bool prepare_workspace(MapGenContext* ctx, MapGenWorkspace* ws, const MapGenConfig* config) {
+    arena_reset(&ws->arena);
+    arena_set_page_mode(&ws->arena, config->page_mode);
+    ws->pixels = NULL;
+    ws->map = create_map(ctx, config->width, config->height);
+    ws->continent_map = create_layer(ctx, config->width, config->height);
+    if (!ws->map || !ws->continent_map) return false;
+    if (config->elev_params.wrap == NOISE_WRAP_CUBE_FACE) ws->map->cube_face = config->elev_params.cube_face;
+
+    if (!ws->noise_elev) ws->noise_elev = init_noise_generator(ctx, 0);
+    if (!ws->noise_moist) ws->noise_moist = init_noise_generator(ctx, 0);
+    if (!ws->noise_cont) ws->noise_cont = init_noise_generator(ctx, 0);
+    return ws->noise_elev && ws->noise_moist && ws->noise_cont;
+}
+
+
+// --- Stage Keys ---
+
+static uint64_t stage_key(const char* name) {
+    return stage_hash_string(stage_hash_string(0, STAGE_CACHE_FORMAT), name);
+}
+
+static uint64_t hash_noise_params(uint64_t key, const NoiseParams* params, int seed) {
+    key = stage_hash_u64(key, (uint64_t)seed);
+    key = stage_hash_u64(key, (uint64_t)params->octaves);
+    key = stage_hash_double(key, params->persistence);
+    key = stage_hash_double(key, params->lacunarity);
+    key = stage_hash_double(key, params->base_frequency);
+    key = stage_hash_u64(key, params->use_ridged);
+    key = stage_hash_u64(key, (uint64_t)params->wrap);
+    if (params->wrap == NOISE_WRAP_CUBE_FACE) key = stage_hash_u64(key, (uint64_t)params->cube_face);
+    return stage_hash_double(key, params->max_interp_error);
+}
+
+// Continent mask, clamp, redistribution and optional terraces as one chain.
+void mapgen_shaping_chain(const MapGenConfig* config, double** continent_map, double land_threshold,
+                          PointChain* chain) {
+    point_chain_init(chain);
+    point_chain_mask_below(chain, continent_map, land_threshold, OCEAN_DEPTH_TARGET);
+    point_chain_clamp(chain, 0.0, 1.0);
+    point_chain_pow(chain, config->redistribution_exponent, config->redistribution_max_error);
+    if (config->apply_terracing) {
+        point_chain_terrace(chain, config->num_terrace_levels < 2 ? 2 : config->num_terrace_levels);
+    }
+}
+
+// Continent threshold that leaves target_land_fraction of the cells as land
+// (elevation >= ocean_level_for_lakes after shaping). Shaping is monotone, so a
+// cell ends up as land iff its raw elevation is at least some e0 and its
+// continent value is not masked; the threshold is therefore an order statistic
+// of the continent values of the cells with elevation >= e0.
+static double land_fraction_threshold(MapGenContext* ctx, MapGenWorkspace* ws, const MapGenConfig* config) {
+    MapData* map = ws->map;
+    PointChain shaping;
+    mapgen_shaping_chain(config, ws->continent_map, 0.0, &shaping);
+    // Bisect through the same pow kernel (table or exact) the shaping applies
+    PointChainTables tables;
+    point_chain_build_tables(ctx, &shaping, &tables);
+
+    double level = config->ocean_level_for_lakes;
+    if (point_chain_eval(&shaping, &tables, 1.0) < level) {
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: No elevation can reach the land level %.2f.\n", level);
+        point_chain_free_tables(ctx, &tables);
+        return config->continent_land_threshold;
+    }
+    double e0 = -DBL_MAX;
+    if (point_chain_eval(&shaping, &tables, 0.0) < level) {
+        double lo = 0.0, hi = 1.0;
+        for (int i = 0; i < 60; i++) {
+            double mid = 0.5 * (lo + hi);
+            if (point_chain_eval(&shaping, &tables, mid) >= level) hi = mid;
+            else lo = mid;
+        }
+        e0 = hi;
+    }
+    point_chain_free_tables(ctx, &tables);
+
+    long long cells = (long long)map->width * map->height;
+    long long wanted = llround(config->target_land_fraction * cells);
+    long long candidates = 0;
+    double threshold = DBL_MAX;     // wanted == 0: mask everything
+    if (wanted > 0) {
+        // Land = candidates with continent >= threshold, i.e. the top 'wanted'
+        candidates = layer_count_at_least(ctx, map->elevation, map->width, map->height, e0);
+        if (wanted < candidates) {
+            layer_select_kth(ctx, ws->continent_map, map->elevation, e0, map->width, map->height,
+                             candidates - wanted, &threshold, NULL);
+        } else if (candidates > 0) {
+            // Every candidate becomes land: the threshold is the lowest of them
+            layer_select_kth(ctx, ws->continent_map, map->elevation, e0, map->width, map->height,
+                             0, &threshold, NULL);
+            mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Only %.2f%% of the cells can become land.\n",
+                       100.0 * candidates / cells);
+        } else {
+            mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: No cells can become land.\n");
+        }
+    }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Continent threshold %.4f (raw elevation >= %.4f reaches land)\n",
+               threshold, e0 < 0.0 ? 0.0 : e0);
+    return threshold;
+}
+
+// --- Stages ---
+// Each stage reads the shared state from a PipelineRun and may run on a
+// helper lane of the stage graph, so it must use the ctx it is given (which
+// may have no arena and a single band) rather than the caller's.
+
+typedef struct {
+    MapGenWorkspace* ws;
+    const MapGenConfig* config;
+    const char* png_filename;
+    unsigned char* pixels;          // width * height RGB, NULL without PNG
+} PipelineRun;
+
+static int stage_all_noise(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    MapData* map = run->ws->map;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Generating Elevation, Moisture and Continent Noise Maps...\n");
+    const NoiseChannel channels[] = {
+        { run->ws->noise_elev, map->elevation, &run->config->elev_params },
+        { run->ws->noise_moist, map->moisture, &run->config->moist_params },
+        { run->ws->noise_cont, run->ws->continent_map, &run->config->cont_params },
+    };
+    generate_octave_noise_fused(ctx, map->width, map->height, channels, 3);
+    return 0;
+}
+
+static int stage_terrain_noise(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    MapData* map = run->ws->map;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Generating Elevation and Continent Noise Maps...\n");
+    const NoiseChannel channels[] = {
+        { run->ws->noise_elev, map->elevation, &run->config->elev_params },
+        { run->ws->noise_cont, run->ws->continent_map, &run->config->cont_params },
+    };
+    generate_octave_noise_fused(ctx, map->width, map->height, channels, 2);
+    return 0;
+}
+
+static int stage_moisture_noise(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    MapData* map = run->ws->map;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Generating Moisture Map...\n");
+    generate_octave_noise_to_layer(ctx, run->ws->noise_moist, map->width, map->height, map->moisture,
+                                   &run->config->moist_params);
+    return 0;
+}
+
+static int stage_shaping(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    MapGenWorkspace* ws = run->ws;
+    const MapGenConfig* config = run->config;
+    MapData* map = ws->map;
+
+    double land_threshold = config->continent_land_threshold;
+    if (config->target_land_fraction > 0.0) {
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "Targeting Land Fraction %.1f%%...\n", 100.0 * config->target_land_fraction);
+        land_threshold = land_fraction_threshold(ctx, ws, config);
+    }
+
+    if (config->redistribution_exponent <= 0) {
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Using non-positive exponent (%.2f) in redistribution might lead to unexpected results. Applying anyway.\n",
+                   config->redistribution_exponent);
+    }
+
+    // Continent mask, redistribution and terraces are all per-cell, so they
+    // run as one point-op chain in a single pass over the elevation layer.
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Shaping Elevation (continent mask, redistribution%s)...\n",
+               config->apply_terracing ? ", terraces" : "");
+    PointChain shaping;
+    mapgen_shaping_chain(config, ws->continent_map, land_threshold, &shaping);
+    point_chain_apply(ctx, &shaping, map->elevation, map->width, map->height);
+    if (config->target_land_fraction > 0.0) {
+        long long land = layer_count_at_least(ctx, map->elevation, map->width, map->height,
+                                              config->ocean_level_for_lakes);
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Land coverage %.2f%% (target %.2f%%)\n",
+                   100.0 * land / ((double)map->width * map->height), 100.0 * config->target_land_fraction);
+    }
+    return 0;
+}
+
+static int stage_erosion(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Eroding Terrain (%lld droplets)...\n", run->config->erosion.droplets);
+    hydraulic_erosion(ctx, run->ws->map, &run->config->erosion);
+    return 0;
+}
+
+static int stage_thermal(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Relaxing Slopes (%d iterations)...\n", run->config->thermal.iterations);
+    thermal_erosion(ctx, run->ws->map, &run->config->thermal);
+    return 0;
+}
+
+static int stage_lakes(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Filling Lakes...\n");
+    fill_lakes(ctx, run->ws->map, run->config->ocean_level_for_lakes);
+    return 0;
+}
+
+static int stage_rivers(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    const MapGenConfig* config = run->config;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Generating Rivers...\n");
+    generate_rivers(ctx, run->ws->map, config->num_rivers, config->min_river_length, config->max_river_length,
+                    config->river_start_elev_min);
+    return 0;
+}
+
+static int stage_climate(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Advecting Moisture Along the Wind...\n");
+    advect_moisture(ctx, run->ws->map, run->config->ocean_level_for_lakes, &run->config->wind);
+    return 0;
+}
+
+static int stage_distances(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    const MapGenConfig* config = run->config;
+    MapData* map = run->ws->map;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Computing Coast and River Distances...\n");
+    if (!map_compute_distances(ctx, map, config->ocean_level_for_lakes)) return 1;
+    if (config->shelf_width > 0.0) apply_bathymetry(ctx, map, config->ocean_level_for_lakes, config->shelf_width);
+    if (config->river_moisture > 0.0) {
+        apply_river_moisture(ctx, map, config->river_moisture, config->river_moisture_range);
+    }
+    return 0;
+}
+
+static int stage_basins(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Labeling Drainage Basins...\n");
+    return map_compute_basins(ctx, run->ws->map, run->config->ocean_level_for_lakes) ? 0 : 1;
+}
+
+static int stage_temperature(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Computing Temperature...\n");
+    return map_compute_temperature(ctx, run->ws->map, run->config->latitude_temp_effect_strength) ? 0 : 1;
+}
+
+static int stage_console(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Printing text map to console...\n");
+    print_map_text(run->ws->map);
+    return 0;
+}
+
+static void render_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    PipelineRun* run = user_data;
+    render_map_rows(run->ws->map, run->pixels, begin, end);
+}
+
+static int stage_render(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Rendering map image...\n");
+    mapgen_parallel_bands(ctx, run->ws->map->height, render_band, run);
+    return 0;
+}
+
+static int stage_png(MapGenContext* ctx, void* user_data) {
+    PipelineRun* run = user_data;
+    MapData* map = run->ws->map;
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Writing map to PNG image file...\n");
+    if (write_rgb_png(ctx, run->pixels, map->width, map->height, run->png_filename) != 0) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error writing PNG file.\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// The pipeline proper; runs with the workspace arena installed on ctx.
+static int run_stages(MapGenContext* ctx, MapGenWorkspace* ws, const MapGenConfig* config,
+                      unsigned int seed, const char* png_filename)
+{
+    if (!prepare_workspace(ctx, ws, config)) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Initialization or temp map allocation failed.\n");
+        return 1;
+    }
+
+    mapgen_context_seed(ctx, seed);
+    int seed1 = mapgen_noise_seed(seed, MAP_NOISE_ELEVATION);
+    int seed2 = mapgen_noise_seed(seed, MAP_NOISE_MOISTURE);
+    int seed3 = mapgen_noise_seed(seed, MAP_NOISE_CONTINENT);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Map seed %u -> Elev=%d, Moist=%d, Cont=%d\n", seed, seed1, seed2, seed3);
+
+    reseed_noise_generator(ws->noise_elev, seed1);
+    reseed_noise_generator(ws->noise_moist, seed2);
+    reseed_noise_generator(ws->noise_cont, seed3);
+
+    PipelineRun run = { ws, config, png_filename, NULL };
+    if (png_filename) {
+        run.pixels = scratch_alloc(&ws->arena, (size_t)ws->map->width * ws->map->height * 3);
+        if (!run.pixels) {
+            mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate PNG pixels.\n");
+            return 1;
+        }
+    }
+    ws->pixels = run.pixels;
+
+    // Declared in sequential order; the graph only reorders stages whose
+    // layers don't overlap. With one lane, all three noise layers share one
+    // traversal; with more, moisture (only needed for rendering) gets its own
+    // stage so it overlaps with the elevation chain. Every stage that fills
+    // layers is keyed by the parameters it reads, for the stage cache.
+    MapData* map = ws->map;
+    int lanes = config->stage_lanes;
+    int index;
+    uint64_t key;
+    StageGraph graph;
+    stage_graph_init(&graph);
+    if (lanes > 1) {
+        index = stage_graph_add(&graph, "terrain noise", 0, STAGE_LAYER_ELEVATION | STAGE_LAYER_CONTINENT,
+                                STAGE_USES_POOL, stage_terrain_noise, &run);
+        key = hash_noise_params(stage_key("terrain noise"), &config->elev_params, seed1);
+        stage_graph_set_key(&graph, index, hash_noise_params(key, &config->cont_params, seed3));
+        index = stage_graph_add(&graph, "moisture noise", 0, STAGE_LAYER_MOISTURE, 0, stage_moisture_noise, &run);
+        stage_graph_set_key(&graph, index, hash_noise_params(stage_key("moisture noise"), &config->moist_params, seed2));
+    } else {
+        index = stage_graph_add(&graph, "noise", 0, STAGE_LAYER_ELEVATION | STAGE_LAYER_MOISTURE | STAGE_LAYER_CONTINENT,
+                                STAGE_USES_POOL, stage_all_noise, &run);
+        key = hash_noise_params(stage_key("noise"), &config->elev_params, seed1);
+        key = hash_noise_params(key, &config->moist_params, seed2);
+        stage_graph_set_key(&graph, index, hash_noise_params(key, &config->cont_params, seed3));
+    }
+
+    index = stage_graph_add(&graph, "shaping", STAGE_LAYER_ELEVATION | STAGE_LAYER_CONTINENT, STAGE_LAYER_ELEVATION,
+                            STAGE_USES_POOL, stage_shaping, &run);
+    key = stage_hash_double(stage_key("shaping"), config->continent_land_threshold);
+    key = stage_hash_double(key, config->target_land_fraction);
+    key = stage_hash_double(key, config->ocean_level_for_lakes);
+    key = stage_hash_double(key, config->redistribution_exponent);
+    key = stage_hash_double(key, config->redistribution_max_error);
+    key = stage_hash_u64(key, config->apply_terracing ? (uint64_t)config->num_terrace_levels : 0);
+    stage_graph_set_key(&graph, index, key);
+
+    if (config->erosion.droplets > 0) {
+        const ErosionParams* erosion = &config->erosion;
+        index = stage_graph_add(&graph, "erosion", STAGE_LAYER_ELEVATION, STAGE_LAYER_ELEVATION,
+                                STAGE_USES_POOL, stage_erosion, &run);
+        key = stage_hash_u64(stage_key("erosion"), seed);
+        key = stage_hash_u64(key, (uint64_t)erosion->droplets);
+        key = stage_hash_u64(key, (uint64_t)erosion->max_lifetime);
+        key = stage_hash_u64(key, (uint64_t)erosion->radius);
+        key = stage_hash_u64(key, (uint64_t)erosion->tile_size);
+        key = stage_hash_u64(key, (uint64_t)erosion->rounds);
+        key = stage_hash_double(key, erosion->inertia);
+        key = stage_hash_double(key, erosion->sediment_capacity);
+        key = stage_hash_double(key, erosion->min_capacity);
+        key = stage_hash_double(key, erosion->deposit_rate);
+        key = stage_hash_double(key, erosion->erode_rate);
+        key = stage_hash_double(key, erosion->evaporate_rate);
+        key = stage_hash_double(key, erosion->gravity);
+        key = stage_hash_double(key, erosion->initial_water);
+        stage_graph_set_key(&graph, index, stage_hash_double(key, erosion->initial_speed));
+    }
+    if (config->thermal.iterations > 0) {
+        index = stage_graph_add(&graph, "thermal", STAGE_LAYER_ELEVATION, STAGE_LAYER_ELEVATION,
+                                STAGE_USES_POOL, stage_thermal, &run);
+        key = stage_hash_u64(stage_key("thermal"), (uint64_t)config->thermal.iterations);
+        key = stage_hash_double(key, config->thermal.talus);
+        stage_graph_set_key(&graph, index, stage_hash_double(key, config->thermal.rate));
+    }
+
+    map->component = create_label_layer(ctx, map->width, map->height);
+    if (!map->component) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate the component label layer.\n");
+        return 1;
+    }
+    index = stage_graph_add(&graph, "lakes", STAGE_LAYER_ELEVATION, STAGE_LAYER_ELEVATION | STAGE_LAYER_COMPONENTS,
+                            STAGE_USES_POOL, stage_lakes, &run);
+    stage_graph_set_key(&graph, index, stage_hash_double(stage_key("lakes"), config->ocean_level_for_lakes));
+
+    // Path slots reserved up front so they can be bound for the cache
+    if (config->max_river_length > 0 &&
+        !map_reserve_river_paths(ctx, map, config->num_rivers, config->max_river_length)) {
+        return 1;
+    }
+    map->river_min_length = config->min_river_length;   // Set here too when the stage is cached
+    index = stage_graph_add(&graph, "rivers", STAGE_LAYER_ELEVATION,
+                            STAGE_LAYER_ELEVATION | STAGE_LAYER_RIVERS | STAGE_LAYER_RIVER_PATHS,
+                            0, stage_rivers, &run);
+    key = stage_hash_u64(stage_key("rivers"), seed);
+    key = stage_hash_u64(key, (uint64_t)config->num_rivers);
+    key = stage_hash_u64(key, (uint64_t)config->min_river_length);
+    key = stage_hash_u64(key, (uint64_t)config->max_river_length);
+    stage_graph_set_key(&graph, index, stage_hash_double(key, config->river_start_elev_min));
+
+    if (config->wind.strength > 0.0) {
+        const WindParams* wind = &config->wind;
+        index = stage_graph_add(&graph, "climate", STAGE_LAYER_ELEVATION | STAGE_LAYER_MOISTURE | STAGE_LAYER_COMPONENTS,
+                                STAGE_LAYER_MOISTURE, STAGE_USES_POOL, stage_climate, &run);
+        key = stage_hash_double(stage_key("climate"), config->ocean_level_for_lakes);
+        key = stage_hash_double(key, wind->strength);
+        key = stage_hash_u64(key, (uint64_t)wind->direction);
+        key = stage_hash_double(key, wind->inflow);
+        key = stage_hash_double(key, wind->evaporation);
+        key = stage_hash_double(key, wind->base_rain);
+        key = stage_hash_double(key, wind->orographic);
+        stage_graph_set_key(&graph, index, stage_hash_double(key, wind->recycling));
+    }
+
+    // Distance layers (allocated up front so they can be bound for the cache)
+    // only when something consumes them.
+    if (config->shelf_width > 0.0 || config->river_moisture > 0.0) {
+        map->coast_distance = create_layer(ctx, map->width, map->height);
+        map->river_distance = create_layer(ctx, map->width, map->height);
+        index = stage_graph_add(&graph, "distances", STAGE_LAYER_ELEVATION | STAGE_LAYER_MOISTURE | STAGE_LAYER_RIVERS,
+                                STAGE_LAYER_ELEVATION | STAGE_LAYER_MOISTURE | STAGE_LAYER_COAST_DISTANCE
+                                | STAGE_LAYER_RIVER_DISTANCE, STAGE_USES_POOL, stage_distances, &run);
+        key = stage_hash_double(stage_key("distances"), config->ocean_level_for_lakes);
+        key = stage_hash_double(key, config->shelf_width);
+        key = stage_hash_double(key, config->river_moisture);
+        stage_graph_set_key(&graph, index, stage_hash_double(key, config->river_moisture_range));
+    }
+
+    if (config->compute_basins) {
+        map->basin = create_label_layer(ctx, map->width, map->height);
+        if (!map->basin) {
+            mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate the drainage basin layer.\n");
+            return 1;
+        }
+        index = stage_graph_add(&graph, "basins", STAGE_LAYER_ELEVATION | STAGE_LAYER_COMPONENTS, STAGE_LAYER_BASINS,
+                                STAGE_USES_POOL, stage_basins, &run);
+        stage_graph_set_key(&graph, index, stage_hash_double(stage_key("basins"), config->ocean_level_for_lakes));
+    }
+
+    // Temperature once the elevation is final; every renderer reads it
+    map->temperature = create_layer(ctx, map->width, map->height);
+    if (!map->temperature) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate the temperature layer.\n");
+        return 1;
+    }
+    index = stage_graph_add(&graph, "temperature", STAGE_LAYER_ELEVATION, STAGE_LAYER_TEMPERATURE, STAGE_USES_POOL,
+                            stage_temperature, &run);
+    stage_graph_set_key(&graph, index, stage_hash_u64(stage_hash_double(stage_key("temperature"),
+                                                                        config->latitude_temp_effect_strength),
+                                                      (uint64_t)(map->cube_face + 1)));
+
+    const unsigned final_layers = STAGE_LAYER_ELEVATION | STAGE_LAYER_MOISTURE | STAGE_LAYER_RIVERS
+                                | STAGE_LAYER_TEMPERATURE;
+    if (config->enable_console_output) {
+        stage_graph_add(&graph, "console", final_layers, STAGE_LAYER_OUTPUT, 0, stage_console, &run);
+    }
+    if (png_filename) {
+        // One barrier: rows are rendered only once every final layer is complete
+        index = stage_graph_add(&graph, "render", final_layers, STAGE_LAYER_IMAGE, STAGE_USES_POOL, stage_render, &run);
+        stage_graph_set_key(&graph, index, stage_key("render"));
+        stage_graph_add(&graph, "png", STAGE_LAYER_IMAGE, STAGE_LAYER_OUTPUT, 0, stage_png, &run);
+    }
+
+    size_t cells = (size_t)map->width * map->height;
+    if (config->cache_memory_mb > 0 || config->cache_dir) {
+        if (!ws->cache) ws->cache = stage_cache_create();
+        stage_cache_configure(ws->cache, (size_t)config->cache_memory_mb << 20, config->cache_dir,
+                              (size_t)(config->cache_disk_mb > 0 ? config->cache_disk_mb : 0) << 20);
+        uint64_t base = stage_hash_u64(stage_hash_u64(stage_key("map"), (uint64_t)map->width), (uint64_t)map->height);
+        stage_graph_set_cache(&graph, ws->cache, base);
+        stage_graph_bind_layer(&graph, STAGE_LAYER_ELEVATION, map->elevation[0], cells * sizeof(double));
+        stage_graph_bind_layer(&graph, STAGE_LAYER_MOISTURE, map->moisture[0], cells * sizeof(double));
+        stage_graph_bind_layer(&graph, STAGE_LAYER_CONTINENT, ws->continent_map[0], cells * sizeof(double));
+        stage_graph_bind_layer(&graph, STAGE_LAYER_RIVERS, map->is_river[0], cells * sizeof(bool));
+        if (run.pixels) stage_graph_bind_layer(&graph, STAGE_LAYER_IMAGE, run.pixels, cells * 3);
+        stage_graph_bind_layer(&graph, STAGE_LAYER_COMPONENTS, map->component[0], cells * sizeof(int32_t));
+        if (map->basin) stage_graph_bind_layer(&graph, STAGE_LAYER_BASINS, map->basin[0], cells * sizeof(int32_t));
+        stage_graph_bind_layer(&graph, STAGE_LAYER_TEMPERATURE, map->temperature[0], cells * sizeof(double));
+        size_t river_slots = (size_t)map->river_path_count * map->river_path_stride;
+        if (river_slots > 0) {
+            stage_graph_bind_layer(&graph, STAGE_LAYER_RIVER_PATHS, map->river_paths, river_slots * sizeof(int32_t));
+        }
+        if (map->coast_distance) {
+            stage_graph_bind_layer(&graph, STAGE_LAYER_COAST_DISTANCE, map->coast_distance[0], cells * sizeof(double));
+        }
+        if (map->river_distance) {
+            stage_graph_bind_layer(&graph, STAGE_LAYER_RIVER_DISTANCE, map->river_distance[0], cells * sizeof(double));
+        }
+    }
+
+    return stage_graph_run(ctx, &graph, lanes);
+}
+
+
+int generate_map(MapGenContext* ctx, MapGenWorkspace* ws,
+                 unsigned int seed, const char* png_filename)
+{
+    const MapGenConfig* config = mapgen_context_config(ctx);
+    if (!ws || !config) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Cannot generate map without workspace and context.\n");
+        return 1;
+    }
+
+    Arena* previous_arena = mapgen_context_arena(ctx);
+    mapgen_context_set_arena(ctx, &ws->arena);
+    int result = run_stages(ctx, ws, config, seed, png_filename);
+    mapgen_context_set_arena(ctx, previous_arena);
+
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Session arena: %.1f MiB reserved, %.1f MiB peak\n",
+               ws->arena.reserved / (1024.0 * 1024.0), ws->arena.peak_used / (1024.0 * 1024.0));
+    return result;
+}
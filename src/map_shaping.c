@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <float.h>
 
+#include "point_ops.h"
+
 static inline double lerp(double a, double b, double t) {
     return a * (1.0 - t) + b * t;
 }
@@ -14,76 +16,103 @@ static inline double clamp(double value, double min_val, double max_val) {
 }
 
 // --- New Implementation: Apply Continent Mask ---
-void apply_continent_mask(MapData* map, double** continent_map, int width, int height, double land_threshold) {
+void apply_continent_mask(MapGenContext* ctx, MapData* map, double** continent_map, int width, int height, double land_threshold) {
     if (!map || !map->elevation || !continent_map) {
-        fprintf(stderr, "Error: Cannot apply continent mask with NULL inputs.\n");
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Cannot apply continent mask with NULL inputs.\n");
         return;
     }
     if (width <= 0 || height <= 0) {
-         fprintf(stderr, "Error: Invalid dimensions for continent mask.\n");
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Invalid dimensions for continent mask.\n");
          return;
     }
 
-    printf("Applying continent mask (land threshold = %.2f)...\n", land_threshold);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Applying continent mask (land threshold = %.2f)...\n", land_threshold);
 
     // Define how deep the ocean should be forced
     const double ocean_depth_target = 0.05; // Force below beach level
 
-    for (int y = 0; y < height; y++) {
-        // Check row validity (optional but safer)
-        if (!map->elevation[y] || !continent_map[y]) {
-             fprintf(stderr, "Error: Row %d is NULL in elevation or continent map.\n", y);
-             continue;
-        }
-        for (int x = 0; x < width; x++) {
-            double continent_val = continent_map[y][x];
-            double current_elev = map->elevation[y][x];
-
-            // If continent mask value is below threshold, force elevation down
-            if (continent_val < land_threshold) {
-                // Option 1: Force to a specific depth
-                map->elevation[y][x] = ocean_depth_target;
-
-                // Option 2: Blend towards depth based on how far below threshold
-                // double blend_factor = 1.0 - (continent_val / land_threshold); // 0 at threshold, 1 at 0
-                // map->elevation[y][x] = lerp(current_elev, ocean_depth_target, blend_factor * blend_factor); // Stronger blend further out
-            } else {
-                // Option 3: On land, maybe slightly boost elevation? Optional.
-                // map->elevation[y][x] = current_elev * 1.05; // Example boost
-            }
-
-            // Ensure final elevation is clamped (important if boosting/blending)
-            map->elevation[y][x] = clamp(map->elevation[y][x], 0.0, 1.0);
-        }
-    }
+    // Below the threshold the elevation is forced to the ocean depth, then
+    // everything is clamped to [0, 1]
+    PointChain chain;
+    point_chain_init(&chain);
+    point_chain_mask_below(&chain, continent_map, land_threshold, ocean_depth_target);
+    point_chain_clamp(&chain, 0.0, 1.0);
+    point_chain_apply(ctx, &chain, map->elevation, width, height);
 
-    printf("Continent mask application complete.\n");
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Continent mask application complete.\n");
 }
 
 
-void apply_terraces(MapData* map, int num_levels) {
+void apply_terraces(MapGenContext* ctx, MapData* map, int num_levels) {
     if (!map || !map->elevation) {
-        fprintf(stderr, "Error: Cannot apply terraces to NULL map.\n");
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Cannot apply terraces to NULL map.\n");
         return;
     }
     if (num_levels < 2) {
-        fprintf(stderr, "Warning: Terracing with less than 2 levels requested (%d). Setting to 2.\n", num_levels);
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Terracing with less than 2 levels requested (%d). Setting to 2.\n", num_levels);
         num_levels = 2;
     }
 
-    printf("Applying terracing with %d levels...\n", num_levels);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Applying terracing with %d levels...\n", num_levels);
+
+    PointChain chain;
+    point_chain_init(&chain);
+    point_chain_terrace(&chain, num_levels);
+    point_chain_apply(ctx, &chain, map->elevation, map->width, map->height);
+
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Terracing complete.\n");
+}
 
-    double levels_minus_one = (double)(num_levels - 1);
 
-    for (int y = 0; y < map->height; y++) {
-        for (int x = 0; x < map->width; x++) {
-            double e = map->elevation[y][x];
-            double scaled_e = e * levels_minus_one;
-            double rounded_level = round(scaled_e);
-            double terraced_e = rounded_level / levels_minus_one;
-            map->elevation[y][x] = clamp(terraced_e, 0.0, 1.0);
-        }
+// --- Distance-Based Shaping ---
+
+typedef struct {
+    MapData* map;
+    double amount;              // Water level, or moisture added at the river
+    double distance;            // Shelf width, or moisture range
+} DistanceShapeJob;
+
+static void bathymetry_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    DistanceShapeJob* job = user_data;
+    size_t stride = (size_t)job->map->width;
+    double* elevation = job->map->elevation[0];
+    const double* coast = job->map->coast_distance[0];
+    for (size_t i = (size_t)begin * stride; i < (size_t)end * stride; i++) {
+        if (coast[i] >= 0.0) continue;     // Land
+        double shelf = job->amount * (1.0 - clamp(-coast[i] / job->distance, 0.0, 1.0));
+        if (elevation[i] < shelf) elevation[i] = shelf;
     }
+}
 
-    printf("Terracing complete.\n");
+void apply_bathymetry(MapGenContext* ctx, MapData* map, double water_level, double shelf_width) {
+    if (!map || !map->elevation || !map->coast_distance || shelf_width <= 0.0) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Bathymetry needs the coast distance layer and a positive shelf width.\n");
+        return;
+    }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Shaping ocean floor (shelf width %.1f cells)...\n", shelf_width);
+    DistanceShapeJob job = { map, water_level, shelf_width };
+    mapgen_parallel_bands(ctx, map->height, bathymetry_band, &job);
+}
+
+static void river_moisture_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    DistanceShapeJob* job = user_data;
+    size_t stride = (size_t)job->map->width;
+    double* moisture = job->map->moisture[0];
+    const double* river = job->map->river_distance[0];
+    for (size_t i = (size_t)begin * stride; i < (size_t)end * stride; i++) {
+        double falloff = 1.0 - river[i] / job->distance;
+        if (falloff > 0.0) moisture[i] = clamp(moisture[i] + job->amount * falloff, 0.0, 1.0);
+    }
+}
+
+void apply_river_moisture(MapGenContext* ctx, MapData* map, double strength, double range) {
+    if (!map || !map->moisture || !map->river_distance || range <= 0.0) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: River moisture needs the river distance layer and a positive range.\n");
+        return;
+    }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Adding river moisture (%.2f within %.1f cells)...\n", strength, range);
+    DistanceShapeJob job = { map, strength, range };
+    mapgen_parallel_bands(ctx, map->height, river_moisture_band, &job);
 }
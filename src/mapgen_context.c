@@ -0,0 +1,134 @@
+#include "mapgen_context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+#include "map_pipeline.h"
+
+#define LOG_MESSAGE_MAX 512
+
+struct MapGenContext {
+    MapGenLogFn log_fn;
+    void* log_user_data;
+    MapGenLogLevel log_level;
+    uint64_t seed;
+    Arena* arena;
+    ThreadPool* pool;
+    int pool_requested_threads;  // config->num_threads the pool was built for
+    bool pool_pinned;
+    MapGenConfig config;
+};
+
+MapGenContext* mapgen_context_create(void) {
+    MapGenContext* ctx = malloc(sizeof(MapGenContext));
+    if (!ctx) {
+        perror("Error allocating MapGenContext");
+        return NULL;
+    }
+    ctx->log_fn = mapgen_log_stdio;
+    ctx->log_user_data = NULL;
+    ctx->log_level = MAPGEN_LOG_INFO;
+    mapgen_context_seed(ctx, 1);
+    ctx->arena = NULL;
+    ctx->pool = NULL;
+    ctx->pool_requested_threads = 0;
+    ctx->pool_pinned = false;
+    mapgen_config_default(&ctx->config);
+    return ctx;
+}
+
+MapGenContext* mapgen_context_clone(const MapGenContext* ctx) {
+    if (!ctx) return NULL;
+    MapGenContext* copy = mapgen_context_create();
+    if (!copy) return NULL;
+    copy->log_fn = ctx->log_fn;
+    copy->log_user_data = ctx->log_user_data;
+    copy->log_level = ctx->log_level;
+    copy->config = ctx->config;
+    copy->seed = ctx->seed;
+    return copy;
+}
+
+void mapgen_context_destroy(MapGenContext* ctx) {
+    if (!ctx) return;
+    thread_pool_destroy(ctx->pool);
+    free(ctx);
+}
+
+void mapgen_context_set_log_sink(MapGenContext* ctx, MapGenLogFn log_fn,
+                                 void* user_data, MapGenLogLevel min_level) {
+    if (!ctx) return;
+    ctx->log_fn = log_fn;
+    ctx->log_user_data = user_data;
+    ctx->log_level = min_level;
+}
+
+MapGenConfig* mapgen_context_config(MapGenContext* ctx) {
+    return ctx ? &ctx->config : NULL;
+}
+
+void mapgen_log_stdio(void* user_data, MapGenLogLevel level, const char* message) {
+    (void)user_data;
+    // One fputs per message keeps lines from different threads intact
+    fputs(message, level >= MAPGEN_LOG_WARN ? stderr : stdout);
+}
+
+void mapgen_log(const MapGenContext* ctx, MapGenLogLevel level, const char* format, ...) {
+    if (!ctx || !ctx->log_fn || level < ctx->log_level) return;
+
+    char message[LOG_MESSAGE_MAX];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    ctx->log_fn(ctx->log_user_data, level, message);
+}
+
+void mapgen_context_seed(MapGenContext* ctx, uint64_t seed) {
+    if (!ctx) return;
+    ctx->seed = seed;
+}
+
+uint64_t mapgen_context_get_seed(const MapGenContext* ctx) {
+    return ctx ? ctx->seed : 0;
+}
+
+RngStream mapgen_rng_stream(const MapGenContext* ctx, RngStage stage, uint64_t index) {
+    return rng_stream(mapgen_context_get_seed(ctx), (uint32_t)stage, index);
+}
+
+void mapgen_context_set_arena(MapGenContext* ctx, Arena* arena) {
+    if (!ctx) return;
+    ctx->arena = arena;
+}
+
+Arena* mapgen_context_arena(const MapGenContext* ctx) {
+    return ctx ? ctx->arena : NULL;
+}
+
+// Returns the pool matching the current config, rebuilding it if the thread
+// settings changed since it was created.
+static ThreadPool* context_pool(MapGenContext* ctx) {
+    int requested = ctx->config.num_threads;
+    bool pinned = ctx->config.pin_threads;
+    if (ctx->pool && (ctx->pool_requested_threads != requested || ctx->pool_pinned != pinned)) {
+        thread_pool_destroy(ctx->pool);
+        ctx->pool = NULL;
+    }
+    if (!ctx->pool) {
+        ctx->pool = thread_pool_create(requested, pinned);
+        ctx->pool_requested_threads = requested;
+        ctx->pool_pinned = pinned;
+    }
+    return ctx->pool;
+}
+
+void mapgen_parallel_bands(MapGenContext* ctx, int count, BandFn fn, void* user_data) {
+    thread_pool_run_bands(ctx ? context_pool(ctx) : NULL, count, fn, user_data);
+}
+
+int mapgen_context_num_threads(MapGenContext* ctx) {
+    return ctx ? thread_pool_size(context_pool(ctx)) : 1;
+}
@@ -0,0 +1,263 @@
+#include "mesh.h"
+#include <stdlib.h>
+#include <math.h>
+
+#include "parallel.h"
+
+#define MESH_TILE_TRIANGLES (2 * MESH_TILE * MESH_TILE - 2)     // Every triangle of a tile's hierarchy
+#define MESH_TILE_PARENTS (MESH_TILE_TRIANGLES - MESH_TILE * MESH_TILE)
+#define MESH_LEVELS (2 * MESH_TILE_SHIFT)                       // Depths 0 (halves of the tile) and up
+
+typedef struct {
+    const MapData* map;
+    int tiles_x, tiles_y;
+    int grid_width;             // tiles_x * MESH_TILE + 1 corners
+    int grid_height;
+    float* heights;             // Corner elevations, grid_width x grid_height
+    float* errors;              // Error of each midpoint, including the triangles below it
+    uint32_t* vertex;           // Vertex id + 1 of each used corner, 0 elsewhere
+    long long* tile_triangles;  // Per tile: triangle count, then first triangle
+    float max_error;
+    int depth;                  // Level propagated by error_band
+    int parity;                 // Tile rows handled by the row-parity passes
+    bool emit;                  // walk_band writes triangles instead of counting them
+    TerrainMesh* out;
+} MeshJob;
+
+// Cells (x, y) of the map around each corner, averaged.
+static void heights_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    MeshJob* job = user_data;
+    const MapData* map = job->map;
+    for (int gy = begin; gy < end; gy++) {
+        int y = gy < map->height ? gy : map->height;
+        int y0 = y > 0 ? y - 1 : 0;
+        int y1 = y < map->height ? y : map->height - 1;
+        for (int gx = 0; gx < job->grid_width; gx++) {
+            int x = gx < map->width ? gx : map->width;
+            int x0 = x > 0 ? x - 1 : 0;
+            int x1 = x < map->width ? x : map->width - 1;
+            double sum = map->elevation[y0][x0] + map->elevation[y0][x1] + map->elevation[y1][x0] + map->elevation[y1][x1];
+            job->heights[(size_t)gy * job->grid_width + gx] = (float)(0.25 * sum);
+        }
+    }
+}
+
+// Corners (a, b, c) of triangle i of a tile, c at the right angle. The low
+// bit of i + 2 picks one half of the tile; each further bit, lowest first,
+// picks a half of the triangle so far.
+static void decode_triangle(int i, int* t) {
+    int id = i + 2;
+    int ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+    if (id & 1) {
+        bx = by = cx = MESH_TILE;
+    } else {
+        ax = ay = cy = MESH_TILE;
+    }
+    while ((id >>= 1) > 1) {
+        int mx = (ax + bx) >> 1;
+        int my = (ay + by) >> 1;
+        if (id & 1) {
+            bx = ax; by = ay;
+            ax = cx; ay = cy;
+        } else {
+            ax = bx; ay = by;
+            bx = cx; by = cy;
+        }
+        cx = mx; cy = my;
+    }
+    t[0] = ax; t[1] = ay; t[2] = bx; t[3] = by; t[4] = cx; t[5] = cy;
+}
+
+// Triangles of one depth in the tile rows of one parity: bands are tile rows
+// of that parity, so the two tiles sharing a seam never run concurrently.
+static void error_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    MeshJob* job = user_data;
+    int gw = job->grid_width;
+    const float* h = job->heights;
+    float* errors = job->errors;
+    int first = (1 << (job->depth + 1)) - 2;
+    int last = (1 << (job->depth + 2)) - 2;
+    if (last > MESH_TILE_TRIANGLES) last = MESH_TILE_TRIANGLES;
+
+    for (int r = begin; r < end; r++) {
+        int oy = (2 * r + job->parity) * MESH_TILE;
+        for (int tx = 0; tx < job->tiles_x; tx++) {
+            int ox = tx * MESH_TILE;
+            for (int i = first; i < last; i++) {
+                int t[6];
+                decode_triangle(i, t);
+                size_t a = (size_t)(oy + t[1]) * gw + ox + t[0];
+                size_t b = (size_t)(oy + t[3]) * gw + ox + t[2];
+                size_t m = (size_t)(oy + ((t[1] + t[3]) >> 1)) * gw + ox + ((t[0] + t[2]) >> 1);
+                float e = fabsf(0.5f * (h[a] + h[b]) - h[m]);
+                if (errors[m] > e) e = errors[m];
+                if (i < MESH_TILE_PARENTS) {
+                    size_t left = (size_t)(oy + ((t[1] + t[5]) >> 1)) * gw + ox + ((t[0] + t[4]) >> 1);
+                    size_t right = (size_t)(oy + ((t[3] + t[5]) >> 1)) * gw + ox + ((t[2] + t[4]) >> 1);
+                    if (errors[left] > e) e = errors[left];
+                    if (errors[right] > e) e = errors[right];
+                }
+                errors[m] = e;
+            }
+        }
+    }
+}
+
+typedef struct {
+    MeshJob* job;
+    long long triangles;        // Counted, or the next one to write
+} MeshWalk;
+
+// Emits triangle (a, b, c), in grid corners, unless clamping onto the map
+// edge collapsed it.
+static void emit_triangle(MeshWalk* walk, int ax, int ay, int bx, int by, int cx, int cy) {
+    MeshJob* job = walk->job;
+    int w = job->map->width, h = job->map->height;
+    int px[3] = { ax < w ? ax : w, bx < w ? bx : w, cx < w ? cx : w };
+    int py[3] = { ay < h ? ay : h, by < h ? by : h, cy < h ? cy : h };
+    int cross = (px[1] - px[0]) * (py[2] - py[0]) - (py[1] - py[0]) * (px[2] - px[0]);
+    if (cross == 0) return;
+
+    size_t corners[3] = { (size_t)ay * job->grid_width + ax, (size_t)by * job->grid_width + bx,
+                          (size_t)cy * job->grid_width + cx };
+    if (!job->emit) {
+        for (int k = 0; k < 3; k++) job->vertex[corners[k]] = 1;
+    } else {
+        uint32_t* out = job->out->indices + 3 * walk->triangles;
+        out[0] = job->vertex[corners[0]] - 1;
+        // Counter-clockwise on the image is a negative cross product with y down
+        out[1] = job->vertex[corners[cross < 0 ? 1 : 2]] - 1;
+        out[2] = job->vertex[corners[cross < 0 ? 2 : 1]] - 1;
+    }
+    walk->triangles++;
+}
+
+static void walk_triangle(MeshWalk* walk, int ax, int ay, int bx, int by, int cx, int cy) {
+    int mx = (ax + bx) >> 1;
+    int my = (ay + by) >> 1;
+    const MeshJob* job = walk->job;
+    if (abs(ax - cx) + abs(ay - cy) > 1 && job->errors[(size_t)my * job->grid_width + mx] > job->max_error) {
+        walk_triangle(walk, cx, cy, ax, ay, mx, my);
+        walk_triangle(walk, bx, by, cx, cy, mx, my);
+    } else {
+        emit_triangle(walk, ax, ay, bx, by, cx, cy);
+    }
+}
+
+static void walk_tile(MeshJob* job, int tx, int ty) {
+    int x0 = tx * MESH_TILE, y0 = ty * MESH_TILE;
+    int x1 = x0 + MESH_TILE, y1 = y0 + MESH_TILE;
+    long long* triangles = &job->tile_triangles[(size_t)ty * job->tiles_x + tx];
+    MeshWalk walk = { job, job->emit ? *triangles : 0 };
+    walk_triangle(&walk, x0, y0, x1, y1, x1, y0);
+    walk_triangle(&walk, x1, y1, x0, y0, x0, y1);
+    if (!job->emit) *triangles = walk.triangles;
+}
+
+// Counting marks the corners used, so it runs on tile rows of one parity at
+// a time like error_band; emitting only reads them and runs on all rows.
+static void walk_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    MeshJob* job = user_data;
+    for (int r = begin; r < end; r++) {
+        int ty = job->emit ? r : 2 * r + job->parity;
+        for (int tx = 0; tx < job->tiles_x; tx++) walk_tile(job, tx, ty);
+    }
+}
+
+static void run_parity_passes(MapGenContext* ctx, MeshJob* job, BandFn fn) {
+    for (job->parity = 0; job->parity < 2; job->parity++) {
+        int rows = (job->tiles_y - job->parity + 1) / 2;
+        if (rows > 0) mapgen_parallel_bands(ctx, rows, fn, job);
+    }
+}
+
+bool build_terrain_mesh(MapGenContext* ctx, const MapData* map, double max_error, TerrainMesh* out) {
+    if (!map || !map->elevation || !out) return false;
+    *out = (TerrainMesh){ 0, NULL, 0, NULL, max_error };
+
+    MeshJob job = { .map = map, .max_error = (float)max_error, .out = out };
+    job.tiles_x = (map->width + MESH_TILE - 1) / MESH_TILE;
+    job.tiles_y = (map->height + MESH_TILE - 1) / MESH_TILE;
+    job.grid_width = job.tiles_x * MESH_TILE + 1;
+    job.grid_height = job.tiles_y * MESH_TILE + 1;
+    size_t corners = (size_t)job.grid_width * job.grid_height;
+    size_t tiles = (size_t)job.tiles_x * job.tiles_y;
+    if (corners > UINT32_MAX) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Map too large for 32-bit mesh indices.\n");
+        return false;
+    }
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    job.heights = scratch_alloc(arena, corners * sizeof(float));
+    job.errors = scratch_calloc(arena, corners, sizeof(float));
+    job.vertex = scratch_calloc(arena, corners, sizeof(uint32_t));
+    job.tile_triangles = scratch_alloc(arena, tiles * sizeof(long long));
+    bool ok = job.heights && job.errors && job.vertex && job.tile_triangles;
+
+    if (ok) {
+        mapgen_parallel_bands(ctx, job.grid_height, heights_band, &job);
+        for (job.depth = MESH_LEVELS - 1; job.depth >= 0; job.depth--) run_parity_passes(ctx, &job, error_band);
+        run_parity_passes(ctx, &job, walk_band);
+
+        // Vertices numbered in raster order, triangles tile by tile, so the
+        // mesh does not depend on the thread count
+        uint32_t vertices = 0;
+        for (size_t c = 0; c < corners; c++) {
+            if (job.vertex[c]) job.vertex[c] = ++vertices;
+        }
+        long long triangles = 0;
+        for (size_t t = 0; t < tiles; t++) {
+            long long count = job.tile_triangles[t];
+            job.tile_triangles[t] = triangles;
+            triangles += count;
+        }
+
+        out->positions = malloc(((size_t)vertices * 3 + 1) * sizeof(float));
+        out->indices = malloc(((size_t)triangles * 3 + 1) * sizeof(uint32_t));
+        ok = out->positions && out->indices && triangles <= INT32_MAX;
+        if (ok) {
+            out->vertex_count = (int)vertices;
+            out->triangle_count = (int)triangles;
+            for (size_t c = 0; c < corners; c++) {
+                if (!job.vertex[c]) continue;
+                float* p = out->positions + 3 * (size_t)(job.vertex[c] - 1);
+                int gx = (int)(c % job.grid_width), gy = (int)(c / job.grid_width);
+                p[0] = (float)(gx < map->width ? gx : map->width);
+                p[1] = (float)(gy < map->height ? gy : map->height);
+                p[2] = job.heights[c];
+            }
+            job.emit = true;
+            mapgen_parallel_bands(ctx, job.tiles_y, walk_band, &job);
+        }
+    }
+
+    if (ok) {
+        double full = 2.0 * map->width * map->height;
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "Terrain mesh: %d vertices, %d triangles (%.1fx fewer than two per cell), max error %.4f.\n",
+                   out->vertex_count, out->triangle_count, full / (out->triangle_count > 0 ? out->triangle_count : 1),
+                   max_error);
+    } else {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate terrain mesh.\n");
+        free_terrain_mesh(out);
+    }
+    scratch_free(arena, job.tile_triangles);
+    scratch_free(arena, job.vertex);
+    scratch_free(arena, job.errors);
+    scratch_free(arena, job.heights);
+    arena_release(arena, mark);
+    return ok;
+}
+
+void free_terrain_mesh(TerrainMesh* mesh) {
+    if (!mesh) return;
+    free(mesh->positions);
+    free(mesh->indices);
+    mesh->positions = NULL;
+    mesh->indices = NULL;
+    mesh->vertex_count = 0;
+    mesh->triangle_count = 0;
+}
@@ -4,49 +4,532 @@
 #include <math.h>
 #include <float.h>
 #include <stdbool.h>
+#include <string.h>
+
+#include "planet.h"
 
 #define FNL_IMPL
+// GCC flags the inlined 3D cellular loops (unused here) once several states
+// are evaluated in the same loop; the library code itself is fine.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waggressive-loop-optimizations"
+#endif
 #include "FastNoiseLite.h"
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 
 struct NoiseState {
     fnl_state noise;
 };
 
-NoiseState* init_noise_generator(int seed) {
+NoiseState* init_noise_generator(MapGenContext* ctx, int seed) {
     NoiseState* state = malloc(sizeof(NoiseState));
     if (!state) {
-        perror("Error allocating NoiseState");
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error allocating NoiseState\n");
         return NULL;
     }
     state->noise = fnlCreateState();
     state->noise.noise_type = FNL_NOISE_OPENSIMPLEX2;
     state->noise.seed = seed;
-    printf("Initialized noise generator with seed %d\n", seed);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Initialized noise generator with seed %d\n", seed);
     return state;
 }
 
-void cleanup_noise_generator(NoiseState* state) {
+void cleanup_noise_generator(MapGenContext* ctx, NoiseState* state) {
     if (state) {
         free(state);
-        printf("Cleaned up noise generator state.\n");
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "Cleaned up noise generator state.\n");
     }
 }
 
-static inline float get_raw_noise(NoiseState* state, float x, float y) {
-     return fnlGetNoise2D(&(state->noise), x, y);
+void reseed_noise_generator(NoiseState* state, int seed) {
+    if (!state) return;
+    state->noise.seed = seed;
+}
+
+static inline float get_raw_noise(fnl_state* noise, float x, float y) {
+     return fnlGetNoise2D(noise, x, y);
+}
+
+// --- Wrapping ---
+
+typedef struct {
+    NoiseWrap mode;
+    double angle_step;          // 2 pi / width
+    double radius;              // Cylinder and torus: width / 2 pi, one cell per unit around the
+                                // circle; cube face: 2 size / pi, a quarter circle per face
+    double row_step;            // 2 pi / height (torus)
+    double tube;                // height / 2 pi (torus), at most TORUS_MAX_TUBE * radius
+    int cube_face;
+    int face_size;
+    const float* column_cos;    // Per column; NULL where points are not on columns
+    const float* column_sin;
+    const double* column_tan;   // Cube face: cube_face_tangent of each column
+} NoiseWrapping;
+
+// The torus tube has to stay thinner than its ring, or the inner side of the
+// ring crosses the axis and the surface passes through itself.
+#define TORUS_MAX_TUBE 0.9
+
+// Per-row part of a sample: radius and position along the axis on the
+// cylinder and torus, the row's tangent coordinate on a cube face.
+typedef struct {
+    float ring, z;
+    double v;
+} WrapRow;
+
+typedef struct {
+    float* column_cos;
+    float* column_sin;
+    double* column_tan;
+} WrapTables;
+
+bool noise_wrap_parse(const char* text, NoiseWrap* out) {
+    static const char* const NAMES[] = { "none", "cylinder", "torus" };
+    for (int w = 0; w <= NOISE_WRAP_TORUS; w++) {
+        if (text && strcmp(text, NAMES[w]) == 0) {
+            *out = (NoiseWrap)w;
+            return true;
+        }
+    }
+    return false;
+}
+
+static NoiseWrapping noise_wrapping(const NoiseParams* params, int width, int height, const WrapTables* tables) {
+    NoiseWrapping w = { params->wrap, 0.0, 0.0, 0.0, 0.0, params->cube_face, width, NULL, NULL, NULL };
+    if (tables) {
+        w.column_cos = tables->column_cos;
+        w.column_sin = tables->column_sin;
+        w.column_tan = tables->column_tan;
+    }
+    if (w.mode == NOISE_WRAP_CUBE_FACE) {
+        w.radius = 2.0 * (width > 0 ? width : 1) / M_PI;
+    } else if (w.mode != NOISE_WRAP_NONE) {
+        w.angle_step = 2.0 * M_PI / (width > 0 ? width : 1);
+        w.radius = (width > 0 ? width : 1) / (2.0 * M_PI);
+        w.row_step = 2.0 * M_PI / (height > 0 ? height : 1);
+        w.tube = (height > 0 ? height : 1) / (2.0 * M_PI);
+        if (w.mode == NOISE_WRAP_TORUS && w.tube > TORUS_MAX_TUBE * w.radius) w.tube = TORUS_MAX_TUBE * w.radius;
+    }
+    return w;
+}
+
+// Adds the column tables params needs (cos and sin of every column's angle,
+// or every column's tangent on a cube face) to tables, from the arena.
+static bool alloc_wrap_tables(Arena* arena, const NoiseParams* params, int width, WrapTables* tables) {
+    NoiseWrapping w = noise_wrapping(params, width, 1, NULL);
+    if (w.mode == NOISE_WRAP_CUBE_FACE && !tables->column_tan) {
+        tables->column_tan = scratch_alloc(arena, (size_t)width * sizeof(double));
+        if (!tables->column_tan) return false;
+        for (int x = 0; x < width; x++) tables->column_tan[x] = cube_face_tangent(x, width);
+    } else if ((w.mode == NOISE_WRAP_CYLINDER || w.mode == NOISE_WRAP_TORUS) && !tables->column_cos) {
+        tables->column_cos = scratch_alloc(arena, (size_t)width * sizeof(float));
+        tables->column_sin = scratch_alloc(arena, (size_t)width * sizeof(float));
+        if (!tables->column_cos || !tables->column_sin) return false;
+        for (int x = 0; x < width; x++) {
+            tables->column_cos[x] = (float)cos(x * w.angle_step);
+            tables->column_sin[x] = (float)sin(x * w.angle_step);
+        }
+    }
+    return true;
+}
+
+static void free_wrap_tables(Arena* arena, WrapTables* tables) {
+    scratch_free(arena, tables->column_tan);
+    scratch_free(arena, tables->column_sin);
+    scratch_free(arena, tables->column_cos);
+}
+
+static inline WrapRow wrap_row(const NoiseWrapping* w, float y) {
+    WrapRow row = { (float)w->radius, y, 0.0 };
+    if (w->mode == NOISE_WRAP_TORUS) {
+        double phi = y * w->row_step;
+        row.ring = (float)(w->radius + w->tube * cos(phi));
+        row.z = (float)(w->tube * sin(phi));
+    } else if (w->mode == NOISE_WRAP_CUBE_FACE) {
+        row.v = cube_face_tangent(y, w->face_size);
+    }
+    return row;
+}
+
+// 3D noise at the sphere point of tangent coordinates (u, v).
+static inline float cube_face_noise(fnl_state* noise, const NoiseWrapping* w, double u, double v) {
+    double p[3];
+    cube_face_point(w->cube_face, u, v, p);
+    double scale = w->radius / sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    return fnlGetNoise3D(noise, (float)(p[0] * scale), (float)(p[1] * scale), (float)(p[2] * scale));
+}
+
+// Raw noise at column x of a row prepared by wrap_row, from the tables.
+static inline float layer_noise(fnl_state* noise, const NoiseWrapping* w, int x, int y, const WrapRow* row) {
+    if (w->mode == NOISE_WRAP_NONE) return get_raw_noise(noise, (float)x, (float)y);
+    if (w->mode == NOISE_WRAP_CUBE_FACE) return cube_face_noise(noise, w, w->column_tan[x], row->v);
+    return fnlGetNoise3D(noise, row->ring * w->column_cos[x], row->ring * w->column_sin[x], row->z);
+}
+
+// Raw noise at any point; the same value as layer_noise on whole cells.
+static float wrapped_noise_at(fnl_state* noise, const NoiseWrapping* w, float x, float y) {
+    if (w->mode == NOISE_WRAP_NONE) return get_raw_noise(noise, x, y);
+    WrapRow row = wrap_row(w, y);
+    if (w->mode == NOISE_WRAP_CUBE_FACE) return cube_face_noise(noise, w, cube_face_tangent(x, w->face_size), row.v);
+    float c = (float)cos(x * w->angle_step), s = (float)sin(x * w->angle_step);
+    return fnlGetNoise3D(noise, row.ring * c, row.ring * s, row.z);
+}
+
+typedef struct {
+    fnl_state noise;        // Copied per band, since the frequency is changed per octave
+    int width;
+    double** target_layer;
+    int octaves;
+    double persistence;
+    double lacunarity;
+    double base_frequency;
+    bool use_ridged;
+    double max_possible_amplitude;
+    NoiseWrapping wrap;
+    double* band_min;       // Per-band range, reduced after all bands finish
+    double* band_max;
+} OctaveNoiseJob;
+
+static void octave_noise_band(void* user_data, int begin, int end, int band) {
+    const OctaveNoiseJob* job = user_data;
+    fnl_state noise = job->noise;
+    double min_val = DBL_MAX;
+    double max_val = -DBL_MAX;
+
+    for (int y = begin; y < end; y++) {
+        double* row = job->target_layer[y];
+        if (!row) continue;
+        WrapRow wrap_y = wrap_row(&job->wrap, (float)y);
+        for (int x = 0; x < job->width; x++) {
+            double total_noise = 0.0;
+            double amplitude = 1.0;
+            double frequency = job->base_frequency;
+
+            for (int i = 0; i < job->octaves; i++) {
+                noise.frequency = (float)frequency;
+                float noise_val = layer_noise(&noise, &job->wrap, x, y, &wrap_y);
+
+                double octave_value;
+                if (job->use_ridged) {
+                    double pseudo_noise_01 = (noise_val * 0.5) + 0.5;
+                    octave_value = 2.0 * (0.5 - fabs(0.5 - pseudo_noise_01));
+                } else {
+                    octave_value = noise_val;
+                }
+
+                total_noise += octave_value * amplitude;
+
+                amplitude *= job->persistence;
+                frequency *= job->lacunarity;
+            }
+
+            double normalized_noise;
+            if (job->use_ridged) {
+                normalized_noise = total_noise / job->max_possible_amplitude;
+            } else {
+                normalized_noise = (total_noise / job->max_possible_amplitude) * 0.5 + 0.5;
+            }
+
+            if (normalized_noise < 0.0) normalized_noise = 0.0;
+            if (normalized_noise > 1.0) normalized_noise = 1.0;
+
+            row[x] = normalized_noise;
+
+            if (normalized_noise < min_val) min_val = normalized_noise;
+            if (normalized_noise > max_val) max_val = normalized_noise;
+        }
+    }
+    job->band_min[band] = min_val;
+    job->band_max[band] = max_val;
 }
 
-void generate_octave_noise_to_layer(NoiseState* state,
+// --- Adaptive Resolution ---
+// Octave i only has features of size ~1/frequency_i cells, so it can be sampled
+// on a grid with spacing proportional to that and reconstructed by
+// interpolation. Each octave gets its own grid (one extra point on each side
+// for the cubic kernel); direct octaves (spacing 0) are evaluated per cell.
+// The spacing is calibrated on ADAPTIVE_CALIBRATION_SAMPLES cells only, so the
+// error target holds at those cells and is an estimate everywhere else.
+
+#define ADAPTIVE_MIN_SPACING 2
+#define ADAPTIVE_CALIBRATION_SAMPLES 256
+
+typedef struct {
+    int spacing;       // Grid step in cells, 0 = evaluate directly
+    int grid_width;    // Points per grid row, including the border points
+    int grid_height;
+    float* grid;       // grid_height rows of grid_width raw noise values
+    float frequency;
+    double amplitude;
+} OctaveGrid;
+
+static inline double catmull_rom(double p0, double p1, double p2, double p3, double t) {
+    return p1 + 0.5 * t * (p2 - p0 + t * (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3
+                                          + t * (3.0 * (p1 - p2) + p3 - p0)));
+}
+
+// Interpolated value at (x, y) from the 4x4 neighbourhood of grid points,
+// evaluating those points directly. Only used to calibrate the spacing.
+static double interpolate_direct(fnl_state* noise, const NoiseWrapping* wrap, int spacing, int x, int y) {
+    int gx = x / spacing, gy = y / spacing;
+    double tx = (double)(x - gx * spacing) / spacing;
+    double ty = (double)(y - gy * spacing) / spacing;
+    double column[4];
+    for (int j = 0; j < 4; j++) {
+        float py = (float)((gy - 1 + j) * spacing);
+        double p[4];
+        for (int i = 0; i < 4; i++) {
+            p[i] = wrapped_noise_at(noise, wrap, (float)((gx - 1 + i) * spacing), py);
+        }
+        column[j] = catmull_rom(p[0], p[1], p[2], p[3], tx);
+    }
+    return catmull_rom(column[0], column[1], column[2], column[3], ty);
+}
+
+// Largest spacing (shrinking by 20% per try from one wavelength) whose worst error over a
+// fixed set of sample cells is within max_error. Returns 0 if no spacing of at
+// least ADAPTIVE_MIN_SPACING qualifies.
+static int choose_octave_spacing(fnl_state* noise, const NoiseWrapping* wrap, int width, int height,
+                                 double max_error, double* measured_error) {
+    int spacing = (int)(1.0 / noise->frequency);
+    while (spacing >= ADAPTIVE_MIN_SPACING) {
+        double worst = 0.0;
+        for (int k = 0; k < ADAPTIVE_CALIBRATION_SAMPLES && worst <= max_error; k++) {
+            // Low-discrepancy (golden ratio) sample positions, identical every run
+            int x = (int)(fmod(k * 0.6180339887498949, 1.0) * width);
+            int y = (int)(fmod(k * 0.7548776662466927 + 0.5, 1.0) * height);
+            double exact = wrapped_noise_at(noise, wrap, (float)x, (float)y);
+            double err = fabs(interpolate_direct(noise, wrap, spacing, x, y) - exact);
+            if (err > worst) worst = err;
+        }
+        if (worst <= max_error) {
+            *measured_error = worst;
+            return spacing;
+        }
+        int next = (int)(spacing * 0.8);
+        spacing = next < spacing ? next : spacing - 1;
+    }
+    *measured_error = 0.0;
+    return 0;
+}
+
+typedef struct {
+    fnl_state noise;
+    const NoiseWrapping* wrap;
+    OctaveGrid* grid;
+} GridFillJob;
+
+static void fill_grid_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    GridFillJob* job = user_data;
+    fnl_state noise = job->noise;
+    OctaveGrid* g = job->grid;
+    noise.frequency = g->frequency;
+    for (int j = begin; j < end; j++) {
+        float py = (float)((j - 1) * g->spacing);
+        float* row = g->grid + (size_t)j * g->grid_width;
+        for (int i = 0; i < g->grid_width; i++) {
+            row[i] = wrapped_noise_at(&noise, job->wrap, (float)((i - 1) * g->spacing), py);
+        }
+    }
+}
+
+typedef struct {
+    fnl_state noise;
+    int width;
+    double** target_layer;
+    int octaves;
+    const OctaveGrid* grids;
+    bool use_ridged;
+    double max_possible_amplitude;
+    NoiseWrapping wrap;
+    double* band_scratch;   // Per band: width accumulators + widest grid row
+    size_t scratch_stride;  // Doubles per band in band_scratch
+    double* band_min;
+    double* band_max;
+} AdaptiveNoiseJob;
+
+static void adaptive_noise_band(void* user_data, int begin, int end, int band) {
+    const AdaptiveNoiseJob* job = user_data;
+    fnl_state noise = job->noise;
+    double* total = job->band_scratch + (size_t)band * job->scratch_stride;
+    double* column = total + job->width;
+    double min_val = DBL_MAX;
+    double max_val = -DBL_MAX;
+
+    for (int y = begin; y < end; y++) {
+        double* row = job->target_layer[y];
+        if (!row) continue;
+        for (int x = 0; x < job->width; x++) total[x] = 0.0;
+        WrapRow wrap_y = wrap_row(&job->wrap, (float)y);
+
+        for (int o = 0; o < job->octaves; o++) {
+            const OctaveGrid* g = &job->grids[o];
+            if (g->spacing == 0) {
+                noise.frequency = g->frequency;
+                for (int x = 0; x < job->width; x++) {
+                    double v = layer_noise(&noise, &job->wrap, x, y, &wrap_y);
+                    if (job->use_ridged) v = 2.0 * (0.5 - fabs(0.5 - (v * 0.5 + 0.5)));
+                    total[x] += v * g->amplitude;
+                }
+                continue;
+            }
+
+            // Vertical pass: collapse the 4 grid rows around y into one row
+            int gy = y / g->spacing;
+            double ty = (double)(y - gy * g->spacing) / g->spacing;
+            const float* r0 = g->grid + (size_t)gy * g->grid_width; // Grid row gy - 1
+            const float* r1 = r0 + g->grid_width;
+            const float* r2 = r1 + g->grid_width;
+            const float* r3 = r2 + g->grid_width;
+            for (int i = 0; i < g->grid_width; i++) {
+                column[i] = catmull_rom(r0[i], r1[i], r2[i], r3[i], ty);
+            }
+
+            // Horizontal pass
+            for (int x = 0; x < job->width; x++) {
+                int gx = x / g->spacing;
+                double tx = (double)(x - gx * g->spacing) / g->spacing;
+                double v = catmull_rom(column[gx], column[gx + 1], column[gx + 2], column[gx + 3], tx);
+                if (job->use_ridged) v = 2.0 * (0.5 - fabs(0.5 - (v * 0.5 + 0.5)));
+                total[x] += v * g->amplitude;
+            }
+        }
+
+        for (int x = 0; x < job->width; x++) {
+            double normalized_noise;
+            if (job->use_ridged) {
+                normalized_noise = total[x] / job->max_possible_amplitude;
+            } else {
+                normalized_noise = (total[x] / job->max_possible_amplitude) * 0.5 + 0.5;
+            }
+            if (normalized_noise < 0.0) normalized_noise = 0.0;
+            if (normalized_noise > 1.0) normalized_noise = 1.0;
+            row[x] = normalized_noise;
+            if (normalized_noise < min_val) min_val = normalized_noise;
+            if (normalized_noise > max_val) max_val = normalized_noise;
+        }
+    }
+    job->band_min[band] = min_val;
+    job->band_max[band] = max_val;
+}
+
+// Adaptive counterpart of the per-cell loop; same normalization and output.
+// Returns false if scratch could not be allocated (nothing written).
+static bool generate_adaptive_octaves(MapGenContext* ctx, NoiseState* state, int width, int height,
+                                      double** target_layer, int octaves, const NoiseParams* params,
+                                      const NoiseWrapping* wrap, double max_possible_amplitude,
+                                      double* band_min, double* band_max)
+{
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    OctaveGrid* grids = scratch_calloc(arena, octaves, sizeof(OctaveGrid));
+    if (!grids) return false;
+
+    bool ok = true;
+    int widest_grid = 0;
+    long long evaluations = 0;
+    double amplitude = 1.0;
+    double frequency = params->base_frequency;
+    fnl_state noise = state->noise;
+
+    for (int o = 0; o < octaves && ok; o++) {
+        OctaveGrid* g = &grids[o];
+        g->frequency = (float)frequency;
+        g->amplitude = amplitude;
+        noise.frequency = g->frequency;
+
+        double measured = 0.0;
+        g->spacing = choose_octave_spacing(&noise, wrap, width, height, params->max_interp_error, &measured);
+        if (g->spacing > 0) {
+            g->grid_width = (width - 1) / g->spacing + 4;
+            g->grid_height = (height - 1) / g->spacing + 4;
+            g->grid = scratch_alloc(arena, (size_t)g->grid_width * g->grid_height * sizeof(float));
+            if (!g->grid) { ok = false; break; }
+            GridFillJob fill = { state->noise, wrap, g };
+            mapgen_parallel_bands(ctx, g->grid_height, fill_grid_band, &fill);
+            if (g->grid_width > widest_grid) widest_grid = g->grid_width;
+            evaluations += (long long)g->grid_width * g->grid_height;
+            mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Octave %d: grid spacing %d (%dx%d points, measured error %.2e)\n",
+                       o, g->spacing, g->grid_width, g->grid_height, measured);
+        } else {
+            evaluations += (long long)width * height;
+            mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Octave %d: evaluated per cell\n", o);
+        }
+
+        amplitude *= params->persistence;
+        frequency *= params->lacunarity;
+    }
+
+    int num_bands = mapgen_context_num_threads(ctx);
+    size_t stride = (size_t)width + widest_grid;
+    double* band_scratch = ok ? scratch_alloc(arena, num_bands * stride * sizeof(double)) : NULL;
+    if (band_scratch) {
+        AdaptiveNoiseJob job = {
+            .noise = state->noise, .width = width, .target_layer = target_layer,
+            .octaves = octaves, .grids = grids, .use_ridged = params->use_ridged,
+            .max_possible_amplitude = max_possible_amplitude, .wrap = *wrap,
+            .band_scratch = band_scratch, .scratch_stride = stride,
+            .band_min = band_min, .band_max = band_max
+        };
+        mapgen_parallel_bands(ctx, height, adaptive_noise_band, &job);
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Adaptive resolution: %lld noise evaluations (%.1fx fewer than per cell)\n",
+                   evaluations, (double)octaves * width * height / (evaluations > 0 ? evaluations : 1));
+    }
+
+    for (int o = 0; o < octaves; o++) scratch_free(arena, grids[o].grid);
+    scratch_free(arena, band_scratch);
+    scratch_free(arena, grids);
+    arena_release(arena, mark);
+    return band_scratch != NULL;
+}
+
+// Logs the parameters and returns the normalization divisor (sum of the
+// octave amplitudes), shared by the single-channel and fused generators.
+static double octave_amplitude_sum(MapGenContext* ctx, const NoiseParams* params, int octaves, int width, int height) {
+	mapgen_log(ctx, MAPGEN_LOG_INFO, "Generating octave noise (%d octaves, persist=%.2f, lacun=%.2f, freq=%.4f, ridged=%s)...\n",
+           octaves, params->persistence, params->lacunarity, params->base_frequency, params->use_ridged ? "true" : "false");
+    if (params->wrap == NOISE_WRAP_CYLINDER) mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Wrapping around a cylinder (3D noise)\n");
+    if (params->wrap == NOISE_WRAP_TORUS) {
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Wrapping around a torus (3D noise)\n");
+        if (height > TORUS_MAX_TUBE * width) {
+            mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: torus map is %dx%d; height above %.1f x width would self-intersect, "
+                       "so the tube is shrunk and features stretch vertically.\n", width, height, TORUS_MAX_TUBE);
+        }
+    }
+    if (params->wrap == NOISE_WRAP_CUBE_FACE) {
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Cube-sphere face %s (3D noise)\n", cube_face_name(params->cube_face));
+    }
+
+    double max_possible_amplitude = 0.0;
+    double current_amplitude = 1.0;
+    for (int i = 0; i < octaves; i++) {
+        max_possible_amplitude += current_amplitude;
+        current_amplitude *= params->persistence;
+    }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Calculated max_possible_amplitude: %.4f\n", max_possible_amplitude);
+
+    if (max_possible_amplitude <= 1e-6) {
+        max_possible_amplitude = 1.0;
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Max possible amplitude is near zero. Normalization may be inaccurate.\n");
+    }
+    return max_possible_amplitude;
+}
+
+void generate_octave_noise_to_layer(MapGenContext* ctx, NoiseState* state,
                                     int width, int height,
                                     double** target_layer,
                                     const NoiseParams* params)
 {
     if (!state || !target_layer || !params) {
-        fprintf(stderr, "Error: Invalid state, target_layer, or params provided.\n");
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Invalid state, target_layer, or params provided.\n");
         return;
     }
     if (width <= 0 || height <= 0) {
-         fprintf(stderr, "Error: Invalid dimensions provided.\n");
+         mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Invalid dimensions provided.\n");
          return;
     }
 
@@ -57,77 +540,284 @@ void generate_octave_noise_to_layer(NoiseState* state,
     bool use_ridged = params->use_ridged;
 
     if (octaves < 1) octaves = 1;
+    double max_possible_amplitude = octave_amplitude_sum(ctx, params, octaves, width, height);
 
-	printf("Generating octave noise (%d octaves, persist=%.2f, lacun=%.2f, freq=%.4f, ridged=%s)...\n",
-           octaves, persistence, lacunarity, base_frequency, use_ridged ? "true" : "false");
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    int num_bands = mapgen_context_num_threads(ctx);
+    double* band_min = scratch_alloc(arena, num_bands * sizeof(double));
+    double* band_max = scratch_alloc(arena, num_bands * sizeof(double));
+    WrapTables tables = { NULL, NULL, NULL };
+    if (!band_min || !band_max || !alloc_wrap_tables(arena, params, width, &tables)) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate noise band scratch.\n");
+        free_wrap_tables(arena, &tables);
+        scratch_free(arena, band_min);
+        scratch_free(arena, band_max);
+        arena_release(arena, mark);
+        return;
+    }
+    NoiseWrapping wrap = noise_wrapping(params, width, height, &tables);
+    for (int b = 0; b < num_bands; b++) {
+        band_min[b] = DBL_MAX;
+        band_max[b] = -DBL_MAX;
+    }
+
+    bool done = false;
+    if (params->max_interp_error > 0.0) {
+        done = generate_adaptive_octaves(ctx, state, width, height, target_layer, octaves, params,
+                                         &wrap, max_possible_amplitude, band_min, band_max);
+        if (!done) mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Adaptive noise scratch unavailable, evaluating per cell.\n");
+    }
+    if (!done) {
+        OctaveNoiseJob job = {
+            .noise = state->noise, .width = width, .target_layer = target_layer,
+            .octaves = octaves, .persistence = persistence, .lacunarity = lacunarity,
+            .base_frequency = base_frequency, .use_ridged = use_ridged,
+            .max_possible_amplitude = max_possible_amplitude, .wrap = wrap,
+            .band_min = band_min, .band_max = band_max
+        };
+        mapgen_parallel_bands(ctx, height, octave_noise_band, &job);
+    }
 
     double min_val = DBL_MAX;
     double max_val = -DBL_MAX;
-
-    double max_possible_amplitude = 0.0;
-    double current_amplitude = 1.0;
-    for (int i = 0; i < octaves; i++) {
-        max_possible_amplitude += current_amplitude;
-        current_amplitude *= persistence;
+    for (int b = 0; b < num_bands; b++) {
+        if (band_min[b] < min_val) min_val = band_min[b];
+        if (band_max[b] > max_val) max_val = band_max[b];
     }
-    printf("--> Calculated max_possible_amplitude: %.4f\n", max_possible_amplitude);
+    free_wrap_tables(arena, &tables);
+    scratch_free(arena, band_min);
+    scratch_free(arena, band_max);
+    arena_release(arena, mark);
 
-    if (max_possible_amplitude <= 1e-6) {
-        max_possible_amplitude = 1.0;
-        fprintf(stderr, "Warning: Max possible amplitude is near zero. Normalization may be inaccurate.\n");
-    }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Octave noise generation complete.\n");
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Actual value range generated: [%.4f, %.4f]\n", min_val, max_val);
+}
 
-    for (int y = 0; y < height; y++) {
-        if (!target_layer[y]) {
-             fprintf(stderr, "Error: Target layer row %d is NULL.\n", y);
-             continue;
-        }
-        for (int x = 0; x < width; x++) {
-            float world_x = (float)x;
-            float world_y = (float)y;
-            double total_noise = 0.0;
-            double amplitude = 1.0;
-            double frequency = base_frequency;
+// --- Fused Multi-Channel Traversal ---
+// All channels are evaluated per cell in one pass over the map: the cell
+// coordinates and loop are shared and each band writes one row of every
+// target layer while those rows are in cache. This fuses the traversal only;
+// FastNoiseLite evaluates one point at a time, so every channel's octaves are
+// scalar calls, and the normalization folds the ridged/non-ridged difference
+// into a per-channel scale and offset.
 
-            for (int i = 0; i < octaves; i++) {
-                state->noise.frequency = (float)frequency;
-                float noise_x = world_x;
-                float noise_y = world_y;
+typedef struct {
+    fnl_state noise;
+    double** target_layer;
+    int octaves;
+    double persistence;
+    double lacunarity;
+    double base_frequency;
+    bool use_ridged;
+    double max_possible_amplitude;
+    double scale;           // 0.5 (signed noise) or 1.0 (ridged, already [0,1])
+    double offset;          // 0.5 or 0.0
+    NoiseWrapping wrap;     // Column tables shared by all channels
+} NoiseChannelSetup;
 
-                float noise_val = get_raw_noise(state, noise_x, noise_y);
+typedef struct {
+    int width;
+    int num_channels;
+    NoiseChannelSetup channels[NOISE_MAX_CHANNELS];
+    double* band_min;       // NOISE_MAX_CHANNELS entries per band
+    double* band_max;
+} FusedNoiseJob;
 
-                double octave_value;
-                if (use_ridged) {
-                    double pseudo_noise_01 = (noise_val * 0.5) + 0.5;
-                    octave_value = 2.0 * (0.5 - fabs(0.5 - pseudo_noise_01));
-                } else {
-                    octave_value = noise_val;
-                }
+static void fused_noise_band(void* user_data, int begin, int end, int band) {
+    const FusedNoiseJob* job = user_data;
+    int n = job->num_channels;
+    fnl_state noise[NOISE_MAX_CHANNELS];
+    double amplitude_sum[NOISE_MAX_CHANNELS], scale[NOISE_MAX_CHANNELS], offset[NOISE_MAX_CHANNELS];
+    double min_val[NOISE_MAX_CHANNELS], max_val[NOISE_MAX_CHANNELS];
+    double total[NOISE_MAX_CHANNELS];
+    double* rows[NOISE_MAX_CHANNELS];
+    for (int c = 0; c < n; c++) {
+        noise[c] = job->channels[c].noise;
+        amplitude_sum[c] = job->channels[c].max_possible_amplitude;
+        scale[c] = job->channels[c].scale;
+        offset[c] = job->channels[c].offset;
+        min_val[c] = DBL_MAX;
+        max_val[c] = -DBL_MAX;
+    }
 
-                total_noise += octave_value * amplitude;
+    for (int y = begin; y < end; y++) {
+        bool missing_row = false;
+        for (int c = 0; c < n; c++) {
+            rows[c] = job->channels[c].target_layer[y];
+            if (!rows[c]) missing_row = true;
+        }
+        if (missing_row) continue;
+        WrapRow wrap_y[NOISE_MAX_CHANNELS];
+        for (int c = 0; c < n; c++) wrap_y[c] = wrap_row(&job->channels[c].wrap, (float)y);
 
-                amplitude *= persistence;
-                frequency *= lacunarity;
+        for (int x = 0; x < job->width; x++) {
+            for (int c = 0; c < n; c++) {
+                const NoiseChannelSetup* ch = &job->channels[c];
+                double total_noise = 0.0;
+                double amplitude = 1.0;
+                double frequency = ch->base_frequency;
+                for (int i = 0; i < ch->octaves; i++) {
+                    noise[c].frequency = (float)frequency;
+                    float noise_val = layer_noise(&noise[c], &ch->wrap, x, y, &wrap_y[c]);
+                    double octave_value;
+                    if (ch->use_ridged) {
+                        double pseudo_noise_01 = (noise_val * 0.5) + 0.5;
+                        octave_value = 2.0 * (0.5 - fabs(0.5 - pseudo_noise_01));
+                    } else {
+                        octave_value = noise_val;
+                    }
+                    total_noise += octave_value * amplitude;
+                    amplitude *= ch->persistence;
+                    frequency *= ch->lacunarity;
+                }
+                total[c] = total_noise;
             }
 
-            double normalized_noise;
-            if (use_ridged) {
-                normalized_noise = total_noise / max_possible_amplitude;
-            } else {
-                normalized_noise = (total_noise / max_possible_amplitude) * 0.5 + 0.5;
+            for (int c = 0; c < n; c++) {
+                double v = (total[c] / amplitude_sum[c]) * scale[c] + offset[c];
+                v = v < 0.0 ? 0.0 : v;
+                v = v > 1.0 ? 1.0 : v;
+                rows[c][x] = v;
+                min_val[c] = v < min_val[c] ? v : min_val[c];
+                max_val[c] = v > max_val[c] ? v : max_val[c];
             }
+        }
+    }
+    for (int c = 0; c < n; c++) {
+        job->band_min[band * NOISE_MAX_CHANNELS + c] = min_val[c];
+        job->band_max[band * NOISE_MAX_CHANNELS + c] = max_val[c];
+    }
+}
 
-            if (normalized_noise < 0.0) normalized_noise = 0.0;
-            if (normalized_noise > 1.0) normalized_noise = 1.0;
+void generate_octave_noise_fused(MapGenContext* ctx, int width, int height,
+                                    const NoiseChannel* channels, int num_channels)
+{
+    if (!channels || num_channels < 0 || num_channels > NOISE_MAX_CHANNELS) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Invalid noise channel list (%d channels, max %d).\n",
+                   num_channels, NOISE_MAX_CHANNELS);
+        return;
+    }
+    if (width <= 0 || height <= 0) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Invalid dimensions provided.\n");
+        return;
+    }
+
+    // Adaptive channels have their own grid traversal; the rest share this one.
+    FusedNoiseJob job = { .width = width, .num_channels = 0 };
+    int channel_index[NOISE_MAX_CHANNELS];
+    for (int c = 0; c < num_channels; c++) {
+        const NoiseChannel* channel = &channels[c];
+        if (!channel->state || !channel->target_layer || !channel->params) {
+            mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Invalid state, target_layer, or params provided.\n");
+            continue;
+        }
+        if (channel->params->max_interp_error > 0.0) {
+            generate_octave_noise_to_layer(ctx, channel->state, width, height,
+                                           channel->target_layer, channel->params);
+            continue;
+        }
 
-            target_layer[y][x] = normalized_noise;
+        const NoiseParams* params = channel->params;
+        int octaves = params->octaves < 1 ? 1 : params->octaves;
+        NoiseChannelSetup* ch = &job.channels[job.num_channels];
+        *ch = (NoiseChannelSetup){
+            .noise = channel->state->noise, .target_layer = channel->target_layer,
+            .octaves = octaves, .persistence = params->persistence, .lacunarity = params->lacunarity,
+            .base_frequency = params->base_frequency, .use_ridged = params->use_ridged,
+            .max_possible_amplitude = octave_amplitude_sum(ctx, params, octaves, width, height),
+            .scale = params->use_ridged ? 1.0 : 0.5,
+            .offset = params->use_ridged ? 0.0 : 0.5
+        };
+        channel_index[job.num_channels++] = c;
+    }
+    if (job.num_channels == 0) return;
 
-            if (normalized_noise < min_val) min_val = normalized_noise;
-            if (normalized_noise > max_val) max_val = normalized_noise;
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    int num_bands = mapgen_context_num_threads(ctx);
+    size_t range_count = (size_t)num_bands * NOISE_MAX_CHANNELS;
+    job.band_min = scratch_alloc(arena, range_count * sizeof(double));
+    job.band_max = scratch_alloc(arena, range_count * sizeof(double));
+    // The column tables only depend on the width, so wrapped channels share them
+    WrapTables tables = { NULL, NULL, NULL };
+    bool tables_ok = true;
+    for (int c = 0; c < job.num_channels; c++) {
+        tables_ok = tables_ok && alloc_wrap_tables(arena, channels[channel_index[c]].params, width, &tables);
+    }
+    if (!job.band_min || !job.band_max || !tables_ok) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate noise band scratch.\n");
+        free_wrap_tables(arena, &tables);
+        scratch_free(arena, job.band_min);
+        scratch_free(arena, job.band_max);
+        arena_release(arena, mark);
+        return;
+    }
+    for (int c = 0; c < job.num_channels; c++) {
+        job.channels[c].wrap = noise_wrapping(channels[channel_index[c]].params, width, height, &tables);
+    }
+    for (size_t i = 0; i < range_count; i++) {
+        job.band_min[i] = DBL_MAX;
+        job.band_max[i] = -DBL_MAX;
+    }
+
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Evaluating %d noise channels in one pass...\n", job.num_channels);
+    mapgen_parallel_bands(ctx, height, fused_noise_band, &job);
+
+    for (int c = 0; c < job.num_channels; c++) {
+        double min_val = DBL_MAX;
+        double max_val = -DBL_MAX;
+        for (int b = 0; b < num_bands; b++) {
+            if (job.band_min[b * NOISE_MAX_CHANNELS + c] < min_val) min_val = job.band_min[b * NOISE_MAX_CHANNELS + c];
+            if (job.band_max[b * NOISE_MAX_CHANNELS + c] > max_val) max_val = job.band_max[b * NOISE_MAX_CHANNELS + c];
+        }
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Channel %d range generated: [%.4f, %.4f]\n",
+                   channel_index[c], min_val, max_val);
+    }
+    free_wrap_tables(arena, &tables);
+    scratch_free(arena, job.band_min);
+    scratch_free(arena, job.band_max);
+    arena_release(arena, mark);
+}
+
+// --- Point Sampling ---
+
+void sample_octave_noise(const NoiseState* state, const NoiseParams* params, int width, int height,
+                         const float* x, const float* y, int count, double* out)
+{
+    if (!state || !params || !x || !y || !out || count <= 0) return;
+    int octaves = params->octaves < 1 ? 1 : params->octaves;
+    double max_possible_amplitude = 0.0;
+    double current_amplitude = 1.0;
+    for (int i = 0; i < octaves; i++) {
+        max_possible_amplitude += current_amplitude;
+        current_amplitude *= params->persistence;
+    }
+    if (max_possible_amplitude <= 1e-6) max_possible_amplitude = 1.0;
+
+    fnl_state noise = state->noise;
+    NoiseWrapping wrap = noise_wrapping(params, width, height, NULL);
+    for (int p = 0; p < count; p++) out[p] = 0.0;
+    double amplitude = 1.0;
+    double frequency = params->base_frequency;
+    for (int i = 0; i < octaves; i++) {
+        noise.frequency = (float)frequency;
+        for (int p = 0; p < count; p++) {
+            double v = wrapped_noise_at(&noise, &wrap, x[p], y[p]);
+            if (params->use_ridged) v = 2.0 * (0.5 - fabs(0.5 - (v * 0.5 + 0.5)));
+            out[p] += v * amplitude;
         }
+        amplitude *= params->persistence;
+        frequency *= params->lacunarity;
+    }
+
+    double scale = params->use_ridged ? 1.0 : 0.5;
+    double offset = params->use_ridged ? 0.0 : 0.5;
+    for (int p = 0; p < count; p++) {
+        double v = (out[p] / max_possible_amplitude) * scale + offset;
+        v = v < 0.0 ? 0.0 : v;
+        out[p] = v > 1.0 ? 1.0 : v;
     }
-    printf("Octave noise generation complete.\n");
-    printf("--> Actual value range generated: [%.4f, %.4f]\n", min_val, max_val);
 }
 
 float get_noise_value(NoiseState* state, float x, float y) {
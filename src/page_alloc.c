@@ -0,0 +1,128 @@
+#define _GNU_SOURCE // MAP_HUGETLB, MADV_HUGEPAGE
+#include "page_alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define PAGE_STATS_MAX_SAMPLES 256
+
+static size_t base_page_size(void) {
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+}
+
+void* page_alloc(size_t size, PageMode mode, size_t* mapped_size, size_t* page_size) {
+    size_t length = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void* ptr = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if (mode == PAGE_MODE_EXPLICIT_HUGE) {
+        ptr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            *page_size = HUGE_PAGE_SIZE;
+            *mapped_size = length;
+            return ptr;
+        }
+        // No reserved hugetlb pages; transparent huge pages are the next best thing
+        mode = PAGE_MODE_TRANSPARENT_HUGE;
+    }
+#endif
+
+    ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) return NULL;
+
+#ifdef MADV_HUGEPAGE
+    if (mode == PAGE_MODE_TRANSPARENT_HUGE) {
+        madvise(ptr, length, MADV_HUGEPAGE);
+    }
+#endif
+
+    *page_size = base_page_size();
+    *mapped_size = length;
+    return ptr;
+}
+
+void page_free(void* ptr, size_t mapped_size) {
+    if (ptr) munmap(ptr, mapped_size);
+}
+
+// Fills kernel page size and huge page bytes from the smaps entry covering ptr.
+static void query_smaps(const void* ptr, PageStats* stats) {
+    FILE* smaps = fopen("/proc/self/smaps", "r");
+    if (!smaps) return;
+
+    uintptr_t addr = (uintptr_t)ptr;
+    bool in_mapping = false;
+    char line[512];
+    while (fgets(line, sizeof(line), smaps)) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            if (in_mapping) break; // Past the mapping we wanted
+            in_mapping = addr >= start && addr < end;
+            continue;
+        }
+        if (!in_mapping) continue;
+
+        unsigned long kb;
+        if (sscanf(line, "Size: %lu kB", &kb) == 1) {
+            stats->mapping_bytes = kb * 1024;
+        } else if (sscanf(line, "KernelPageSize: %lu kB", &kb) == 1) {
+            stats->kernel_page_size = kb * 1024;
+        } else if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+                   sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1 ||
+                   sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1) {
+            stats->huge_bytes += kb * 1024;
+        }
+    }
+    fclose(smaps);
+}
+
+void page_query_stats(const void* ptr, size_t size, PageStats* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(PageStats));
+    if (!ptr || size == 0) return;
+    stats->total_bytes = size;
+
+    query_smaps(ptr, stats);
+
+#ifdef SYS_move_pages
+    size_t page = base_page_size();
+    uintptr_t first = (uintptr_t)ptr & ~(page - 1);
+    size_t num_pages = ((uintptr_t)ptr + size - first + page - 1) / page;
+    int samples = num_pages < PAGE_STATS_MAX_SAMPLES ? (int)num_pages : PAGE_STATS_MAX_SAMPLES;
+
+    void* pages[PAGE_STATS_MAX_SAMPLES];
+    int status[PAGE_STATS_MAX_SAMPLES];
+    for (int i = 0; i < samples; i++) {
+        size_t index = num_pages * (size_t)i / samples;
+        pages[i] = (void*)(first + index * page);
+        status[i] = -1;
+    }
+
+    // With nodes == NULL, move_pages only reports the node of each page
+    if (syscall(SYS_move_pages, 0, (unsigned long)samples, pages, NULL, status, 0) != 0) {
+        stats->sampled_pages = samples;
+        stats->unplaced_pages = samples;
+        return;
+    }
+    stats->sampled_pages = samples;
+    for (int i = 0; i < samples; i++) {
+        if (status[i] >= 0 && status[i] < PAGE_STATS_MAX_NODES) stats->node_pages[status[i]]++;
+        else stats->unplaced_pages++;
+    }
+#endif
+}
+
+const char* page_mode_name(PageMode mode) {
+    switch (mode) {
+        case PAGE_MODE_TRANSPARENT_HUGE: return "transparent-huge";
+        case PAGE_MODE_EXPLICIT_HUGE: return "explicit-huge";
+        default: return "default";
+    }
+}
@@ -0,0 +1,170 @@
+#define _GNU_SOURCE // pthread_setaffinity_np, CPU_SET
+#include "parallel.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+typedef struct {
+    ThreadPool* pool;
+    int band;
+} PoolWorker;
+
+struct ThreadPool {
+    int num_threads;            // Including the calling thread (band 0)
+    pthread_t* threads;         // num_threads - 1 helpers
+    PoolWorker* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    unsigned long generation;   // Bumped for every run; guarded by lock
+    int pending;                // Helpers still working on this generation
+    bool shutting_down;
+    // Current job, valid while pending > 0
+    int count;
+    BandFn fn;
+    void* user_data;
+};
+
+int online_cpu_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+void band_range(int count, int num_bands, int band, int* begin, int* end) {
+    if (num_bands < 1) num_bands = 1;
+    *begin = (int)((long long)count * band / num_bands);
+    *end = (int)((long long)count * (band + 1) / num_bands);
+}
+
+// Next CPU handed to a pinned helper thread. Shared by all pools, so pools
+// running side by side (batch and planet workers, stage lanes) pin their
+// helpers to different cores instead of all starting at CPU 0.
+static pthread_mutex_t pin_lock = PTHREAD_MUTEX_INITIALIZER;
+static int next_pinned_cpu = 0;
+
+// Claims count consecutive CPUs (modulo the core count); returns the first.
+static int claim_pinned_cpus(int count) {
+    pthread_mutex_lock(&pin_lock);
+    int first = next_pinned_cpu;
+    next_pinned_cpu = (next_pinned_cpu + count) % online_cpu_count();
+    pthread_mutex_unlock(&pin_lock);
+    return first;
+}
+
+static void pin_thread(pthread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % online_cpu_count(), &set);
+    pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+static void* pool_worker_main(void* arg) {
+    PoolWorker* worker = arg;
+    ThreadPool* pool = worker->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutting_down && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutting_down) break;
+        seen = pool->generation;
+        int count = pool->count;
+        BandFn fn = pool->fn;
+        void* user_data = pool->user_data;
+        pthread_mutex_unlock(&pool->lock);
+
+        int begin, end;
+        band_range(count, pool->num_threads, worker->band, &begin, &end);
+        if (begin < end) fn(user_data, begin, end, worker->band);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) pthread_cond_signal(&pool->work_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool* thread_pool_create(int num_threads, bool pin_threads) {
+    if (num_threads <= 0) num_threads = online_cpu_count();
+
+    ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+    pool->num_threads = num_threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    if (num_threads > 1) {
+        pool->threads = malloc((num_threads - 1) * sizeof(pthread_t));
+        pool->workers = malloc((num_threads - 1) * sizeof(PoolWorker));
+        if (!pool->threads || !pool->workers) {
+            pool->num_threads = 1;
+        }
+    }
+
+    // Only the helpers are pinned: the calling thread's affinity belongs to
+    // the caller, and a one-thread pool has nothing to place
+    int first_cpu = pin_threads && pool->num_threads > 1 ? claim_pinned_cpus(pool->num_threads - 1) : 0;
+    for (int i = 1; i < pool->num_threads; i++) {
+        pool->workers[i - 1] = (PoolWorker){ pool, i };
+        if (pthread_create(&pool->threads[i - 1], NULL, pool_worker_main, &pool->workers[i - 1]) != 0) {
+            // Keep the bands that did start; the split adapts to the real size
+            pool->num_threads = i;
+            break;
+        }
+        if (pin_threads) pin_thread(pool->threads[i - 1], first_cpu + i - 1);
+    }
+    return pool;
+}
+
+void thread_pool_destroy(ThreadPool* pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i - 1], NULL);
+    }
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
+
+int thread_pool_size(const ThreadPool* pool) {
+    return pool ? pool->num_threads : 1;
+}
+
+void thread_pool_run_bands(ThreadPool* pool, int count, BandFn fn, void* user_data) {
+    if (!fn || count <= 0) return;
+    if (!pool || pool->num_threads == 1) {
+        fn(user_data, 0, count, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->count = count;
+    pool->fn = fn;
+    pool->user_data = user_data;
+    pool->pending = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    int begin, end;
+    band_range(count, pool->num_threads, 0, &begin, &end);
+    if (begin < end) fn(user_data, begin, end, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
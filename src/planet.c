@@ -0,0 +1,230 @@
+#include "planet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "map_io.h"
+#include "parallel.h"
+
+#define PLANET_PATH_MAX 4096
+
+// --- Face Geometry ---
+
+const char* cube_face_name(int face) {
+    static const char* const NAMES[CUBE_FACE_COUNT] = { "px", "nx", "py", "ny", "pz", "nz" };
+    return face >= 0 && face < CUBE_FACE_COUNT ? NAMES[face] : "?";
+}
+
+int cube_face_locate(const double* d, int size, double* x, double* y) {
+    int axis = 0;
+    for (int k = 1; k < 3; k++) {
+        if (fabs(d[k]) > fabs(d[axis])) axis = k;
+    }
+    int face = 2 * axis + (d[axis] < 0.0);
+    // The face's basis from its points, normal at (0, 0)
+    double n[3], r[3], down[3];
+    cube_face_point(face, 0.0, 0.0, n);
+    cube_face_point(face, 1.0, 0.0, r);
+    cube_face_point(face, 0.0, 1.0, down);
+    double dn = 0.0, dr = 0.0, dd = 0.0;
+    for (int k = 0; k < 3; k++) {
+        dn += d[k] * n[k];
+        dr += d[k] * (r[k] - n[k]);
+        dd += d[k] * (down[k] - n[k]);
+    }
+    *x = (atan(dr / dn) / M_PI_4 + 1.0) * 0.5 * size - 0.5;
+    *y = (atan(dd / dn) / M_PI_4 + 1.0) * 0.5 * size - 0.5;
+    return face;
+}
+
+double cube_face_latitude(int face, int size, double x, double y) {
+    double p[3];
+    cube_face_point(face, cube_face_tangent(x, size), cube_face_tangent(y, size), p);
+    double sin_latitude = fabs(p[1]) / sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    return asin(sin_latitude) / M_PI_2;
+}
+
+void mapgen_config_cube_face(MapGenConfig* config, int face, int size) {
+    config->width = size;
+    config->height = size;
+    NoiseParams* params[] = { &config->elev_params, &config->moist_params, &config->cont_params };
+    for (int i = 0; i < 3; i++) {
+        params[i]->wrap = NOISE_WRAP_CUBE_FACE;
+        params[i]->cube_face = face;
+    }
+}
+
+// --- Face Generation ---
+
+typedef struct {
+    MapGenContext* base_ctx;
+    MapGenConfig config;        // Shared settings; each worker sets its face
+    unsigned int seed;
+    int face_size;
+    const char* output_dir;
+    unsigned char* faces[CUBE_FACE_COUNT];  // RGB of each face, face_size^2 * 3 bytes
+    int next_face;      // Guarded by lock
+    int failed;         // Guarded by lock
+    pthread_mutex_t lock;
+} PlanetQueue;
+
+static int claim_face(PlanetQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    int face = queue->next_face < CUBE_FACE_COUNT ? queue->next_face++ : -1;
+    pthread_mutex_unlock(&queue->lock);
+    return face;
+}
+
+static void* planet_worker(void* arg) {
+    PlanetQueue* queue = arg;
+    MapGenContext* ctx = mapgen_context_clone(queue->base_ctx);
+    if (!ctx) {
+        // Leaves the faces to the other workers; generate_planet checks they all ran
+        mapgen_log(queue->base_ctx, MAPGEN_LOG_ERROR, "Error: Failed to create a planet worker context.\n");
+        return NULL;
+    }
+    MapGenWorkspace ws;
+    init_map_workspace(&ws);
+    size_t face_bytes = (size_t)queue->face_size * queue->face_size * 3;
+
+    int face;
+    while ((face = claim_face(queue)) >= 0) {
+        char filename[PLANET_PATH_MAX];
+        snprintf(filename, sizeof(filename), "%s/planet_%u_%s.png", queue->output_dir, queue->seed,
+                 cube_face_name(face));
+
+        MapGenConfig* config = mapgen_context_config(ctx);
+        *config = queue->config;
+        mapgen_config_cube_face(config, face, queue->face_size);
+        bool ok = generate_map(ctx, &ws, queue->seed, filename) == 0 && ws.pixels;
+        if (ok) memcpy(queue->faces[face], ws.pixels, face_bytes);
+        else {
+            mapgen_log(queue->base_ctx, MAPGEN_LOG_ERROR, "Error: planet face %s failed.\n", cube_face_name(face));
+            pthread_mutex_lock(&queue->lock);
+            queue->failed++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+
+    cleanup_map_workspace(ctx, &ws);
+    mapgen_context_destroy(ctx);
+    return NULL;
+}
+
+// --- Equirectangular Reprojection ---
+
+typedef struct {
+    unsigned char* const* faces;
+    int face_size;
+    int width, height;
+    unsigned char* pixels;
+} ReprojectJob;
+
+// Rows [begin, end): each pixel takes the color of the face cell nearest to
+// the direction of its center.
+static void reproject_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    ReprojectJob* job = user_data;
+    int size = job->face_size;
+    for (int j = begin; j < end; j++) {
+        double latitude = M_PI_2 - (j + 0.5) / job->height * M_PI;
+        double cos_lat = cos(latitude), sin_lat = sin(latitude);
+        unsigned char* row = job->pixels + (size_t)j * job->width * 3;
+        for (int i = 0; i < job->width; i++) {
+            double longitude = (i + 0.5) / job->width * 2.0 * M_PI - M_PI;
+            double d[3] = { cos_lat * sin(longitude), sin_lat, cos_lat * cos(longitude) };
+            double fx, fy;
+            int face = cube_face_locate(d, size, &fx, &fy);
+            int x = (int)lround(fx), y = (int)lround(fy);
+            x = x < 0 ? 0 : x >= size ? size - 1 : x;
+            y = y < 0 ? 0 : y >= size ? size - 1 : y;
+            memcpy(row + (size_t)i * 3, job->faces[face] + ((size_t)y * size + x) * 3, 3);
+        }
+    }
+}
+
+// --- Planet ---
+
+int generate_planet(MapGenContext* ctx, unsigned int seed, int face_size, int num_workers,
+                    const char* output_dir, const char* equirect_filename) {
+    const MapGenConfig* base = mapgen_context_config(ctx);
+    if (!base || face_size <= 0) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Planet face size must be positive.\n");
+        return 1;
+    }
+    if (!output_dir) output_dir = ".";
+    if (num_workers < 1) num_workers = 1;
+    if (num_workers > CUBE_FACE_COUNT) num_workers = CUBE_FACE_COUNT;
+
+    if (mkdir(output_dir, 0755) != 0 && errno != EEXIST) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error creating planet output directory %s\n", output_dir);
+        return 1;
+    }
+
+    PlanetQueue queue = { .base_ctx = ctx, .config = *base, .seed = seed, .face_size = face_size,
+                          .output_dir = output_dir, .next_face = 0, .failed = 0 };
+    if (queue.config.target_land_fraction > 0.0) {
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: land fraction targeting is per map; ignored for planets.\n");
+        queue.config.target_land_fraction = 0.0;
+    }
+    // The faces already run one per worker: keep each face's band threads to
+    // its share of the cores, and unpinned like the workers that drive them
+    int face_threads = online_cpu_count() / num_workers;
+    if (face_threads < 1) face_threads = 1;
+    if (queue.config.num_threads <= 0 || queue.config.num_threads > face_threads) {
+        queue.config.num_threads = face_threads;
+    }
+    queue.config.pin_threads = false;
+    size_t face_bytes = (size_t)face_size * face_size * 3;
+    int width = 4 * face_size, height = 2 * face_size;
+    unsigned char* pixels = malloc((size_t)width * height * 3);
+    bool allocated = pixels != NULL;
+    for (int f = 0; f < CUBE_FACE_COUNT; f++) {
+        queue.faces[f] = malloc(face_bytes);
+        allocated = allocated && queue.faces[f];
+    }
+    if (!allocated) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate planet face images.\n");
+        for (int f = 0; f < CUBE_FACE_COUNT; f++) free(queue.faces[f]);
+        free(pixels);
+        return 1;
+    }
+    pthread_mutex_init(&queue.lock, NULL);
+
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Generating planet %u (%d x %d faces) on %d workers into '%s'...\n",
+               seed, face_size, face_size, num_workers, output_dir);
+
+    pthread_t threads[CUBE_FACE_COUNT];
+    int started = 0;
+    for (; started < num_workers; started++) {
+        if (pthread_create(&threads[started], NULL, planet_worker, &queue) != 0) break;
+    }
+    // Fall back to running on the calling thread if no worker could start
+    if (started == 0) planet_worker(&queue);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+
+    int result = queue.failed == 0 && queue.next_face == CUBE_FACE_COUNT ? 0 : 1;
+    if (queue.next_face < CUBE_FACE_COUNT) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: %d planet faces were not generated.\n",
+                   CUBE_FACE_COUNT - queue.next_face);
+    }
+    if (result == 0 && equirect_filename) {
+        ReprojectJob job = { queue.faces, face_size, width, height, pixels };
+        mapgen_parallel_bands(ctx, height, reproject_band, &job);
+        result = write_rgb_png(ctx, pixels, width, height, equirect_filename);
+        if (result == 0) {
+            mapgen_log(ctx, MAPGEN_LOG_INFO, "Equirectangular map (%d x %d) written to %s\n",
+                       width, height, equirect_filename);
+        }
+    }
+
+    for (int f = 0; f < CUBE_FACE_COUNT; f++) free(queue.faces[f]);
+    free(pixels);
+    return result;
+}
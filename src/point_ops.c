@@ -0,0 +1,238 @@
+#include "point_ops.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "arena.h"
+
+#define POINT_BLOCK_CELLS 512           // 4 KiB of doubles per block, well inside L1
+#define POW_LUT_MIN_SIZE 256
+#define POW_LUT_MAX_SIZE (1 << 16)
+
+void point_chain_init(PointChain* chain) {
+    if (chain) chain->count = 0;
+}
+
+static bool append_op(PointChain* chain, PointOp op) {
+    if (!chain || chain->count >= POINT_CHAIN_MAX_OPS) return false;
+    chain->ops[chain->count++] = op;
+    return true;
+}
+
+bool point_chain_mask_below(PointChain* chain, double** mask, double threshold, double replacement) {
+    if (!mask) return false;
+    return append_op(chain, (PointOp){ POINT_OP_MASK_BELOW, threshold, replacement, mask });
+}
+
+bool point_chain_clamp(PointChain* chain, double lo, double hi) {
+    if (lo > hi) return false;
+    return append_op(chain, (PointOp){ POINT_OP_CLAMP, lo, hi, NULL });
+}
+
+bool point_chain_pow(PointChain* chain, double exponent, double max_error) {
+    if (exponent == 0.0) exponent = 1e-9;   // As redistribute_map always has: not a constant 1
+    return append_op(chain, (PointOp){ POINT_OP_POW, exponent, max_error, NULL });
+}
+
+bool point_chain_terrace(PointChain* chain, int levels) {
+    if (levels < 2) return false;
+    return append_op(chain, (PointOp){ POINT_OP_TERRACE, (double)(levels - 1), 0.0, NULL });
+}
+
+// --- Kernels ---
+// One loop per operation over a block; the selects compile to min/max/blend
+// instructions rather than branches.
+
+static void kernel_mask_below(double* restrict v, const double* restrict mask, int n,
+                              double threshold, double replacement) {
+    for (int i = 0; i < n; i++) {
+        v[i] = mask[i] < threshold ? replacement : v[i];
+    }
+}
+
+static void kernel_clamp(double* restrict v, int n, double lo, double hi) {
+    for (int i = 0; i < n; i++) {
+        double x = v[i] < lo ? lo : v[i];
+        v[i] = x > hi ? hi : x;
+    }
+}
+
+// Terraced values are clamped to [0, 1], so the scaled value can be clamped to
+// [0, levels - 1] first; it is then non-negative and round() reduces to a
+// truncating conversion of t + 0.5.
+static void kernel_terrace(double* restrict v, int n, double levels_minus_one) {
+    for (int i = 0; i < n; i++) {
+        double t = v[i] * levels_minus_one;
+        t = t < 0.0 ? 0.0 : t;
+        t = t > levels_minus_one ? levels_minus_one : t;
+        v[i] = (double)(int)(t + 0.5) / levels_minus_one;
+    }
+}
+
+static void kernel_pow_exact(double* restrict v, int n, double exponent) {
+    for (int i = 0; i < n; i++) {
+        v[i] = pow(v[i], exponent);
+    }
+}
+
+// Linear interpolation in a table of x^exponent sampled at i / size, i = 0..size.
+static void kernel_pow_lut(double* restrict v, int n, double exponent,
+                           const double* restrict lut, int size) {
+    bool outside = false;
+    for (int i = 0; i < n; i++) {
+        outside |= !(v[i] >= 0.0 && v[i] <= 1.0);
+    }
+    if (outside) {
+        kernel_pow_exact(v, n, exponent);
+        return;
+    }
+    double scale = (double)size;
+    for (int i = 0; i < n; i++) {
+        double t = v[i] * scale;
+        int k = (int)t;
+        k = k < size - 1 ? k : size - 1;
+        double frac = t - k;
+        v[i] = lut[k] + (lut[k + 1] - lut[k]) * frac;
+    }
+}
+
+// Worst interpolation error of a size-entry table, checked at the quarter
+// points of every interval and densely inside the first one, where x^p with
+// p < 2 is steepest relative to the table spacing.
+static double pow_lut_error(const double* lut, int size, double exponent) {
+    double worst = 0.0;
+    for (int k = 0; k < size; k++) {
+        int steps = k == 0 ? 64 : 4;
+        for (int s = 1; s < steps; s++) {
+            double frac = (double)s / steps;
+            double x = (k + frac) / size;
+            double err = fabs(lut[k] + (lut[k + 1] - lut[k]) * frac - pow(x, exponent));
+            if (err > worst) worst = err;
+        }
+    }
+    return worst;
+}
+
+// Smallest power-of-two table meeting max_error, or NULL to fall back to pow().
+static double* build_pow_lut(Arena* arena, double exponent, double max_error,
+                             int* size_out, double* error_out) {
+    if (exponent <= 0.0 || max_error <= 0.0) return NULL;
+    for (int size = POW_LUT_MIN_SIZE; size <= POW_LUT_MAX_SIZE; size *= 2) {
+        double* lut = scratch_alloc(arena, (size_t)(size + 1) * sizeof(double));
+        if (!lut) return NULL;
+        for (int k = 0; k <= size; k++) {
+            lut[k] = pow((double)k / size, exponent);
+        }
+        double err = pow_lut_error(lut, size, exponent);
+        if (err <= max_error) {
+            *size_out = size;
+            *error_out = err;
+            return lut;
+        }
+        scratch_free(arena, lut);
+    }
+    return NULL;
+}
+
+void point_chain_build_tables(MapGenContext* ctx, const PointChain* chain, PointChainTables* tables) {
+    *tables = (PointChainTables){ 0 };
+    if (!chain) return;
+    Arena* arena = mapgen_context_arena(ctx);
+    for (int o = 0; o < chain->count; o++) {
+        const PointOp* op = &chain->ops[o];
+        if (op->type != POINT_OP_POW || op->b <= 0.0) continue;
+        double err = 0.0;
+        tables->luts[o] = build_pow_lut(arena, op->a, op->b, &tables->lut_sizes[o], &err);
+        if (tables->luts[o]) {
+            mapgen_log(ctx, MAPGEN_LOG_INFO, "--> pow(x, %.2f): %d-entry table, measured error %.2e\n",
+                       op->a, tables->lut_sizes[o], err);
+        } else {
+            mapgen_log(ctx, MAPGEN_LOG_INFO, "--> pow(x, %.2f): no table within %.2e, using pow()\n",
+                       op->a, op->b);
+        }
+    }
+}
+
+void point_chain_free_tables(MapGenContext* ctx, PointChainTables* tables) {
+    Arena* arena = mapgen_context_arena(ctx);
+    for (int o = POINT_CHAIN_MAX_OPS - 1; o >= 0; o--) {
+        scratch_free(arena, tables->luts[o]);
+        tables->luts[o] = NULL;
+    }
+}
+
+// The pow step of op o, through its table if there is one.
+static inline void apply_pow(const PointOp* op, const PointChainTables* tables, int o, double* v, int n) {
+    if (tables && tables->luts[o]) kernel_pow_lut(v, n, op->a, tables->luts[o], tables->lut_sizes[o]);
+    else kernel_pow_exact(v, n, op->a);
+}
+
+double point_chain_eval(const PointChain* chain, const PointChainTables* tables, double value) {
+    if (!chain) return value;
+    for (int o = 0; o < chain->count; o++) {
+        const PointOp* op = &chain->ops[o];
+        switch (op->type) {
+            case POINT_OP_MASK_BELOW: break;
+            case POINT_OP_CLAMP: kernel_clamp(&value, 1, op->a, op->b); break;
+            case POINT_OP_POW: apply_pow(op, tables, o, &value, 1); break;
+            case POINT_OP_TERRACE: kernel_terrace(&value, 1, op->a); break;
+        }
+    }
+    return value;
+}
+
+typedef struct {
+    const PointChain* chain;
+    double** layer;
+    int width;
+    PointChainTables tables;
+} PointChainJob;
+
+static void point_chain_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    const PointChainJob* job = user_data;
+
+    // Row by row, so layers whose rows are allocated separately work too
+    for (int y = begin; y < end; y++) {
+        for (int start = 0; start < job->width; start += POINT_BLOCK_CELLS) {
+            int n = job->width - start < POINT_BLOCK_CELLS ? job->width - start : POINT_BLOCK_CELLS;
+            double* v = job->layer[y] + start;
+            for (int o = 0; o < job->chain->count; o++) {
+                const PointOp* op = &job->chain->ops[o];
+                switch (op->type) {
+                    case POINT_OP_MASK_BELOW:
+                        kernel_mask_below(v, op->mask[y] + start, n, op->a, op->b);
+                        break;
+                    case POINT_OP_CLAMP:
+                        kernel_clamp(v, n, op->a, op->b);
+                        break;
+                    case POINT_OP_POW:
+                        apply_pow(op, &job->tables, o, v, n);
+                        break;
+                    case POINT_OP_TERRACE:
+                        kernel_terrace(v, n, op->a);
+                        break;
+                }
+            }
+        }
+    }
+}
+
+void point_chain_apply(MapGenContext* ctx, const PointChain* chain,
+                       double** layer, int width, int height) {
+    if (!chain || !layer || width <= 0 || height <= 0) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Invalid point chain, layer, or dimensions.\n");
+        return;
+    }
+    if (chain->count == 0) return;
+
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    PointChainJob job = { .chain = chain, .layer = layer, .width = width };
+    point_chain_build_tables(ctx, chain, &job.tables);
+
+    mapgen_parallel_bands(ctx, height, point_chain_band, &job);
+
+    point_chain_free_tables(ctx, &job.tables);
+    arena_release(arena, mark);
+}
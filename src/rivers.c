@@ -0,0 +1,191 @@
+#include "rivers.h"
+#include <math.h>
+
+bool map_reserve_river_paths(MapGenContext* ctx, MapData* map, int num_rivers, int max_length) {
+    if (!map || num_rivers < 0 || max_length < 1) return false;
+    size_t slots = (size_t)num_rivers * max_length;
+    if (!map->river_paths || (size_t)map->river_path_count * map->river_path_stride < slots) {
+        scratch_free(map->arena, map->river_paths);
+        map->river_paths = scratch_alloc(map->arena, (slots + 1) * sizeof(int32_t));
+        if (!map->river_paths) {
+            mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error allocating river paths\n");
+            map->river_path_count = 0;
+            map->river_path_stride = 0;
+            return false;
+        }
+    }
+    map->river_path_count = num_rivers;
+    map->river_path_stride = max_length;
+    for (size_t i = 0; i < slots; i++) map->river_paths[i] = -1;
+    map_drop_river_network(map);
+    return true;
+}
+
+void map_drop_river_network(MapData* map) {
+    if (!map || !map->river_network) return;
+    scratch_free(map->arena, map->river_network->rivers);
+    scratch_free(map->arena, map->river_network->vertices);
+    scratch_free(map->arena, map->river_network);
+    map->river_network = NULL;
+}
+
+// Marks in keep the vertices of path[0..n) that Douglas-Peucker retains.
+// stack holds up to 2 * n ints.
+static void simplify_path(const int32_t* path, int n, int width, double tolerance, bool* keep, int* stack) {
+    for (int i = 0; i < n; i++) keep[i] = false;
+    keep[0] = true;
+    keep[n - 1] = true;
+    double tolerance_sq = tolerance * tolerance;
+    int top = 0;
+    if (n > 2) {
+        stack[top++] = 0;
+        stack[top++] = n - 1;
+    }
+    while (top > 0) {
+        int b = stack[--top];
+        int a = stack[--top];
+        double ax = path[a] % width, ay = path[a] / width;
+        double dx = path[b] % width - ax, dy = path[b] / width - ay;
+        double chord_sq = dx * dx + dy * dy;
+        int farthest = -1;
+        double worst = 0.0;
+        for (int i = a + 1; i < b; i++) {
+            double cross = dx * (path[i] / width - ay) - dy * (path[i] % width - ax);
+            if (cross * cross > worst) {
+                worst = cross * cross;
+                farthest = i;
+            }
+        }
+        // Distance to the chord is |cross| / |chord|
+        if (farthest < 0 || worst <= tolerance_sq * chord_sq) continue;
+        keep[farthest] = true;
+        if (farthest - a > 1) {
+            stack[top++] = a;
+            stack[top++] = farthest;
+        }
+        if (b - farthest > 1) {
+            stack[top++] = farthest;
+            stack[top++] = b;
+        }
+    }
+}
+
+bool build_river_network(MapGenContext* ctx, const MapData* map, double tolerance,
+                         Arena* arena, RiverNetwork* out) {
+    if (!map || !map->river_paths || !out) return false;
+    int width = map->width;
+    int stride = map->river_path_stride;
+    long long total_cells = 0;
+    int paths = 0;
+    for (int r = 0; r < map->river_path_count; r++) {
+        const int32_t* path = map->river_paths + (size_t)r * stride;
+        if (path[0] < 0) continue;
+        paths++;
+        for (int j = 0; j < stride && path[j] >= 0; j++) total_cells++;
+    }
+
+    out->count = 0;
+    out->vertex_count = 0;
+    out->tolerance = tolerance;
+    out->rivers = scratch_alloc(arena, ((size_t)paths + 1) * sizeof(RiverPolyline));
+    out->vertices = scratch_alloc(arena, ((size_t)total_cells + 1) * sizeof(RiverVertex));
+    Arena* scratch = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(scratch);
+    // River id + 1 of each cell already on a river, 0 elsewhere
+    int32_t* owner = scratch_calloc(scratch, (size_t)width * map->height, sizeof(int32_t));
+    bool* keep = scratch_alloc(scratch, (size_t)stride * sizeof(bool));
+    int* stack = scratch_alloc(scratch, (size_t)stride * 2 * sizeof(int));
+    int* top_order = scratch_alloc(scratch, ((size_t)paths + 1) * sizeof(int));
+    int* top_count = scratch_alloc(scratch, ((size_t)paths + 1) * sizeof(int));
+
+    bool ok = out->rivers && out->vertices && owner && keep && stack && top_order && top_count;
+    for (int slot = 0; ok && slot < map->river_path_count; slot++) {
+        const int32_t* path = map->river_paths + (size_t)slot * stride;
+        if (path[0] < 0 || owner[path[0]]) continue;    // Empty, or starts on an earlier river
+
+        int id = out->count;
+        RiverPolyline* river = &out->rivers[id];
+        river->joins = -1;
+        river->length = 0.0;
+        int n = 0;
+        for (; n < stride && path[n] >= 0; n++) {
+            if (n > 0) {
+                bool diagonal = path[n] % width != path[n - 1] % width && path[n] / width != path[n - 1] / width;
+                river->length += diagonal ? M_SQRT2 : 1.0;
+            }
+            if (owner[path[n]]) {
+                river->joins = owner[path[n]] - 1;
+                n++;
+                break;
+            }
+            owner[path[n]] = id + 1;
+        }
+
+        simplify_path(path, n, width, tolerance, keep, stack);
+        river->first = out->vertex_count;
+        river->cells = n;
+        for (int j = 0; j < n; j++) {
+            if (!keep[j]) continue;
+            out->vertices[out->vertex_count++] = (RiverVertex){ path[j] % width, path[j] / width };
+        }
+        river->count = out->vertex_count - river->first;
+        top_order[id] = 1;      // The river's own headwater
+        top_count[id] = 1;
+        out->count++;
+    }
+
+    // Tributaries always join earlier rivers, so walking backwards settles
+    // every tributary before the river it flows into.
+    for (int id = out->count - 1; ok && id >= 0; id--) {
+        RiverPolyline* river = &out->rivers[id];
+        river->order = top_order[id] + (top_count[id] >= 2);
+        int into = river->joins;
+        if (into < 0) continue;
+        if (river->order > top_order[into]) {
+            top_order[into] = river->order;
+            top_count[into] = 1;
+        } else if (river->order == top_order[into]) {
+            top_count[into]++;
+        }
+    }
+
+    if (!ok) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate river network scratch.\n");
+        scratch_free(arena, out->rivers);
+        scratch_free(arena, out->vertices);
+        out->rivers = NULL;
+        out->vertices = NULL;
+        out->count = 0;
+        out->vertex_count = 0;
+    }
+    scratch_free(scratch, top_count);
+    scratch_free(scratch, top_order);
+    scratch_free(scratch, stack);
+    scratch_free(scratch, keep);
+    scratch_free(scratch, owner);
+    arena_release(scratch, mark);
+    return ok;
+}
+
+const RiverNetwork* map_river_network(MapGenContext* ctx, MapData* map, double tolerance) {
+    if (!map || !map->river_paths) return NULL;
+    RiverNetwork* network = map->river_network;
+    if (network && network->tolerance == tolerance) return network;
+    map_drop_river_network(map);
+
+    network = scratch_alloc(map->arena, sizeof(RiverNetwork));
+    if (!network || !build_river_network(ctx, map, tolerance, map->arena, network)) {
+        scratch_free(map->arena, network);
+        return NULL;
+    }
+    map->river_network = network;
+
+    int cells = 0, confluences = 0;
+    for (int r = 0; r < network->count; r++) {
+        cells += network->rivers[r].cells;
+        confluences += network->rivers[r].joins >= 0;
+    }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "River network: %d rivers, %d confluences, %d vertices for %d cells (tolerance %.2f).\n",
+               network->count, confluences, network->vertex_count, cells, tolerance);
+    return network;
+}
@@ -0,0 +1,391 @@
+#include "stage_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "rng.h"
+
+#define STAGE_CACHE_MAX_LAYERS 8
+#define STAGE_CACHE_PATH_MAX 4096
+static const char STAGE_CACHE_MAGIC[8] = { 'M', 'G', 'S', 'T', 'A', 'G', 'E', '1' };
+
+struct StageCacheEntry {
+    StageCacheEntry* next;
+    uint64_t key;
+    int pins;
+    unsigned long long last_use;
+    int count;
+    unsigned ids[STAGE_CACHE_MAX_LAYERS];
+    size_t sizes[STAGE_CACHE_MAX_LAYERS];
+    size_t total;
+    unsigned char* data;        // Layers back to back, in ids order
+};
+
+struct StageCache {
+    pthread_mutex_t lock;
+    StageCacheEntry* head;
+    size_t memory_limit;
+    size_t memory_used;
+    unsigned long long clock;   // Bumped on every use, for LRU and temp names
+    char* directory;
+    size_t disk_limit;          // Bytes of files kept in directory, 0 = unlimited
+};
+
+// --- Hashing ---
+
+uint64_t stage_hash_u64(uint64_t hash, uint64_t value) {
+    return rng_mix64(hash ^ rng_mix64(value + 0x9E3779B97F4A7C15ull));
+}
+
+uint64_t stage_hash_double(uint64_t hash, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return stage_hash_u64(hash, bits);
+}
+
+uint64_t stage_hash_string(uint64_t hash, const char* text) {
+    uint64_t fnv = 0xCBF29CE484222325ull;     // FNV-1a
+    for (const char* c = text ? text : ""; *c; c++) {
+        fnv = (fnv ^ (unsigned char)*c) * 0x100000001B3ull;
+    }
+    return stage_hash_u64(hash, fnv);
+}
+
+// --- Entries ---
+
+static void free_entry(StageCacheEntry* entry) {
+    if (!entry) return;
+    free(entry->data);
+    free(entry);
+}
+
+static StageCacheEntry* new_entry(uint64_t key, const unsigned* ids, const size_t* sizes, int count) {
+    if (count < 0 || count > STAGE_CACHE_MAX_LAYERS) return NULL;
+    StageCacheEntry* entry = calloc(1, sizeof(StageCacheEntry));
+    if (!entry) return NULL;
+    entry->key = key;
+    entry->count = count;
+    for (int i = 0; i < count; i++) {
+        entry->ids[i] = ids[i];
+        entry->sizes[i] = sizes[i];
+        entry->total += sizes[i];
+    }
+    entry->data = malloc(entry->total ? entry->total : 1);
+    if (!entry->data) {
+        free(entry);
+        return NULL;
+    }
+    return entry;
+}
+
+// Drops unpinned entries, oldest first, until the budget is met. Lock held.
+static void evict_to_limit(StageCache* cache) {
+    while (cache->memory_used > cache->memory_limit) {
+        StageCacheEntry** oldest = NULL;
+        for (StageCacheEntry** link = &cache->head; *link; link = &(*link)->next) {
+            if ((*link)->pins == 0 && (!oldest || (*link)->last_use < (*oldest)->last_use)) oldest = link;
+        }
+        if (!oldest) return;
+        StageCacheEntry* victim = *oldest;
+        *oldest = victim->next;
+        cache->memory_used -= victim->total;
+        free_entry(victim);
+    }
+}
+
+static void insert_entry(StageCache* cache, StageCacheEntry* entry) {
+    entry->last_use = ++cache->clock;
+    entry->next = cache->head;
+    cache->head = entry;
+    cache->memory_used += entry->total;
+}
+
+// --- Files ---
+
+// File I/O runs without the cache lock, so callers pass a copy of the
+// directory taken under it.
+
+static void entry_path(const char* directory, uint64_t key, char* path, size_t size) {
+    snprintf(path, size, "%s/stage_%016llx.bin", directory, (unsigned long long)key);
+}
+
+static StageCacheEntry* read_entry_file(const char* directory, uint64_t key) {
+    char path[STAGE_CACHE_PATH_MAX];
+    entry_path(directory, key, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    char magic[sizeof(STAGE_CACHE_MAGIC)];
+    uint64_t stored_key = 0;
+    uint32_t count = 0;
+    unsigned ids[STAGE_CACHE_MAX_LAYERS];
+    size_t sizes[STAGE_CACHE_MAX_LAYERS];
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1
+           && memcmp(magic, STAGE_CACHE_MAGIC, sizeof(magic)) == 0
+           && fread(&stored_key, sizeof(stored_key), 1, file) == 1 && stored_key == key
+           && fread(&count, sizeof(count), 1, file) == 1 && count <= STAGE_CACHE_MAX_LAYERS;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        uint32_t id = 0;
+        uint64_t bytes = 0;
+        ok = fread(&id, sizeof(id), 1, file) == 1 && fread(&bytes, sizeof(bytes), 1, file) == 1;
+        ids[i] = id;
+        sizes[i] = (size_t)bytes;
+    }
+
+    StageCacheEntry* entry = ok ? new_entry(key, ids, sizes, (int)count) : NULL;
+    if (entry && entry->total > 0 && fread(entry->data, entry->total, 1, file) != 1) {
+        free_entry(entry);
+        entry = NULL;
+    }
+    fclose(file);
+    // The modification time is the file's last use, for trim_directory
+    if (entry) utimensat(AT_FDCWD, path, NULL, 0);
+    return entry;
+}
+
+static bool write_entry_file(MapGenContext* ctx, const char* directory, const StageCacheEntry* entry,
+                             unsigned long long serial) {
+    char path[STAGE_CACHE_PATH_MAX];
+    char temp_path[STAGE_CACHE_PATH_MAX + 64];
+    entry_path(directory, entry->key, path, sizeof(path));
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld.%llu.tmp", path, (long)getpid(), serial);
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Cannot write stage cache file %s\n", temp_path);
+        return false;
+    }
+    uint32_t count = (uint32_t)entry->count;
+    bool ok = fwrite(STAGE_CACHE_MAGIC, sizeof(STAGE_CACHE_MAGIC), 1, file) == 1
+           && fwrite(&entry->key, sizeof(entry->key), 1, file) == 1
+           && fwrite(&count, sizeof(count), 1, file) == 1;
+    for (int i = 0; ok && i < entry->count; i++) {
+        uint32_t id = entry->ids[i];
+        uint64_t bytes = entry->sizes[i];
+        ok = fwrite(&id, sizeof(id), 1, file) == 1 && fwrite(&bytes, sizeof(bytes), 1, file) == 1;
+    }
+    if (ok && entry->total > 0) ok = fwrite(entry->data, entry->total, 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    if (ok) ok = rename(temp_path, path) == 0;
+    if (!ok) {
+        remove(temp_path);
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Failed to write stage cache file %s\n", path);
+    }
+    return ok;
+}
+
+typedef struct {
+    time_t last_use;
+    off_t bytes;
+    char name[64];
+} CacheFile;
+
+static int compare_last_use(const void* a, const void* b) {
+    const CacheFile* fa = a;
+    const CacheFile* fb = b;
+    return (fa->last_use > fb->last_use) - (fa->last_use < fb->last_use);
+}
+
+// Deletes the least recently used entry files until the directory holds at
+// most limit bytes of them. Files another process removes first are skipped.
+static void trim_directory(MapGenContext* ctx, const char* directory, size_t limit) {
+    DIR* dir = opendir(directory);
+    if (!dir) return;
+    CacheFile* files = NULL;
+    size_t count = 0, capacity = 0, total = 0;
+    struct dirent* item;
+    while ((item = readdir(dir)) != NULL) {
+        size_t len = strlen(item->d_name);
+        if (strncmp(item->d_name, "stage_", 6) != 0 || len < 4 || len >= sizeof(files->name)
+            || strcmp(item->d_name + len - 4, ".bin") != 0) continue;
+        char path[STAGE_CACHE_PATH_MAX];
+        struct stat info;
+        snprintf(path, sizeof(path), "%s/%s", directory, item->d_name);
+        if (stat(path, &info) != 0) continue;
+        if (count == capacity) {
+            size_t grown = capacity ? capacity * 2 : 64;
+            CacheFile* larger = realloc(files, grown * sizeof(CacheFile));
+            if (!larger) break;
+            files = larger;
+            capacity = grown;
+        }
+        files[count].last_use = info.st_mtime;
+        files[count].bytes = info.st_size;
+        memcpy(files[count].name, item->d_name, len + 1);
+        total += (size_t)info.st_size;
+        count++;
+    }
+    closedir(dir);
+
+    if (total > limit) {
+        qsort(files, count, sizeof(CacheFile), compare_last_use);
+        size_t removed = 0;
+        for (size_t i = 0; i < count && total > limit; i++) {
+            char path[STAGE_CACHE_PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", directory, files[i].name);
+            if (remove(path) == 0) {
+                total -= (size_t)files[i].bytes;
+                removed++;
+            }
+        }
+        mapgen_log(ctx, MAPGEN_LOG_DEBUG, "Stage cache: removed %zu files from %s\n", removed, directory);
+    }
+    free(files);
+}
+
+// --- Cache ---
+
+StageCache* stage_cache_create(void) {
+    StageCache* cache = calloc(1, sizeof(StageCache));
+    if (!cache) return NULL;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void stage_cache_destroy(StageCache* cache) {
+    if (!cache) return;
+    while (cache->head) {
+        StageCacheEntry* next = cache->head->next;
+        free_entry(cache->head);
+        cache->head = next;
+    }
+    free(cache->directory);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+void stage_cache_configure(StageCache* cache, size_t memory_limit, const char* directory, size_t disk_limit) {
+    if (!cache) return;
+    pthread_mutex_lock(&cache->lock);
+    cache->memory_limit = memory_limit;
+    cache->disk_limit = disk_limit;
+    if (!directory || !cache->directory || strcmp(directory, cache->directory) != 0) {
+        free(cache->directory);
+        cache->directory = directory ? strdup(directory) : NULL;
+        if (cache->directory && mkdir(cache->directory, 0755) != 0 && errno != EEXIST) {
+            free(cache->directory);
+            cache->directory = NULL;
+        }
+    }
+    evict_to_limit(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+bool stage_cache_enabled(StageCache* cache) {
+    if (!cache) return false;
+    pthread_mutex_lock(&cache->lock);
+    bool enabled = cache->memory_limit > 0 || cache->directory;
+    pthread_mutex_unlock(&cache->lock);
+    return enabled;
+}
+
+// malloc'd copy of the cache directory (lock held); NULL without one.
+static char* copy_directory(const StageCache* cache) {
+    return cache->directory ? strdup(cache->directory) : NULL;
+}
+
+static StageCacheEntry* find_entry(StageCache* cache, uint64_t key) {
+    StageCacheEntry* entry = cache->head;
+    while (entry && entry->key != key) entry = entry->next;
+    return entry;
+}
+
+StageCacheEntry* stage_cache_acquire(MapGenContext* ctx, StageCache* cache, uint64_t key) {
+    if (!stage_cache_enabled(cache)) return NULL;
+    pthread_mutex_lock(&cache->lock);
+    StageCacheEntry* entry = find_entry(cache, key);
+    char* directory = entry ? NULL : copy_directory(cache);
+    pthread_mutex_unlock(&cache->lock);
+
+    // Read the file unlocked; another thread may load the same key meanwhile
+    StageCacheEntry* loaded = directory ? read_entry_file(directory, key) : NULL;
+    free(directory);
+
+    pthread_mutex_lock(&cache->lock);
+    if (!entry) entry = find_entry(cache, key);
+    if (!entry && loaded) {
+        entry = loaded;
+        loaded = NULL;
+        insert_entry(cache, entry);
+        mapgen_log(ctx, MAPGEN_LOG_DEBUG, "Stage cache: loaded %016llx from disk\n", (unsigned long long)key);
+    }
+    if (entry) {
+        entry->pins++;
+        entry->last_use = ++cache->clock;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    free_entry(loaded);
+    return entry;
+}
+
+bool stage_cache_restore(const StageCacheEntry* entry, const CachedLayer* layers, int count) {
+    if (!entry) return false;
+    for (int i = 0; i < count; i++) {
+        size_t offset = 0;
+        int found = -1;
+        for (int e = 0; e < entry->count && found < 0; e++) {
+            if (entry->ids[e] == layers[i].id) found = e;
+            else offset += entry->sizes[e];
+        }
+        if (found < 0 || entry->sizes[found] != layers[i].bytes) return false;
+        memcpy(layers[i].data, entry->data + offset, layers[i].bytes);
+    }
+    return true;
+}
+
+void stage_cache_release(StageCache* cache, StageCacheEntry* entry) {
+    if (!cache || !entry) return;
+    pthread_mutex_lock(&cache->lock);
+    entry->pins--;
+    evict_to_limit(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void stage_cache_store(MapGenContext* ctx, StageCache* cache, uint64_t key,
+                       const CachedLayer* layers, int count) {
+    if (!stage_cache_enabled(cache) || count < 0 || count > STAGE_CACHE_MAX_LAYERS) return;
+    unsigned ids[STAGE_CACHE_MAX_LAYERS] = { 0 };
+    size_t sizes[STAGE_CACHE_MAX_LAYERS] = { 0 };
+    for (int i = 0; i < count; i++) {
+        ids[i] = layers[i].id;
+        sizes[i] = layers[i].bytes;
+    }
+    StageCacheEntry* entry = new_entry(key, ids, sizes, count);
+    if (!entry) {
+        mapgen_log(ctx, MAPGEN_LOG_WARN, "Warning: Out of memory snapshotting stage outputs.\n");
+        return;
+    }
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(entry->data + offset, layers[i].data, layers[i].bytes);
+        offset += layers[i].bytes;
+    }
+
+    // The entry is not shared until it is inserted, so the file is written
+    // from it without the lock
+    pthread_mutex_lock(&cache->lock);
+    unsigned long long serial = ++cache->clock;
+    char* directory = copy_directory(cache);
+    size_t disk_limit = cache->disk_limit;
+    pthread_mutex_unlock(&cache->lock);
+    if (directory && write_entry_file(ctx, directory, entry, serial) && disk_limit > 0) {
+        trim_directory(ctx, directory, disk_limit);
+    }
+    free(directory);
+
+    pthread_mutex_lock(&cache->lock);
+    StageCacheEntry* existing = find_entry(cache, key);
+    if (existing) {
+        free_entry(entry);
+    } else {
+        insert_entry(cache, entry);
+        evict_to_limit(cache);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
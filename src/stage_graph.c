@@ -0,0 +1,284 @@
+#include "stage_graph.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "map_pipeline.h"
+
+// What stage_graph_run does with each stage when a cache is attached.
+typedef struct {
+    bool cacheable;             // Key is meaningful (all touched layers versioned)
+    uint64_t key;
+    StageCacheEntry* hit;       // Pinned cached outputs, NULL on a miss
+    bool restore;               // Hit whose outputs are needed later
+} StagePlan;
+
+typedef struct {
+    const StageGraph* graph;
+    const StagePlan* plan;
+    uint32_t deps[STAGE_GRAPH_MAX_STAGES];  // Bit i: stage i must finish first
+    uint32_t all;
+    uint32_t started;                       // Guarded by lock, like the rest
+    uint32_t done;
+    int running;
+    bool failed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} StageRun;
+
+typedef struct {
+    StageRun* run;
+    MapGenContext* ctx;
+    int lane;
+    pthread_t thread;
+} StageLane;
+
+void stage_graph_init(StageGraph* graph) {
+    if (!graph) return;
+    graph->count = 0;
+    graph->cache = NULL;
+    graph->base_hash = 0;
+    for (int l = 0; l < STAGE_GRAPH_MAX_LAYERS; l++) graph->layers[l] = (CachedLayer){ 1u << l, NULL, 0 };
+}
+
+int stage_graph_add(StageGraph* graph, const char* name, unsigned inputs, unsigned outputs,
+                    unsigned flags, StageFn fn, void* user_data) {
+    if (!graph || !fn || graph->count >= STAGE_GRAPH_MAX_STAGES) return -1;
+    graph->stages[graph->count] = (Stage){ name, inputs, outputs, flags & ~STAGE_CACHEABLE, fn, user_data, 0 };
+    return graph->count++;
+}
+
+void stage_graph_set_key(StageGraph* graph, int index, uint64_t param_hash) {
+    if (!graph || index < 0 || index >= graph->count) return;
+    graph->stages[index].flags |= STAGE_CACHEABLE;
+    graph->stages[index].param_hash = param_hash;
+}
+
+void stage_graph_bind_layer(StageGraph* graph, unsigned layer, void* data, size_t bytes) {
+    if (!graph || layer == 0) return;
+    int l = __builtin_ctz(layer);
+    if (l < STAGE_GRAPH_MAX_LAYERS) graph->layers[l] = (CachedLayer){ layer, data, bytes };
+}
+
+void stage_graph_set_cache(StageGraph* graph, StageCache* cache, uint64_t base_hash) {
+    if (!graph) return;
+    graph->cache = cache;
+    graph->base_hash = base_hash;
+}
+
+// Bound layers of mask, for snapshots; returns false if one is unbound.
+static bool collect_layers(const StageGraph* graph, unsigned mask, CachedLayer* out, int* count) {
+    *count = 0;
+    for (int l = 0; l < STAGE_GRAPH_MAX_LAYERS; l++) {
+        if (!(mask & (1u << l))) continue;
+        if (!graph->layers[l].data) return false;
+        out[(*count)++] = graph->layers[l];
+    }
+    return mask < (1u << STAGE_GRAPH_MAX_LAYERS);
+}
+
+// Keys every cacheable stage in declaration order (which any schedule
+// respects), looks them up, then walks backwards to find which hits must be
+// restored: those whose outputs are read by a stage that runs, or are final.
+static int plan_stages(MapGenContext* ctx, const StageGraph* graph, StagePlan* plan) {
+    uint64_t versions[STAGE_GRAPH_MAX_LAYERS];
+    bool known[STAGE_GRAPH_MAX_LAYERS];
+    for (int l = 0; l < STAGE_GRAPH_MAX_LAYERS; l++) {
+        versions[l] = graph->base_hash;
+        known[l] = true;
+    }
+
+    int hits = 0;
+    for (int s = 0; s < graph->count; s++) {
+        const Stage* stage = &graph->stages[s];
+        unsigned touched = stage->inputs | stage->outputs;
+        CachedLayer outputs[STAGE_GRAPH_MAX_LAYERS];
+        int output_count = 0;
+        plan[s] = (StagePlan){ .cacheable = (stage->flags & STAGE_CACHEABLE)
+                                            && collect_layers(graph, stage->outputs, outputs, &output_count) };
+        uint64_t key = stage->param_hash;
+        for (int l = 0; l < STAGE_GRAPH_MAX_LAYERS; l++) {
+            if (!(touched & (1u << l))) continue;
+            if (!known[l]) plan[s].cacheable = false;
+            key = stage_hash_u64(key, versions[l]);
+        }
+        // Outputs of a stage that is not memoized have no reproducible version
+        for (int l = 0; l < STAGE_GRAPH_MAX_LAYERS; l++) {
+            if (!(stage->outputs & (1u << l))) continue;
+            versions[l] = key;
+            known[l] = plan[s].cacheable;
+        }
+        if (plan[s].cacheable) {
+            plan[s].key = key;
+            plan[s].hit = stage_cache_acquire(ctx, graph->cache, key);
+            if (plan[s].hit) hits++;
+        }
+    }
+
+    unsigned needed = ~0u;      // Every layer's final contents are needed
+    for (int s = graph->count - 1; s >= 0; s--) {
+        const Stage* stage = &graph->stages[s];
+        if (plan[s].hit) {
+            plan[s].restore = (stage->outputs & needed) != 0;
+            needed &= ~stage->outputs;
+        } else {
+            needed = (needed & ~stage->outputs) | stage->inputs;
+        }
+    }
+    return hits;
+}
+
+static double elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static int run_stage(MapGenContext* ctx, const StageGraph* graph, const StagePlan* plan, int s, int lane) {
+    const Stage* stage = &graph->stages[s];
+    CachedLayer outputs[STAGE_GRAPH_MAX_LAYERS];
+    int output_count = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (plan && plan[s].hit) {
+        const char* how = "skipped, overwritten by later cached stages";
+        if (plan[s].restore) {
+            collect_layers(graph, stage->outputs, outputs, &output_count);
+            if (!stage_cache_restore(plan[s].hit, outputs, output_count)) {
+                mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Cached outputs of stage %s do not match the layers.\n",
+                           stage->name);
+                return 1;
+            }
+            how = "restored from cache";
+        }
+        mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Stage %s: %.2f ms (lane %d, %s)\n",
+                   stage->name, elapsed_ms(&start), lane, how);
+        return 0;
+    }
+
+    int result = stage->fn(ctx, stage->user_data);
+    if (result == 0 && plan && plan[s].cacheable) {
+        collect_layers(graph, stage->outputs, outputs, &output_count);
+        stage_cache_store(ctx, graph->cache, plan[s].key, outputs, output_count);
+    }
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "--> Stage %s: %.2f ms (lane %d)%s\n",
+               stage->name, elapsed_ms(&start), lane, result != 0 ? " FAILED" : "");
+    return result;
+}
+
+// Next stage lane may start, or -1. Lane 0 prefers pool stages, since only it
+// can run them; helpers never take them. Called with the lock held.
+static int pick_stage(const StageRun* run, int lane) {
+    int fallback = -1;
+    for (int s = 0; s < run->graph->count; s++) {
+        uint32_t bit = 1u << s;
+        if ((run->started & bit) || (run->deps[s] & ~run->done)) continue;
+        bool pooled = run->graph->stages[s].flags & STAGE_USES_POOL;
+        if (lane == 0 && pooled) return s;
+        if (!pooled && fallback < 0) fallback = s;
+    }
+    return fallback;
+}
+
+static void lane_loop(StageLane* lane) {
+    StageRun* run = lane->run;
+    pthread_mutex_lock(&run->lock);
+    for (;;) {
+        int s = run->failed ? -1 : pick_stage(run, lane->lane);
+        if (s >= 0) {
+            run->started |= 1u << s;
+            run->running++;
+            pthread_mutex_unlock(&run->lock);
+
+            int result = run_stage(lane->ctx, run->graph, run->plan, s, lane->lane);
+
+            pthread_mutex_lock(&run->lock);
+            run->done |= 1u << s;
+            run->running--;
+            if (result != 0) run->failed = true;
+            pthread_cond_broadcast(&run->changed);
+            continue;
+        }
+        // Helpers leave once nothing is left to start; lane 0 also waits for
+        // the stages still running elsewhere.
+        bool nothing_to_start = run->failed || run->started == run->all;
+        if (nothing_to_start && (lane->lane != 0 || run->running == 0)) break;
+        pthread_cond_wait(&run->changed, &run->lock);
+    }
+    pthread_mutex_unlock(&run->lock);
+}
+
+static void* lane_main(void* arg) {
+    lane_loop(arg);
+    return NULL;
+}
+
+// Runs the graph with the given plan (NULL when nothing is cached).
+static int run_graph(MapGenContext* ctx, const StageGraph* graph, const StagePlan* plan, int num_lanes) {
+    if (num_lanes <= 1) {
+        for (int s = 0; s < graph->count; s++) {
+            if (run_stage(ctx, graph, plan, s, 0) != 0) return 1;
+        }
+        return 0;
+    }
+
+    StageRun run = { .graph = graph, .plan = plan };
+    for (int j = 0; j < graph->count; j++) {
+        const Stage* later = &graph->stages[j];
+        run.all |= 1u << j;
+        for (int i = 0; i < j; i++) {
+            const Stage* earlier = &graph->stages[i];
+            if ((earlier->outputs & (later->inputs | later->outputs)) || (earlier->inputs & later->outputs)) {
+                run.deps[j] |= 1u << i;
+            }
+        }
+    }
+    pthread_mutex_init(&run.lock, NULL);
+    pthread_cond_init(&run.changed, NULL);
+
+    // Helper lanes get one-band contexts and heap scratch (no arena)
+    StageLane* lanes = calloc(num_lanes, sizeof(StageLane));
+    int started_lanes = 1;
+    if (lanes) {
+        lanes[0] = (StageLane){ &run, ctx, 0, pthread_self() };
+        for (int l = 1; l < num_lanes; l++) {
+            MapGenContext* helper_ctx = mapgen_context_clone(ctx);
+            if (!helper_ctx) break;
+            mapgen_context_config(helper_ctx)->num_threads = 1;
+            lanes[l] = (StageLane){ &run, helper_ctx, l, 0 };
+            if (pthread_create(&lanes[l].thread, NULL, lane_main, &lanes[l]) != 0) {
+                mapgen_context_destroy(helper_ctx);
+                break;
+            }
+            started_lanes++;
+        }
+        lane_loop(&lanes[0]);
+    } else {
+        StageLane only = { &run, ctx, 0, pthread_self() };
+        lane_loop(&only);
+    }
+
+    for (int l = 1; l < started_lanes; l++) {
+        pthread_join(lanes[l].thread, NULL);
+        mapgen_context_destroy(lanes[l].ctx);
+    }
+    free(lanes);
+    pthread_cond_destroy(&run.changed);
+    pthread_mutex_destroy(&run.lock);
+    mapgen_log(ctx, MAPGEN_LOG_DEBUG, "Stage graph: %d stages on %d lanes\n", graph->count, started_lanes);
+    return run.failed ? 1 : 0;
+}
+
+int stage_graph_run(MapGenContext* ctx, const StageGraph* graph, int num_lanes) {
+    if (!graph) return 1;
+    if (!stage_cache_enabled(graph->cache)) return run_graph(ctx, graph, NULL, num_lanes);
+
+    StagePlan plan[STAGE_GRAPH_MAX_STAGES];
+    int hits = plan_stages(ctx, graph, plan);
+    mapgen_log(ctx, MAPGEN_LOG_INFO, "Stage cache: %d of %d stages reused\n", hits, graph->count);
+    int result = run_graph(ctx, graph, plan, num_lanes);
+    for (int s = 0; s < graph->count; s++) stage_cache_release(graph->cache, plan[s].hit);
+    return result;
+}
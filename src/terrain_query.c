@@ -0,0 +1,141 @@
+#include "terrain_query.h"
+#include <math.h>
+
+#include "parallel.h"
+#include "planet.h"
+
+// Points per block: every per-block array stays in L1 while the chain and
+// climate loops run over it.
+#define TERRAIN_QUERY_BLOCK 128
+
+bool terrain_query_init(MapGenContext* ctx, TerrainQuery* query, const MapGenConfig* config, unsigned int seed) {
+    if (!query || !config) return false;
+    query->config = *config;
+    query->config.redistribution_max_error = 0.0;
+    query->land_threshold = config->continent_land_threshold;
+    query->elevation_noise = init_noise_generator(ctx, mapgen_noise_seed(seed, MAP_NOISE_ELEVATION));
+    query->moisture_noise = init_noise_generator(ctx, mapgen_noise_seed(seed, MAP_NOISE_MOISTURE));
+    query->continent_noise = init_noise_generator(ctx, mapgen_noise_seed(seed, MAP_NOISE_CONTINENT));
+    if (!query->elevation_noise || !query->moisture_noise || !query->continent_noise) {
+        terrain_query_cleanup(ctx, query);
+        return false;
+    }
+    return true;
+}
+
+void terrain_query_cleanup(MapGenContext* ctx, TerrainQuery* query) {
+    if (!query) return;
+    cleanup_noise_generator(ctx, query->elevation_noise);
+    cleanup_noise_generator(ctx, query->moisture_noise);
+    cleanup_noise_generator(ctx, query->continent_noise);
+    query->elevation_noise = NULL;
+    query->moisture_noise = NULL;
+    query->continent_noise = NULL;
+}
+
+// n <= TERRAIN_QUERY_BLOCK points.
+static void sample_block(const TerrainQuery* query, const double* x, const double* y, int n, TerrainSample* out) {
+    const MapGenConfig* config = &query->config;
+    float fx[TERRAIN_QUERY_BLOCK], fy[TERRAIN_QUERY_BLOCK];
+    double elevation[TERRAIN_QUERY_BLOCK], moisture[TERRAIN_QUERY_BLOCK], continent[TERRAIN_QUERY_BLOCK];
+    for (int i = 0; i < n; i++) {
+        fx[i] = (float)x[i];
+        fy[i] = (float)y[i];
+    }
+    sample_octave_noise(query->elevation_noise, &config->elev_params, config->width, config->height, fx, fy, n, elevation);
+    sample_octave_noise(query->moisture_noise, &config->moist_params, config->width, config->height, fx, fy, n, moisture);
+    sample_octave_noise(query->continent_noise, &config->cont_params, config->width, config->height, fx, fy, n, continent);
+
+    // The block is a 1 x n layer to the shaping chain; no context, so it runs
+    // on this thread and allocates nothing (pow() is exact).
+    double* elevation_row = elevation;
+    double* continent_row = continent;
+    PointChain shaping;
+    mapgen_shaping_chain(config, &continent_row, query->land_threshold, &shaping);
+    point_chain_apply(NULL, &shaping, &elevation_row, n, 1);
+
+    double factor = config->latitude_temp_effect_strength;
+    double inverse_span = 1.0 / (config->height > 1 ? config->height - 1 : 1);
+    bool cube_face = config->elev_params.wrap == NOISE_WRAP_CUBE_FACE;
+    for (int i = 0; i < n; i++) {
+        double latitude = cube_face ? cube_face_latitude(config->elev_params.cube_face, config->width, x[i], y[i])
+                                    : fabs(y[i] * inverse_span - 0.5) * 2.0;
+        out[i].elevation = elevation[i];
+        out[i].moisture = moisture[i];
+        out[i].temperature = temperature_from_elevation(elevation[i] + factor * latitude);
+    }
+    for (int i = 0; i < n; i++) out[i].biome = classify_biome(out[i].temperature, out[i].moisture);
+}
+
+typedef struct {
+    const TerrainQuery* query;
+    const double* x;
+    const double* y;
+    int count;
+    TerrainSample* out;
+} TerrainQueryJob;
+
+static void query_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    const TerrainQueryJob* job = user_data;
+    for (int b = begin; b < end; b++) {
+        int first = b * TERRAIN_QUERY_BLOCK;
+        int n = job->count - first < TERRAIN_QUERY_BLOCK ? job->count - first : TERRAIN_QUERY_BLOCK;
+        sample_block(job->query, job->x + first, job->y + first, n, job->out + first);
+    }
+}
+
+void terrain_query_sample(MapGenContext* ctx, const TerrainQuery* query, const double* x, const double* y,
+                          int count, TerrainSample* out) {
+    if (!query || !query->elevation_noise || !x || !y || !out || count <= 0) return;
+    TerrainQueryJob job = { query, x, y, count, out };
+    int blocks = (count + TERRAIN_QUERY_BLOCK - 1) / TERRAIN_QUERY_BLOCK;
+    if (blocks == 1) query_band(&job, 0, 1, 0);
+    else mapgen_parallel_bands(ctx, blocks, query_band, &job);
+}
+
+TerrainSample terrain_query_point(const TerrainQuery* query, double x, double y) {
+    TerrainSample sample = { 0.0, 0.0, 0.0, BIOME_OCEAN };
+    if (query && query->elevation_noise) sample_block(query, &x, &y, 1, &sample);
+    return sample;
+}
+
+// --- Self-Check ---
+
+double terrain_query_check_noise(MapGenContext* ctx, const TerrainQuery* query) {
+    if (!query || !query->elevation_noise) return -1.0;
+    const MapGenConfig* config = &query->config;
+    int width = config->width;
+    int height = config->height;
+    Arena* arena = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(arena);
+    double** layer = create_layer(ctx, width, height);
+    float* xs = scratch_alloc(arena, (size_t)width * sizeof(float));
+    float* ys = scratch_alloc(arena, (size_t)width * sizeof(float));
+    double* row = scratch_alloc(arena, (size_t)width * sizeof(double));
+    double max_diff = -1.0;
+    if (layer && xs && ys && row) {
+        NoiseState* states[] = { query->elevation_noise, query->moisture_noise, query->continent_noise };
+        const NoiseParams* params[] = { &config->elev_params, &config->moist_params, &config->cont_params };
+        for (int x = 0; x < width; x++) xs[x] = (float)x;
+        max_diff = 0.0;
+        for (int c = 0; c < 3; c++) {
+            NoiseParams exact = *params[c];
+            exact.max_interp_error = 0.0;
+            generate_octave_noise_to_layer(ctx, states[c], width, height, layer, &exact);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) ys[x] = (float)y;
+                sample_octave_noise(states[c], &exact, width, height, xs, ys, width, row);
+                for (int x = 0; x < width; x++) max_diff = fmax(max_diff, fabs(row[x] - layer[y][x]));
+            }
+        }
+    } else {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate terrain query check layers.\n");
+    }
+    scratch_free(arena, row);
+    scratch_free(arena, ys);
+    scratch_free(arena, xs);
+    destroy_layer(ctx, layer);
+    arena_release(arena, mark);
+    return max_diff;
+}
@@ -0,0 +1,266 @@
+#include "watershed.h"
+#include <float.h>
+
+#include "components.h"
+#include "parallel.h"
+
+// Neighbour directions in the order find_downhill_neighbour scans them, so
+// ties go the same way; direction 7 - d points back along d.
+static const int FLOW_DX[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const int FLOW_DY[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+#define FLOW_OUTLET 8
+#define FLOW_WATER  9
+
+typedef struct {
+    const MapData* map;
+    double water_level;
+    const int32_t* component;           // Water mask when set (see watershed.h)
+    const ComponentTable* components;   // Tells lakes from oceans, may be NULL
+    uint8_t* flow;                      // Direction to the receiver, FLOW_OUTLET or FLOW_WATER
+    int32_t* basin;                     // Holds the flow codes until collect_band
+    long long* band_outlets;            // Outlets per band, then the first id of each band
+    int32_t* outlets;                   // Cell of each outlet, by id
+    BasinStats* stats;
+} BasinJob;
+
+static bool is_water(const BasinJob* job, size_t i) {
+    if (job->component) return COMPONENT_IS_WATER(job->component[i]);
+    return job->map->elevation[0][i] < job->water_level;
+}
+
+// Flow directions of a band of rows, and the number of outlets among them.
+// They go to the label layer first, since the outlet count decides the size
+// of the output table, which must be allocated before any scratch.
+static void flow_band(void* user_data, int begin, int end, int band) {
+    BasinJob* job = user_data;
+    int width = job->map->width;
+    int height = job->map->height;
+    const double* elevation = job->map->elevation[0];
+    long long outlets = 0;
+
+    for (int y = begin; y < end; y++) {
+        for (int x = 0; x < width; x++) {
+            size_t i = (size_t)y * width + x;
+            if (is_water(job, i)) {
+                job->basin[i] = FLOW_WATER;
+                continue;
+            }
+            int best = -1;
+            size_t receiver = i;
+            double lowest = elevation[i];
+            for (int d = 0; d < 8; d++) {
+                int nx = x + FLOW_DX[d];
+                int ny = y + FLOW_DY[d];
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                size_t n = (size_t)ny * width + nx;
+                if (elevation[n] < lowest) {
+                    lowest = elevation[n];
+                    best = d;
+                    receiver = n;
+                }
+            }
+            if (best >= 0 && !is_water(job, receiver)) {
+                job->basin[i] = best;
+            } else {
+                job->basin[i] = FLOW_OUTLET;
+                outlets++;
+            }
+        }
+    }
+    job->band_outlets[band] = outlets;
+}
+
+// Moves the flow codes to bytes, lists the outlets in raster order and marks
+// water in the label layer.
+static void collect_band(void* user_data, int begin, int end, int band) {
+    BasinJob* job = user_data;
+    int32_t id = (int32_t)job->band_outlets[band];
+    for (int32_t i = begin * job->map->width; i < end * job->map->width; i++) {
+        int32_t code = job->basin[i];
+        job->flow[i] = (uint8_t)code;
+        if (code == FLOW_OUTLET) job->outlets[id++] = i;
+        else if (code == FLOW_WATER) job->basin[i] = BASIN_NONE;
+    }
+}
+
+// Where the outlet at (x, y) sends its water: its lowest water neighbour
+// (which is also its lowest neighbour when it has a lower one), else off the
+// map edge or nowhere.
+static void classify_outlet(const BasinJob* job, int x, int y, BasinStats* stats) {
+    int width = job->map->width;
+    int height = job->map->height;
+    const double* elevation = job->map->elevation[0];
+    size_t water = 0;
+    double lowest = DBL_MAX;
+    for (int d = 0; d < 8; d++) {
+        int nx = x + FLOW_DX[d];
+        int ny = y + FLOW_DY[d];
+        if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+        size_t n = (size_t)ny * width + nx;
+        if (is_water(job, n) && elevation[n] < lowest) {
+            lowest = elevation[n];
+            water = n;
+        }
+    }
+
+    stats->water_body = -1;
+    if (lowest < DBL_MAX) {
+        stats->outlet = BASIN_DRAINS_OCEAN;
+        if (job->component) {
+            stats->water_body = COMPONENT_ID(job->component[water]);
+            if (job->components && job->components->stats[stats->water_body].lake) stats->outlet = BASIN_DRAINS_LAKE;
+        }
+    } else if (x == 0 || y == 0 || x == width - 1 || y == height - 1) {
+        stats->outlet = BASIN_DRAINS_EDGE;
+    } else {
+        stats->outlet = BASIN_SINK;
+    }
+}
+
+// Labels the basins of outlets [begin, end) by walking each tree upstream:
+// descend into the next neighbour that flows into the current cell, or, when
+// there is none left, climb back to the receiver and resume after the
+// direction just finished.
+static void trace_band(void* user_data, int begin, int end, int band) {
+    (void)band;
+    BasinJob* job = user_data;
+    int width = job->map->width;
+    int height = job->map->height;
+    const double* elevation = job->map->elevation[0];
+    const uint8_t* flow = job->flow;
+
+    for (int32_t id = begin; id < end; id++) {
+        int32_t outlet = job->outlets[id];
+        int x = outlet % width;
+        int y = outlet / width;
+        BasinStats stats = { 1, { x, y, x + 1, y + 1 }, x, y, BASIN_SINK, -1,
+                             elevation[outlet], elevation[outlet] };
+        classify_outlet(job, x, y, &stats);
+        job->basin[outlet] = id;
+
+        int32_t cell = outlet;
+        int dir = 0;
+        for (;;) {
+            for (; dir < 8; dir++) {
+                int nx = x + FLOW_DX[dir];
+                int ny = y + FLOW_DY[dir];
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                if (flow[(size_t)ny * width + nx] == 7 - dir) break;
+            }
+            if (dir < 8) {
+                x += FLOW_DX[dir];
+                y += FLOW_DY[dir];
+                cell = y * width + x;
+                job->basin[cell] = id;
+                stats.area++;
+                if (x < stats.bbox.x0) stats.bbox.x0 = x;
+                if (x >= stats.bbox.x1) stats.bbox.x1 = x + 1;
+                if (y < stats.bbox.y0) stats.bbox.y0 = y;
+                if (y >= stats.bbox.y1) stats.bbox.y1 = y + 1;
+                if (elevation[cell] > stats.peak_elevation) stats.peak_elevation = elevation[cell];
+                dir = 0;
+                continue;
+            }
+            if (cell == outlet) break;
+            int down = flow[cell];
+            x += FLOW_DX[down];
+            y += FLOW_DY[down];
+            cell = y * width + x;
+            dir = 7 - down + 1;
+        }
+        job->stats[id] = stats;
+    }
+}
+
+bool label_basins(MapGenContext* ctx, MapData* map, double water_level, int32_t** basins,
+                  Arena* arena, BasinTable* out) {
+    if (!map || !map->elevation || !basins || !out) return false;
+    if ((long long)map->width * map->height > INT32_MAX) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Map too large for 32-bit basin labels.\n");
+        return false;
+    }
+
+    const ComponentTable* components = map->component ? map_components(ctx, map) : NULL;
+    int num_bands = mapgen_context_num_threads(ctx);
+    Arena* scratch = mapgen_context_arena(ctx);
+    ArenaMark mark = arena_mark(scratch);
+    // Zeroed: bands with no rows never run and must count no outlets
+    long long* band_outlets = scratch_calloc(scratch, num_bands, sizeof(long long));
+    if (!band_outlets) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate drainage basin scratch.\n");
+        arena_release(scratch, mark);
+        return false;
+    }
+    BasinJob job = { map, water_level, map->component ? map->component[0] : NULL, components,
+                     NULL, basins[0], band_outlets, NULL, NULL };
+    mapgen_parallel_bands(ctx, map->height, flow_band, &job);
+    long long count = 0;
+    for (int b = 0; b < num_bands; b++) {
+        long long outlets = band_outlets[b];
+        band_outlets[b] = count;
+        count += outlets;
+    }
+
+    out->count = (int)count;
+    out->stats = scratch_alloc(arena, ((size_t)count + 1) * sizeof(BasinStats));
+    job.flow = scratch_alloc(scratch, (size_t)map->width * map->height);
+    job.outlets = scratch_alloc(scratch, (size_t)count * sizeof(int32_t) + 1);
+    job.stats = out->stats;
+
+    bool ok = out->stats && job.flow && job.outlets;
+    if (ok) {
+        mapgen_parallel_bands(ctx, map->height, collect_band, &job);
+        mapgen_parallel_bands(ctx, out->count, trace_band, &job);
+    } else {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error: Failed to allocate drainage basin scratch.\n");
+        scratch_free(arena, out->stats);
+        out->stats = NULL;
+        out->count = 0;
+    }
+
+    scratch_free(scratch, job.outlets);
+    scratch_free(scratch, job.flow);
+    scratch_free(scratch, band_outlets);
+    arena_release(scratch, mark);
+    return ok;
+}
+
+bool map_compute_basins(MapGenContext* ctx, MapData* map, double water_level) {
+    if (!map) return false;
+    // The labels and their table live with the map's other layers
+    Arena* previous_arena = mapgen_context_arena(ctx);
+    mapgen_context_set_arena(ctx, map->arena);
+    if (!map->basin) map->basin = create_label_layer(ctx, map->width, map->height);
+    mapgen_context_set_arena(ctx, previous_arena);
+    if (!map->basin) {
+        mapgen_log(ctx, MAPGEN_LOG_ERROR, "Error allocating the drainage basin layer\n");
+        return false;
+    }
+    if (map->basins) {
+        scratch_free(map->arena, map->basins->stats);
+        scratch_free(map->arena, map->basins);
+        map->basins = NULL;
+    }
+
+    BasinTable* table = scratch_alloc(map->arena, sizeof(BasinTable));
+    if (!table || !label_basins(ctx, map, water_level, map->basin, map->arena, table)) {
+        scratch_free(map->arena, table);
+        return false;
+    }
+    map->basins = table;
+    map->stale &= ~MAP_STALE_BASINS;
+
+    int drains[BASIN_SINK + 1] = { 0 };
+    for (int b = 0; b < table->count; b++) drains[table->stats[b].outlet]++;
+    mapgen_log(ctx, MAPGEN_LOG_INFO,
+               "Drainage basins: %d (%d to the ocean, %d to lakes, %d off the edge, %d closed).\n",
+               table->count, drains[BASIN_DRAINS_OCEAN], drains[BASIN_DRAINS_LAKE],
+               drains[BASIN_DRAINS_EDGE], drains[BASIN_SINK]);
+    return true;
+}
+
+const BasinTable* map_basins(MapGenContext* ctx, MapData* map, double water_level) {
+    if (!map || !map->basin) return NULL;
+    if (map->basins && !(map->stale & MAP_STALE_BASINS)) return map->basins;
+    return map_compute_basins(ctx, map, water_level) ? map->basins : NULL;
+}